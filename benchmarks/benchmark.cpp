@@ -0,0 +1,153 @@
+#include <vector>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <ctime>
+#include "benchmark.h"
+
+using std::vector;
+using std::string;
+
+namespace {
+
+struct registered_benchmark {
+    string name;
+    benchmark_body body;
+};
+
+struct result {
+    string name;
+    size_t iterations;
+    double median_ns;
+    double min_ns;
+};
+
+vector<registered_benchmark>& registry() {
+    static vector<registered_benchmark> benchmarks;
+    return benchmarks;
+}
+
+double run_once(const benchmark_body& body, size_t iterations) {
+    typedef std::chrono::steady_clock clock;
+    auto start = clock::now();
+    body(iterations);
+    return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+result measure(const registered_benchmark& b, double min_time, size_t repetitions) {
+    // Grow the iteration count until a run is long enough to time reliably
+    size_t iterations = 1;
+    double elapsed = run_once(b.body, iterations);
+    while (elapsed < min_time && iterations < (size_t(1) << 40)) {
+        double factor = elapsed > 0 ? 1.4 * min_time / elapsed : 100.0;
+        iterations = static_cast<size_t>(iterations * std::min(std::max(factor, 2.0), 100.0));
+        elapsed = run_once(b.body, iterations);
+    }
+
+    vector<double> per_op {elapsed / iterations * 1e9};
+    for (size_t r = 1; r < repetitions; r++) {
+        per_op.push_back(run_once(b.body, iterations) / iterations * 1e9);
+    }
+    std::sort(per_op.begin(), per_op.end());
+    return result {b.name, iterations, per_op[per_op.size() / 2], per_op.front()};
+}
+
+string json_escape(const string& s) {
+    string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void write_json(const string& filename, const vector<result>& results) {
+    std::ofstream ofs(filename);
+    if (!ofs.good()) {
+        throw std::runtime_error("Can't open " + filename);
+    }
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    ofs << std::setprecision(6);
+    ofs << "{\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"compiler\": \"" << json_escape(__VERSION__) << "\",\n"
+        << "    \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const result& r = results[i];
+        ofs << "        {\"name\": \"" << json_escape(r.name) << "\""
+            << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << r.median_ns
+            << ", \"min_ns_per_op\": " << r.min_ns << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    ofs << "    ]\n}\n";
+}
+
+void usage() {
+    std::cout << "Usage: benchmarks [--filter substring] [--min-time seconds] [--repetitions n] [--json file]" << std::endl;
+}
+
+}
+
+int register_benchmark(const string& name, benchmark_body body) {
+    registry().push_back(registered_benchmark {name, body});
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string filter;
+    string json_file;
+    double min_time = 0.2;
+    size_t repetitions = 5;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--help") {
+            usage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return -1;
+        }
+        string value = argv[++i];
+        if (arg == "--filter") filter = value;
+        else if (arg == "--min-time") min_time = std::stod(value);
+        else if (arg == "--repetitions") repetitions = std::max(1, std::stoi(value));
+        else if (arg == "--json") json_file = value;
+        else {
+            usage();
+            return -1;
+        }
+    }
+
+    std::sort(registry().begin(), registry().end(),
+              [](const registered_benchmark& a, const registered_benchmark& b) { return a.name < b.name; });
+
+    vector<result> results;
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right
+              << std::setw(14) << "iterations" << std::setw(16) << "ns/op" << std::setw(16) << "min ns/op" << std::endl;
+    for (const registered_benchmark& b : registry()) {
+        if (b.name.find(filter) == string::npos) {
+            continue;
+        }
+        result r = measure(b, min_time, repetitions);
+        std::cout << std::left << std::setw(40) << r.name << std::right
+                  << std::setw(14) << r.iterations
+                  << std::setw(16) << std::fixed << std::setprecision(1) << r.median_ns
+                  << std::setw(16) << r.min_ns << std::endl;
+        results.push_back(r);
+    }
+
+    if (!json_file.empty()) {
+        write_json(json_file, results);
+    }
+    return 0;
+}
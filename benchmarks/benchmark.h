@@ -0,0 +1,29 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <functional>
+
+// Minimal benchmark harness
+// A benchmark body performs its operation `iterations` times. The harness grows
+// the iteration count until one run lasts at least --min-time, then repeats the
+// run and reports the median and fastest time per operation.
+// Setup done inside the body before the loop is amortized over the iterations.
+typedef std::function<void (size_t iterations)> benchmark_body;
+
+int register_benchmark(const std::string& name, benchmark_body body);
+
+// The body is defined as name##_benchmark so that benchmarks can be named after
+// the function they measure
+#define BENCHMARK(name) \
+    static void name##_benchmark(size_t iterations); \
+    static const int name##_registered = register_benchmark(#name, name##_benchmark); \
+    static void name##_benchmark(size_t iterations)
+
+// Prevent the compiler from optimizing away the computation of value
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include <array>
+#include <memory>
+#include "ceres/ceres.h"
+#include "../src/camera_models.h"
+#include "../src/model0.h"
+#include "../src/model_terrain.h"
+#include "benchmark.h"
+
+using std::array;
+
+// Values typical of the alinta-stockpile data set
+static const internal_t internal {48.3355e-3, 0.0093e-3, -0.0276e-3, 0.0085e-3};
+static const array<double, 6> external {1.5, -2.0, 269.0, 0.01, -0.02, 0.3};
+static const array<double, 3> point {12.0, -7.5, 3.0};
+
+// Jets with one derivative per parameter, as ceres evaluates them
+template <int N>
+array<ceres::Jet<double, N>, 6> jet_external() {
+    array<ceres::Jet<double, N>, 6> ext;
+    for (int k = 0; k < 6; k++) {
+        ext[k] = ceres::Jet<double, N>(external[k], k % N);
+    }
+    return ext;
+}
+
+template <int N>
+array<ceres::Jet<double, N>, 3> jet_point(int offset) {
+    array<ceres::Jet<double, N>, 3> p;
+    for (int k = 0; k < 3; k++) {
+        p[k] = ceres::Jet<double, N>(point[k], (offset + k) % N);
+    }
+    return p;
+}
+
+BENCHMARK(rotation_matrix_3_double) {
+    array<double, 6> ext = external;
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        Eigen::Matrix<double, 3, 3> R = rotation_matrix_3<double, double>(ext.data());
+        keep(R);
+    }
+}
+
+BENCHMARK(rotation_matrix_3_jet) {
+    auto ext = jet_external<6>();
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        Eigen::Matrix<ceres::Jet<double, 6>, 3, 3> R = rotation_matrix_3<ceres::Jet<double, 6>, ceres::Jet<double, 6>>(ext.data());
+        keep(R);
+    }
+}
+
+BENCHMARK(model0_projection_double) {
+    array<double, 6> ext = external;
+    array<double, 3> p = point;
+    double residuals[2];
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        model0_projection<double, double>(internal.data(), ext.data(), p.data(), residuals);
+        keep(residuals);
+    }
+}
+
+BENCHMARK(model0_projection_jet) {
+    typedef ceres::Jet<double, 8> J;
+    auto ext = jet_external<8>();
+    auto p = jet_point<8>(6);
+    J residuals[2];
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        model0_projection<J, J>(internal.data(), ext.data(), p.data(), residuals);
+        keep(residuals);
+    }
+}
+
+BENCHMARK(pinhole_projection_double) {
+    array<double, 6> ext = external;
+    array<double, 3> p = point;
+    double residuals[2];
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        pinhole_projection<double, double, double, double>(internal.data(), ext.data(), p.data(), residuals);
+        keep(residuals);
+    }
+}
+
+BENCHMARK(pinhole_projection_jet) {
+    typedef ceres::Jet<double, 3> J;
+    auto p = jet_point<3>(0);
+    J residuals[2];
+    for (size_t i = 0; i < iterations; i++) {
+        keep(p);
+        pinhole_projection<J, double, double, J>(internal.data(), external.data(), p.data(), residuals);
+        keep(residuals);
+    }
+}
+
+BENCHMARK(image_to_world_double) {
+    array<double, 6> ext = external;
+    const double pix[2] = {1e-3, -2e-3};
+    const double elevation = 0.0;
+    double dx, dy;
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        image_to_world<double>(internal.data(), ext.data(), pix, &elevation, &dx, &dy);
+        keep(dx);
+        keep(dy);
+    }
+}
+
+BENCHMARK(image_to_world_jet) {
+    typedef ceres::Jet<double, 6> J;
+    auto ext = jet_external<6>();
+    const J in[4] = {J(internal[0]), J(internal[1]), J(internal[2]), J(internal[3])};
+    const J pix[2] = {J(1e-3), J(-2e-3)};
+    const J elevation(0.0);
+    J dx, dy;
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        image_to_world<J>(in, ext.data(), pix, &elevation, &dx, &dy);
+        keep(dx);
+        keep(dy);
+    }
+}
+
+// Residual and jacobian evaluation, as done by ceres at every iteration
+BENCHMARK(model0_cost_function_evaluate) {
+    std::unique_ptr<ceres::CostFunction> cost(Model0ReprojectionError::make(internal, sensor_t(1e-3, -2e-3)));
+    array<double, 6> ext = external;
+    array<double, 2> p {point[0], point[1]};
+    const double* parameters[2] = {ext.data(), p.data()};
+    double residuals[2];
+    double jacobian_external[2*6];
+    double jacobian_point[2*2];
+    double* jacobians[2] = {jacobian_external, jacobian_point};
+    for (size_t i = 0; i < iterations; i++) {
+        keep(ext);
+        cost->Evaluate(parameters, residuals, jacobians);
+        keep(jacobian_external);
+    }
+}
+
+BENCHMARK(model_terrain_cost_function_evaluate) {
+    std::unique_ptr<ceres::CostFunction> cost(ModelTerrainReprojectionError::make(internal, external, sensor_t(1e-3, -2e-3)));
+    array<double, 3> p = point;
+    const double* parameters[1] = {p.data()};
+    double residuals[2];
+    double jacobian_point[2*3];
+    double* jacobians[1] = {jacobian_point};
+    for (size_t i = 0; i < iterations; i++) {
+        keep(p);
+        cost->Evaluate(parameters, residuals, jacobians);
+        keep(jacobian_point);
+    }
+}
@@ -0,0 +1,66 @@
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "../src/image_features.h"
+#include "benchmark.h"
+
+using std::vector;
+
+// Random SIFT-like descriptors, matched against a perturbed copy of themselves
+static cv::Mat random_descriptors(int count, int seed) {
+    cv::Mat descriptors(count, 128, CV_32F);
+    cv::RNG rng(seed);
+    rng.fill(descriptors, cv::RNG::UNIFORM, 0.0, 255.0);
+    return descriptors;
+}
+
+static vector<cv::DMatch> random_matches(size_t count) {
+    cv::RNG rng(42);
+    vector<cv::DMatch> matches(count);
+    for (size_t i = 0; i < count; i++) {
+        matches[i] = cv::DMatch(int(i), int(i), rng.uniform(0.0f, 500.0f));
+    }
+    return matches;
+}
+
+BENCHMARK(argsort_10k) {
+    const vector<cv::DMatch> matches = random_matches(10000);
+    for (size_t i = 0; i < iterations; i++) {
+        vector<size_t> order = argsort(matches);
+        keep(order);
+    }
+}
+
+BENCHMARK(reorder_10k) {
+    const vector<cv::DMatch> matches = random_matches(10000);
+    const vector<size_t> order = argsort(matches);
+    for (size_t i = 0; i < iterations; i++) {
+        vector<cv::DMatch> sorted = reorder(matches, order);
+        keep(sorted);
+    }
+}
+
+BENCHMARK(match_sorted_2k) {
+    const cv::Mat a = random_descriptors(2000, 1);
+    cv::Mat noise = random_descriptors(2000, 2);
+    const cv::Mat b = a + 0.05 * noise;
+    for (size_t i = 0; i < iterations; i++) {
+        vector<cv::DMatch> matches = match_sorted(a, b);
+        keep(matches);
+    }
+}
+
+BENCHMARK(match_compressed_pca32_2k) {
+    const cv::Mat a = random_descriptors(2000, 1);
+    cv::Mat noise = random_descriptors(2000, 2);
+    const cv::Mat b = a + 0.05 * noise;
+    cv::Mat samples;
+    cv::vconcat(a, b, samples);
+    DescriptorCompressor compressor(32);
+    compressor.train(samples);
+    const cv::Mat ca = compressor.compress(a);
+    const cv::Mat cb = compressor.compress(b);
+    for (size_t i = 0; i < iterations; i++) {
+        vector<cv::DMatch> matches = match_compressed(compressor, ca, cb);
+        keep(matches);
+    }
+}
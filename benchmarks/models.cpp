@@ -0,0 +1,205 @@
+#include <set>
+#include <array>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <iostream>
+#include "../src/project.h"
+#include "../src/model0.h"
+#include "../src/model_terrain.h"
+#include "../src/memory_report.h"
+#include "benchmark.h"
+
+using std::array;
+using std::vector;
+using std::shared_ptr;
+
+// Two camera scene over flat terrain, with the same geometry as alinta-stockpile
+// and observations projected from known ground points with a little noise
+static Project two_view_project(size_t matches) {
+    Project project;
+    project.data_set.reset(new DataSet());
+    project.data_set->filenames = {"synthetic_a", "synthetic_b"};
+    project.data_set->rows = 2832;
+    project.data_set->cols = 4256;
+
+    const internal_t internal {48.3355e-3, 0.0093e-3, -0.0276e-3, 0.0085e-3};
+    const array<double, 6> cam_a {0, 0, 269, 0, 0, 0};
+    const array<double, 6> cam_b {40, 2, 270, 0.002, -0.001, 0.01};
+
+    shared_ptr<FeaturesGraph> feat(new FeaturesGraph());
+    feat->data_set = project.data_set;
+    feat->number_of_matches = matches;
+    feat->computed = true;
+    feat->add_edge(0, 1);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> ground(-60.0, 60.0);
+    std::normal_distribution<double> noise(0.0, 0.5);
+    for (size_t i = 0; i < matches; i++) {
+        const double p[2] = {ground(rng) + 20, ground(rng)};
+        double sa[2], sb[2];
+        model0_projection<double, double>(internal.data(), cam_a.data(), p, sa);
+        model0_projection<double, double>(internal.data(), cam_b.data(), p, sb);
+        pixel_t pa = sensor_t(sa[0], sa[1]).to_pixel(pixel_size(internal), project.data_set->rows, project.data_set->cols);
+        pixel_t pb = sensor_t(sb[0], sb[1]).to_pixel(pixel_size(internal), project.data_set->rows, project.data_set->cols);
+        feat->add_match(0, pixel_t(pa.i + noise(rng), pa.j + noise(rng)),
+                           pixel_t(pb.i + noise(rng), pb.j + noise(rng)));
+    }
+    project.features_list.push_back(feat);
+
+    shared_ptr<Model0> model(new Model0());
+    model->features = feat;
+    model->internal = internal;
+    model->set_progress_output(false);
+    Model0::solution init;
+    init.cameras = {cam_a, {0, 0, 269, 0, 0, 0}};
+    model->solutions.push_back(init);
+    project.models.push_back(model);
+    return project;
+}
+
+// Final cost of a solve of model with backend
+static double final_cost(const Model0& base, Model0::solver_backend backend) {
+    Model0 model(base);
+    model.backend = backend;
+    return model.solve().final_cost;
+}
+
+static void solve_model0(size_t matches, size_t iterations, Model0::solver_backend backend = Model0::ceres_solver) {
+    const Project project = two_view_project(matches);
+    const Model0& base = dynamic_cast<const Model0&>(*project.models[0]);
+    // Other backends are only comparable to ceres if they reach the same minimum,
+    // checked once per problem size
+    static std::set<size_t> checked;
+    if (backend != Model0::ceres_solver && checked.insert(matches).second) {
+        const double expected = final_cost(base, Model0::ceres_solver);
+        const double cost = final_cost(base, backend);
+        if (!(std::abs(cost - expected) <= 1e-4 * expected)) {
+            throw std::runtime_error("solve_model0 backends disagree: final cost " + std::to_string(cost) +
+                                     " instead of ceres' " + std::to_string(expected));
+        }
+    }
+    for (size_t i = 0; i < iterations; i++) {
+        Model0 model(base);
+        model.backend = backend;
+        ceres::Solver::Summary summary = model.solve();
+        keep(summary.final_cost);
+    }
+}
+
+BENCHMARK(solve_model0_200) {
+    solve_model0(200, iterations);
+}
+
+BENCHMARK(solve_model0_5k) {
+    solve_model0(5000, iterations);
+}
+
+BENCHMARK(solve_model0_50k) {
+    solve_model0(50000, iterations);
+}
+
+// Same problems with the specialized two view LM instead of ceres' DENSE_SCHUR
+BENCHMARK(solve_model0_200_two_view) {
+    solve_model0(200, iterations, Model0::two_view_solver);
+}
+
+BENCHMARK(solve_model0_5k_two_view) {
+    solve_model0(5000, iterations, Model0::two_view_solver);
+}
+
+BENCHMARK(solve_model0_50k_two_view) {
+    solve_model0(50000, iterations, Model0::two_view_solver);
+}
+
+BENCHMARK(solve_model_terrain_2k) {
+    Project project = two_view_project(2000);
+    project.models[0]->solve();
+    project.models[0]->solved = true;
+    for (size_t i = 0; i < iterations; i++) {
+        ModelTerrain model;
+        model.parent = project.models[0];
+        model.features = project.features_list[0];
+        model.set_progress_output(false);
+        ceres::Solver::Summary summary = model.solve();
+        keep(summary.final_cost);
+    }
+}
+
+// Residual block construction only, the allocation pattern of every solve's setup
+template <bool pooled>
+static void build_problem(const Model0& model, array<double, 6>& camera, vector<array<double, 2>>& points) {
+    const obs_pair& edge = model.features->edges[0];
+    // Declared before the problem, which holds cost functions allocated from it
+    std::unique_ptr<Model0ReprojectionError::pool_type> pool;
+    if (pooled) {
+        pool.reset(new Model0ReprojectionError::pool_type());
+        pool->reserve(points.size());
+    }
+    ceres::Problem problem(pooled ? pooled_problem_options() : ceres::Problem::Options());
+    for (size_t i = 0; i < points.size(); i++) {
+        sensor_t obs = model.features->sensor(edge.cam_a, edge.index_a[i], pixel_size(model.internal));
+        ceres::CostFunction* cost = pooled
+            ? Model0ReprojectionError::make_pooled(*pool, model.internal, obs)
+            : Model0ReprojectionError::make(model.internal, obs);
+        problem.AddResidualBlock(cost, NULL, camera.data(), points[i].data());
+    }
+    keep(problem.NumResidualBlocks());
+}
+
+// Times construction, and prints the peak heap per residual of one construction once
+template <bool pooled>
+static void build_problem_benchmark(const char* name, size_t matches, size_t iterations) {
+    const Project project = two_view_project(matches);
+    const Model0& model = dynamic_cast<const Model0&>(*project.models[0]);
+    array<double, 6> camera = model.solutions[0].cameras[0];
+    vector<array<double, 2>> points(matches, array<double, 2>{{0, 0}});
+
+    static bool reported = false;
+    if (!reported) {
+        MemoryAccount& account = MemoryAccount::instance();
+        account.enable();
+        MemoryScope scope(name);
+        build_problem<pooled>(model, camera, points);
+        scope.end();
+        account.disable();
+        std::cerr << name << ": " << account.stats()[name].peak_heap / int64_t(matches)
+                  << " heap bytes per residual" << std::endl;
+        reported = true;
+    }
+
+    for (size_t i = 0; i < iterations; i++) {
+        build_problem<pooled>(model, camera, points);
+    }
+}
+
+BENCHMARK(build_problem_model0_50k) {
+    build_problem_benchmark<false>("build_problem_model0_50k", 50000, iterations);
+}
+
+BENCHMARK(build_problem_model0_50k_pooled) {
+    build_problem_benchmark<true>("build_problem_model0_50k_pooled", 50000, iterations);
+}
+
+static void project_round_trip(const char* filename, size_t iterations) {
+    Project project = two_view_project(5000);
+    project.models[0]->solve();
+    project.models[0]->solved = true;
+    for (size_t i = 0; i < iterations; i++) {
+        project.to_file(filename);
+        Project loaded = Project::from_file(filename);
+        keep(loaded);
+    }
+    std::remove(filename);
+}
+
+BENCHMARK(project_save_load_json) {
+    project_round_trip("benchmark_project.json", iterations);
+}
+
+BENCHMARK(project_save_load_binary) {
+    project_round_trip("benchmark_project.bin", iterations);
+}
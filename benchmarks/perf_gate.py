@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+
+"""
+Performance regression gate
+
+Runs a fixed set of scenarios on synthetic projects and on the micro benchmarks,
+and compares wall time, peak RSS, solver iterations and ns/op to the baseline
+in benchmarks/perf_baseline.json. A metric regresses when it exceeds its
+baseline by more than the relative tolerance of that metric.
+Exits with status 1 if any metric regressed or has no baseline, so that a
+scenario can't pass the gate without having been recorded.
+
+Timings and RSS are only comparable on one machine, so the checked in baseline
+holds the tolerances only. Record it once on the reference machine with
+--update and commit the file. Until then the gate runs the scenarios, prints
+their values and passes.
+
+Usage: ./benchmarks/perf_gate.py [--update] [--build build_dir] [--baseline file]
+    --update    record the current run as the new baseline, keeping tolerances
+    --missing   only record metrics that have no baseline yet
+
+Bootstrap samples are made reproducible with GEOSOLVE_SEED so that iteration
+counts can be compared exactly.
+"""
+
+import sys
+import os
+import json
+import time
+import shutil
+import tempfile
+import argparse
+import subprocess
+
+# name: (synth options, geosolve commands)
+synth_scenarios = {
+    "synth_two_view": ({"cameras": 2, "points": 2000}, ["solve"]),
+    "synth_strip": ({"cameras": 6, "points": 50000}, ["solve"]),
+    "synth_bootstrap": ({"cameras": 2, "points": 500}, ["solve", "bootstrap"]),
+}
+
+# Micro benchmarks of the hot kernels, see benchmarks/*.cpp
+micro_filters = ["projection", "cost_function", "argsort", "reorder"]
+
+def total_iterations(perf_report):
+    "Iterations column of the total row of 'geosolve perf_report'"
+    for line in perf_report.splitlines():
+        fields = line.split("\t")
+        if fields[0] == "total":
+            return int(fields[2])
+    raise RuntimeError("No total row in perf_report output")
+
+def run_synth_scenario(build_dir, options, commands):
+    geosolve = os.path.join(build_dir, "geosolve")
+    env = dict(os.environ, GEOSOLVE_SEED="1")
+    env.pop("GEOSOLVE_SERVER", None)
+    project_dir = tempfile.mkdtemp(prefix="perf_gate_")
+    try:
+        # Full options file from the defaults, then overridden
+        subprocess.check_call([geosolve, "-", project_dir, "synth"], env=env, stdout=subprocess.DEVNULL)
+        with open(os.path.join(project_dir, "synth.json")) as f:
+            synth = json.load(f)
+        synth.update(options)
+        with open(os.path.join(project_dir, "synth.json"), "w") as f:
+            json.dump(synth, f, indent=4)
+        subprocess.check_call([geosolve, "-", project_dir, "synth"], env=env, stdout=subprocess.DEVNULL)
+
+        wall = 0.0
+        rss = 0.0
+        for command in commands:
+            # Separate process per command so peak RSS is per command
+            script = ("import resource, subprocess, sys; subprocess.check_call(sys.argv[1:], stdout=subprocess.DEVNULL);"
+                      "print(resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss)")
+            start = time.monotonic()
+            out = subprocess.check_output([sys.executable, "-c", script, geosolve, "-", project_dir, command],
+                                          env=env, universal_newlines=True)
+            wall += time.monotonic() - start
+            rss = max(rss, int(out.split()[-1]) / 1024.0)
+
+        report = subprocess.check_output([geosolve, "-", project_dir, "perf_report"], env=env, universal_newlines=True)
+        return {"wall_time": wall, "peak_rss_mb": rss, "iterations": total_iterations(report)}
+    finally:
+        shutil.rmtree(project_dir)
+
+def run_micro_benchmarks(build_dir):
+    "ns_per_op of the selected micro benchmarks, as separate scenarios"
+    results = {}
+    with tempfile.NamedTemporaryFile(suffix=".json") as tmp:
+        for pattern in micro_filters:
+            subprocess.check_call([os.path.join(build_dir, "benchmarks"), "--filter", pattern, "--json", tmp.name],
+                                  stdout=subprocess.DEVNULL)
+            with open(tmp.name) as f:
+                for b in json.load(f)["benchmarks"]:
+                    results["micro_" + b["name"]] = {"ns_per_op": b["ns_per_op"]}
+    return results
+
+def compare(baseline, tolerances, current):
+    "Print a comparison table, return the lists of regressions and of metrics without baseline"
+    regressions = []
+    missing = []
+    print("{:<44}{:<14}{:>14}{:>14}{:>10}".format("scenario", "metric", "baseline", "current", "change"))
+    for name in sorted(current):
+        for metric, value in sorted(current[name].items()):
+            base = baseline.get(name, {}).get(metric)
+            if base is None:
+                print("{:<44}{:<14}{:>14}{:>14.4g}{:>10}".format(name, metric, "-", value, "missing"))
+                missing.append((name, metric))
+                continue
+            change = (value - base) / base if base != 0 else (0.0 if value == 0 else float("inf"))
+            status = ""
+            if change > tolerances[metric]:
+                status = "  REGRESSION"
+                regressions.append((name, metric))
+            print("{:<44}{:<14}{:>14.4g}{:>14.4g}{:>+9.1f}%{}".format(name, metric, base, value, 100 * change, status))
+    return regressions, missing
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description="Performance regression gate")
+    parser.add_argument("--update", action="store_true", help="record this run as the new baseline")
+    parser.add_argument("--missing", action="store_true", help="only record metrics without baseline")
+    parser.add_argument("--build", default=os.path.join(root, "build"), help="build directory")
+    parser.add_argument("--baseline", default=os.path.join(root, "benchmarks", "perf_baseline.json"))
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    current = {}
+    for name, (options, commands) in sorted(synth_scenarios.items()):
+        print("Running {}".format(name))
+        current[name] = run_synth_scenario(args.build, options, commands)
+    print("Running micro benchmarks")
+    current.update(run_micro_benchmarks(args.build))
+
+    recorded = bool(baseline["scenarios"])
+    regressions, missing = compare(baseline["scenarios"], baseline["tolerances"], current)
+
+    if args.update or args.missing:
+        if args.update:
+            baseline["scenarios"] = current
+        else:
+            for name, metric in missing:
+                baseline["scenarios"].setdefault(name, {})[metric] = current[name][metric]
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=4, sort_keys=True)
+            f.write("\n")
+        print("Baseline updated: {}".format(args.baseline))
+        return 0
+
+    if not recorded:
+        print("No baseline recorded, run with --update on the reference machine to record one")
+        return 0
+    if missing:
+        print("{} metric(s) have no baseline, record them with --missing".format(len(missing)))
+    if regressions:
+        print("{} metric(s) regressed beyond tolerance".format(len(regressions)))
+    if missing or regressions:
+        return 1
+    print("No regression")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
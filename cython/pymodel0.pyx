@@ -1,12 +1,47 @@
 import numpy as np
 cimport numpy as np
 from libcpp cimport bool
+from libcpp.string cimport string
 import cython
 
+np.import_array()
+
 cdef extern from "../src/camera_models.h":
     bool model0_projection_double(const double* internal, const double* external, const double* point, double* residuals)
     void model0_image_to_world_double(const double* const internal, const double* const external, const double* pix, const double* elevation, double* dx, double* dy)
 
+cdef extern from "../src/batch_kernels.h":
+    void model0_projection_batch(const double* internal, const double* external, const double* points, size_t n, size_t point_stride, double* result, size_t num_threads) nogil
+    void pinhole_projection_batch(const double* internal, const double* external, const double* points, size_t n, size_t point_stride, double* result, size_t num_threads) nogil
+    void model0_image_to_world_batch(const double* internal, const double* external, const double* pix, size_t n, size_t pix_stride, double elevation, double* result, size_t result_stride, size_t num_threads) nogil
+
+cdef extern from "../src/python_api.h" nogil:
+    cdef cppclass PythonProject:
+        PythonProject(const string& project_dir) except +
+        size_t images_count() except +
+        string image_filename(size_t i) except +
+        double image_rows() except +
+        double image_cols() except +
+        size_t features_count()
+        bool features_computed(size_t f)
+        void compute_features(size_t f, const string& data_dir) except +
+        size_t edges_count(size_t f) except +
+        size_t edge_size(size_t f, size_t e) except +
+        void edge_observations(size_t f, size_t e, int side, double* observations) except +
+        size_t models_count()
+        bool model_solved(size_t m)
+        long model_features(size_t m) except +
+        void solve(size_t m, const string& data_dir) except +
+        void final_internal(size_t m, double* internal) except +
+        size_t cameras_count(size_t m) except +
+        void final_external(size_t m, double* external) except +
+        size_t terrain_size(size_t m) except +
+        void final_terrain(size_t m, double* terrain) except +
+        size_t initial_cameras_count(size_t m) except +
+        void initial_external(size_t m, double* external) except +
+        size_t initial_terrain_size(size_t m) except +
+        void initial_terrain(size_t m, double* terrain) except +
+
 cdef assert_size(np.ndarray[double, ndim=1] arr, long expected_size):
     assert arr.size == expected_size, "Expected array of size {}, got {}".format(expected_size, arr.size)
 
@@ -20,18 +55,6 @@ def model0_projection(np.ndarray[double, ndim=1] internal, np.ndarray[double, nd
     model0_projection_double(&internal[0], &external[0], &point[0], residuals)
     return np.array([residuals[0], residuals[1]])
 
-@cython.boundscheck(False)
-@cython.wraparound(False)
-def model0_projection_array(np.ndarray[double, ndim=1] internal, np.ndarray[double, ndim=1] external, np.ndarray[double, ndim=2] point):
-    assert_size(internal, 4)
-    assert_size(external, 6)
-
-    cdef np.ndarray[double, ndim=2] result = np.zeros((point.shape[0], 2), dtype=np.float64)
-    cdef int i
-    for i in range(point.shape[0]):
-        model0_projection_double(&internal[0], &external[0], &point[i, 0], &result[i, 0])
-    return result
-
 @cython.boundscheck(False)
 @cython.wraparound(False)
 def model0_inverse(np.ndarray[double, ndim=1] internal, np.ndarray[double, ndim=1] external, np.ndarray[double, ndim=1] pix, double elevation):
@@ -44,14 +67,215 @@ def model0_inverse(np.ndarray[double, ndim=1] internal, np.ndarray[double, ndim=
     model0_image_to_world_double(&internal[0], &external[0], &pix[0], &elevation, &dx, &dy)
     return np.array([dx, dy], dtype=np.float64)
 
-@cython.boundscheck(False)
-@cython.wraparound(False)
-def model0_inverse_array(np.ndarray[double, ndim=1] internal, np.ndarray[double, ndim=1] external, np.ndarray[double, ndim=2] pix, double elevation):
-    assert_size(internal, 4)
-    assert_size(external, 6)
+# Batched versions
+# Inputs are used in place when they already are C contiguous float64 arrays,
+# and the whole batch runs in C++ threads with the GIL released.
+# num_threads = 0 uses all cores.
+
+cdef double[::1] vector_view(arr, long expected_size):
+    cdef double[::1] view = np.ascontiguousarray(arr, dtype=np.float64).ravel()
+    assert view.shape[0] == expected_size, "Expected array of size {}, got {}".format(expected_size, view.shape[0])
+    return view
+
+cdef double[:, ::1] points_view(arr, long min_columns):
+    cdef double[:, ::1] view = np.ascontiguousarray(arr, dtype=np.float64)
+    assert view.shape[1] >= min_columns, "Expected at least {} columns, got {}".format(min_columns, view.shape[1])
+    return view
 
-    cdef np.ndarray[double, ndim=2] result = np.zeros((pix.shape[0], 3), dtype=np.float64)
-    cdef int i
-    for i in range(pix.shape[0]):
-        model0_image_to_world_double(&internal[0], &external[0], &pix[i, 0], &elevation, &result[i, 0], &result[i, 1])
+def model0_projection_array(internal, external, point, size_t num_threads=0):
+    cdef double[::1] inter = vector_view(internal, 4)
+    cdef double[::1] ext = vector_view(external, 6)
+    cdef double[:, ::1] pts = points_view(point, 2)
+    cdef np.ndarray[double, ndim=2, mode="c"] result = np.empty((pts.shape[0], 2), dtype=np.float64)
+    cdef double* out = <double*> result.data
+    if pts.shape[0] > 0:
+        with nogil:
+            model0_projection_batch(&inter[0], &ext[0], &pts[0, 0], pts.shape[0], pts.shape[1], out, num_threads)
     return result
+
+def pinhole_projection_array(internal, external, point, size_t num_threads=0):
+    cdef double[::1] inter = vector_view(internal, 4)
+    cdef double[::1] ext = vector_view(external, 6)
+    cdef double[:, ::1] pts = points_view(point, 3)
+    cdef np.ndarray[double, ndim=2, mode="c"] result = np.empty((pts.shape[0], 2), dtype=np.float64)
+    cdef double* out = <double*> result.data
+    if pts.shape[0] > 0:
+        with nogil:
+            pinhole_projection_batch(&inter[0], &ext[0], &pts[0, 0], pts.shape[0], pts.shape[1], out, num_threads)
+    return result
+
+def model0_inverse_array(internal, external, pix, double elevation, size_t num_threads=0):
+    cdef double[::1] inter = vector_view(internal, 4)
+    cdef double[::1] ext = vector_view(external, 6)
+    cdef double[:, ::1] p = points_view(pix, 2)
+    cdef np.ndarray[double, ndim=2, mode="c"] result = np.zeros((p.shape[0], 3), dtype=np.float64)
+    cdef double* out = <double*> result.data
+    if p.shape[0] > 0:
+        with nogil:
+            model0_image_to_world_batch(&inter[0], &ext[0], &p[0, 0], p.shape[0], p.shape[1], elevation, out, 3, num_threads)
+    return result
+
+cdef class Project:
+    """
+    Project loaded by the C++ core
+    Arrays returned are copies. Calls on the handle are serialized by its mutex
+    and release the GIL, so other threads run while features are computed or
+    a model is solved.
+    """
+    cdef PythonProject* project
+
+    def __cinit__(self, project_dir):
+        self.project = new PythonProject(project_dir.encode())
+
+    def __dealloc__(self):
+        del self.project
+
+    @property
+    def images_count(self):
+        cdef size_t n
+        with nogil:
+            n = self.project.images_count()
+        return n
+
+    def image_filename(self, size_t i):
+        cdef string filename
+        with nogil:
+            filename = self.project.image_filename(i)
+        return filename.decode()
+
+    @property
+    def image_shape(self):
+        "(rows, cols) of the data set's images"
+        cdef double rows, cols
+        with nogil:
+            rows = self.project.image_rows()
+            cols = self.project.image_cols()
+        return (rows, cols)
+
+    @property
+    def features_count(self):
+        cdef size_t n
+        with nogil:
+            n = self.project.features_count()
+        return n
+
+    @property
+    def models_count(self):
+        cdef size_t n
+        with nogil:
+            n = self.project.models_count()
+        return n
+
+    def features_computed(self, size_t f):
+        self.check_features(f)
+        cdef bool computed
+        with nogil:
+            computed = self.project.features_computed(f)
+        return computed
+
+    def compute_features(self, size_t f, data_dir):
+        self.check_features(f)
+        cdef string dir = data_dir.encode()
+        with nogil:
+            self.project.compute_features(f, dir)
+
+    def edges_count(self, size_t f):
+        self.check_features(f)
+        cdef size_t n
+        with nogil:
+            n = self.project.edges_count(f)
+        return n
+
+    def observations(self, size_t f, size_t e):
+        """(obs_a, obs_b) of an edge as (n, 2) arrays of pixels"""
+        self.check_features(f)
+        return (self.observations_side(f, e, 0), self.observations_side(f, e, 1))
+
+    def model_solved(self, size_t m):
+        self.check_model(m)
+        cdef bool solved
+        with nogil:
+            solved = self.project.model_solved(m)
+        return solved
+
+    def model_features(self, size_t m):
+        "Index of the features graph model m is solved from, None if none"
+        self.check_model(m)
+        cdef long f
+        with nogil:
+            f = self.project.model_features(m)
+        return None if f < 0 else f
+
+    def solve(self, size_t m, data_dir):
+        self.check_model(m)
+        cdef string dir = data_dir.encode()
+        with nogil:
+            self.project.solve(m, dir)
+
+    def final_internal(self, size_t m):
+        self.check_model(m)
+        cdef np.ndarray[double, ndim=1, mode="c"] result = np.empty(4, dtype=np.float64)
+        cdef double* data = <double*> result.data
+        with nogil:
+            self.project.final_internal(m, data)
+        return result
+
+    def final_external(self, size_t m):
+        self.check_model(m)
+        cdef size_t n
+        with nogil:
+            n = self.project.cameras_count(m)
+        cdef np.ndarray[double, ndim=2, mode="c"] result = np.empty((n, 6), dtype=np.float64)
+        cdef double* data = <double*> result.data
+        if n > 0:
+            with nogil:
+                self.project.final_external(m, data)
+        return result
+
+    def final_terrain(self, size_t m):
+        self.check_model(m)
+        cdef size_t n
+        with nogil:
+            n = self.project.terrain_size(m)
+        cdef np.ndarray[double, ndim=2, mode="c"] result = np.empty((n, 3), dtype=np.float64)
+        cdef double* data = <double*> result.data
+        if n > 0:
+            with nogil:
+                self.project.final_terrain(m, data)
+        return result
+
+    def initial_solution(self, size_t m):
+        """(internal, external, terrain) of the initial solution of a Model0,
+        with the same shapes as the final values"""
+        self.check_model(m)
+        cdef size_t cameras, points
+        with nogil:
+            cameras = self.project.initial_cameras_count(m)
+            points = self.project.initial_terrain_size(m)
+        cdef np.ndarray[double, ndim=2, mode="c"] external = np.empty((cameras, 6), dtype=np.float64)
+        cdef np.ndarray[double, ndim=2, mode="c"] terrain = np.empty((points, 3), dtype=np.float64)
+        cdef double* external_data = <double*> external.data
+        cdef double* terrain_data = <double*> terrain.data
+        with nogil:
+            self.project.initial_external(m, external_data)
+            self.project.initial_terrain(m, terrain_data)
+        return (self.final_internal(m), external, terrain)
+
+    cdef observations_side(self, size_t f, size_t e, int side):
+        cdef size_t n
+        with nogil:
+            n = self.project.edge_size(f, e)
+        cdef np.ndarray[double, ndim=2, mode="c"] result = np.empty((n, 2), dtype=np.float64)
+        cdef double* data = <double*> result.data
+        if n > 0:
+            with nogil:
+                self.project.edge_observations(f, e, side, data)
+        return result
+
+    cdef check_features(self, size_t f):
+        if f >= self.features_count:
+            raise IndexError("No features graph {}".format(f))
+
+    cdef check_model(self, size_t m):
+        if m >= self.models_count:
+            raise IndexError("No model {}".format(m))
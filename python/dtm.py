@@ -1,15 +1,15 @@
 #!/usr/bin/env python3
 
-"Creates a DTM in xyzrgb format from a project.json"
+"Creates a DTM in xyzrgb format from a project"
 
 import sys
 import os.path
 import numpy as np
-from skimage import io
 
 import sensor_types
-from project import Project, pixel_size
+from project import pixel_size
 from orthoimage import get_pixel_colors, image_bounds_mask
+from image_cache import load_image
 
 sys.path.append("build")
 try: import pymodel0
@@ -23,36 +23,32 @@ def main():
     # Parse arguments
     data_root = sys.argv[1]
     project_dir = sys.argv[2]
-    model_filename = os.path.join(project_dir, "project.json")
 
     # Load project and images
-    project = Project(model_filename)
-    image_left = io.imread(os.path.join(data_root, project.data_set.filenames[0]))
-    # image_right = io.imread(os.path.join(data_root, project.data_set.filenames[1]))
-    data_set = project.data_set
+    project = pymodel0.Project(project_dir)
+    image_left = load_image(os.path.join(data_root, project.image_filename(0)))
+    rows, cols = project.image_shape
 
     # For each model
-    for (model_number, model) in enumerate(project.models):
-        solution_number = -1
-        # TODO final interface shouldn't have sol_number parameter
-        # there's only 1 final
-        # what about orthoimage?
-        cam_left = model.fexternal(solution_number)[0]
-        # cam_right = model.fexternal(solution_number)[1]
-        points = model.fterrain(solution_number)
+    for model_number in range(project.models_count):
+        if not project.model_solved(model_number):
+            continue
+        internal = project.final_internal(model_number)
+        cam_left = project.final_external(model_number)[0]
+        points = project.final_terrain(model_number)
 
         # For each point in the DTM, project to camera and extract color
-        sens_left = pymodel0.model0_projection_array(model.finternal(solution_number), cam_left, points)
-        pix_left = sensor_types.sensor_to_pixel(sens_left, pixel_size(model.finternal(solution_number)), data_set.rows, data_set.cols)
+        sens_left = pymodel0.model0_projection_array(internal, cam_left, points)
+        pix_left = sensor_types.sensor_to_pixel(sens_left, pixel_size(internal), rows, cols)
 
         # Filter out of image bounds points
         size_before_filter = pix_left.shape[0]
-        mask = image_bounds_mask(pix_left, (data_set.rows, data_set.cols))
+        mask = image_bounds_mask(pix_left, (rows, cols))
         pix_left = pix_left[mask[:,0], :]
         points = points[mask[:,0], :]
         filtered_points = size_before_filter - pix_left.shape[0]
 
-        dtm_dir = os.path.abspath(os.path.join(project_dir, "dtm{}-{}".format(model_number, type(model).__name__)))
+        dtm_dir = os.path.abspath(os.path.join(project_dir, "dtm{}".format(model_number)))
 
         if filtered_points > 0:
             print("Info: {} out of bounds pixels were filtered from {}".format(filtered_points, dtm_dir))
@@ -0,0 +1,72 @@
+"""
+Reader for the on-disk image cache of geosolve (see src/image_cache.h)
+Set GEOSOLVE_IMAGE_CACHE to the cache directory used by geosolve
+"""
+
+import os
+import struct
+import numpy as np
+from skimage import io
+
+MAGIC = b"GSIMG01\0"
+SAMPLE = 64 * 1024
+
+# numpy dtype of OpenCV depths
+DEPTHS = {0: np.uint8, 1: np.int8, 2: np.uint16, 3: np.int16, 4: np.int32, 5: np.float32, 6: np.float64}
+
+def file_key(path):
+    "FNV-1a 64 of the file's size, modification time, inode, first and last 64 KB, as ImageCache::file_key()"
+    st = os.stat(path)
+    size = st.st_size
+    h = 14695981039346656037
+    def add(data):
+        nonlocal h
+        for byte in data:
+            h = ((h ^ byte) * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    add(struct.pack("<QQQ", size, st.st_mtime_ns, st.st_ino))
+    with open(path, "rb") as f:
+        add(f.read(SAMPLE))
+        if size > SAMPLE:
+            f.seek(size - SAMPLE)
+            add(f.read(SAMPLE))
+    return "{:016x}".format(h)
+
+def level_path(cache_dir, key, scale):
+    # Same formatting as printf's %g
+    return os.path.join(cache_dir, "{}_{:g}.raw".format(key, scale))
+
+def read_raw(filename):
+    "Image stored in a raw level file, with channels in OpenCV's BGR order, or None"
+    try:
+        with open(filename, "rb") as f:
+            if f.read(8) != MAGIC:
+                return None
+            rows, cols, cvtype = struct.unpack("<3i", f.read(12))
+            dtype = DEPTHS[cvtype & 7]
+            channels = (cvtype >> 3) + 1
+            pixels = np.fromfile(f, dtype=dtype, count=rows*cols*channels)
+    except (IOError, KeyError, struct.error):
+        return None
+    if pixels.size != rows*cols*channels:
+        return None
+    if channels == 1:
+        return pixels.reshape(rows, cols)
+    return pixels.reshape(rows, cols, channels)
+
+def load_image(path, scale=1.0):
+    """
+    Image at path as an RGB array, from the cache if geosolve stored it there
+    geosolve stores the full resolution level of every image it loads. Falls
+    back to decoding the file at full resolution, which isn't cached from python
+    because skimage and OpenCV decode and resize differently
+    """
+    cache_dir = os.environ.get("GEOSOLVE_IMAGE_CACHE")
+    if cache_dir:
+        image = read_raw(level_path(cache_dir, file_key(path), scale))
+        if image is not None:
+            if image.ndim == 3 and image.shape[2] >= 3:
+                image = image[:, :, [2, 1, 0]]
+            return image
+    if scale != 1.0:
+        raise RuntimeError("{} at scale {} is not in the image cache".format(path, scale))
+    return io.imread(path)
@@ -10,6 +10,7 @@ from PIL import Image, ImageDraw
 
 import sensor_types
 from project import Project, pixel_size
+from image_cache import load_image
 
 sys.path.append("build")
 try: import pymodel0
@@ -148,13 +149,13 @@ def project_corners(internal, camera, pixel_size, im_shape, elevation):
         [-pixel_size*cols/2,  pixel_size*rows/2],
         [ pixel_size*cols/2, -pixel_size*rows/2],
         [-pixel_size*cols/2, -pixel_size*rows/2]])
-    return np.array([pymodel0.model0_inverse(internal, camera, pix, elevation) for pix in points_image])
+    return pymodel0.model0_inverse_array(internal, camera, points_image, elevation)[:, :2]
 
 # Produce orthoimage at elevation = 0 for some iterations (e.g. first and last)
 def produce_flat_orthoimages(data_root, project_dir, data_set, model, model_number):
     elevation = 0
-    left = io.imread(os.path.join(data_root, data_set.filenames[0]))
-    right = io.imread(os.path.join(data_root, data_set.filenames[1]))
+    left = load_image(os.path.join(data_root, data_set.filenames[0]))
+    right = load_image(os.path.join(data_root, data_set.filenames[1]))
     image_shape = left.shape
 
     tile_dir = os.path.abspath(os.path.join(project_dir, "flatortho{}-{}".format(model_number, type(model).__name__)))
@@ -24,17 +24,73 @@ class ImageGraph(object):
         self.computed = data["computed"]
         self.edges = [ObsPair(d) for d in data["edges"]]
 
+class SolutionHistory(object):
+    """
+    Sequence of a model's logged solutions
+    Delta encoded intermediate solutions are decoded on access
+    """
+
+    def __init__(self, data, Solution):
+        self.Solution = Solution
+        # Histories saved before encodings were introduced are plain lists
+        if isinstance(data, list):
+            data = {"encoding": "full", "quantum": 0, "full": data, "deltas": []}
+        self.full = [Solution(sol) for sol in data["full"]]
+
+        if data["encoding"] == "full":
+            self.totals = None
+        elif data["encoding"] == "delta":
+            # Integer steps of each intermediate solution away from the first
+            self.quantum = data["quantum"]
+            deltas = np.array(data["deltas"], dtype=np.int64).reshape(len(data["deltas"]), -1)
+            self.totals = np.cumsum(deltas, axis=0)
+        else:
+            raise ValueError("Unknown solution history encoding: {}".format(data["encoding"]))
+
+    def __len__(self):
+        if self.totals is None:
+            return len(self.full)
+        return self.totals.shape[0] + 2
+
+    def __getitem__(self, index):
+        if self.totals is None:
+            return self.full[index]
+        if index < 0:
+            index += len(self)
+        if index < 0 or index >= len(self):
+            raise IndexError("solution index out of range")
+        if index == 0:
+            return self.full[0]
+        if index == len(self) - 1:
+            return self.full[1]
+        first = self.full[0]
+        flat = first.flatten() + self.quantum * self.totals[index - 1]
+        return first.unflatten(flat)
+
 class Model0Solution(object):
     def __init__(self, data, ptrmap=None):
+        if data is None:
+            return
         self.cameras = np.array(data["cameras"], dtype=np.float64)
         self.terrain = np.array(data["terrain"], dtype=np.float64)
 
+    def flatten(self):
+        return np.concatenate((self.cameras.ravel(), self.terrain.ravel()))
+
+    def unflatten(self, flat):
+        "New solution of the same shape from flat values"
+        sol = Model0Solution(None)
+        n = self.cameras.size
+        sol.cameras = flat[:n].reshape(self.cameras.shape)
+        sol.terrain = flat[n:].reshape(self.terrain.shape)
+        return sol
+
 class Model0(object):
     def __init__(self, data, ptrmap=None):
         if ptrmap is not None:
             self.features = ptrmap.load(ImageGraph, data["base"]["features"])
         self.internal = np.array(data["internal"], dtype=np.float64)
-        self.solutions = [Model0Solution(sol) for sol in data["solutions"]]
+        self.solutions = SolutionHistory(data["solutions"], Model0Solution)
 
     def fexternal(self, solution_number):
         return self.solutions[solution_number].cameras
@@ -49,15 +105,26 @@ class Model0(object):
 
 class ModelTerrainSolution(object):
     def __init__(self, data, ptrmap=None):
+        if data is None:
+            return
         self.terrain = np.array(data["terrain"], dtype=np.float64)
 
+    def flatten(self):
+        return self.terrain.ravel()
+
+    def unflatten(self, flat):
+        "New solution of the same shape from flat values"
+        sol = ModelTerrainSolution(None)
+        sol.terrain = flat.reshape(self.terrain.shape)
+        return sol
+
 class ModelTerrain(object):
     def __init__(self, data, ptrmap=None):
         if ptrmap is not None:
             self.features = ptrmap.load(ImageGraph, data["base"]["features"])
         self.internal = np.array(data["internal"], dtype=np.float64)
         self.cameras = np.array(data["cameras"], dtype=np.float64)
-        self.solutions = [ModelTerrainSolution(sol) for sol in data["solutions"]]
+        self.solutions = SolutionHistory(data["solutions"], ModelTerrainSolution)
 
     # Interfaces
     def fexternal(self, solution_number):
@@ -69,9 +136,48 @@ class ModelTerrain(object):
     def fterrain(self, solution_number):
         return self.solutions[solution_number].terrain
 
+class ModelMulti(object):
+    "Model0 over all edges, solutions have the same shape as Model0's"
+    def __init__(self, data, ptrmap=None):
+        if ptrmap is not None:
+            self.features = ptrmap.load(ImageGraph, data["base"]["features"])
+        self.internal = np.array(data["internal"], dtype=np.float64)
+        self.solutions = SolutionHistory(data["solutions"], Model0Solution)
+
+    def fexternal(self, solution_number):
+        return self.solutions[solution_number].cameras
+
+    def finternal(self, solution_number):
+        return self.internal
+
+    def fterrain(self, solution_number):
+        terrain = self.solutions[solution_number].terrain
+        n = terrain.shape[0]
+        return np.hstack((terrain, np.zeros((n, 1))))
+
+class ModelDense(object):
+    "Dense terrain of a camera pair, with a single solution"
+    def __init__(self, data, ptrmap=None):
+        if ptrmap is not None:
+            self.features = ptrmap.load(ImageGraph, data["base"]["features"])
+        self.internal = np.array(data["internal"], dtype=np.float64)
+        self.cameras = np.array(data["cameras"], dtype=np.float64)
+        self.terrain = np.array(data["terrain"], dtype=np.float64).reshape(-1, 3)
+
+    def fexternal(self, solution_number):
+        return self.cameras
+
+    def finternal(self, solution_number):
+        return self.internal
+
+    def fterrain(self, solution_number):
+        return self.terrain
+
 polymorphic_models = {
     "Model0": Model0,
-    "ModelTerrain": ModelTerrain
+    "ModelTerrain": ModelTerrain,
+    "ModelMulti": ModelMulti,
+    "ModelDense": ModelDense
 }
 
 class PtrMap(object):
@@ -1,36 +1,42 @@
 #!/usr/bin/env python3
 
 import sys
-import os.path
 import numpy as np
 import matplotlib.pyplot as plt
 
 import sensor_types
-from project import Project
+from project import pixel_size
 
 sys.path.append("build")
 try: import pymodel0
 except: print("Error importing pymodel0"); sys.exit(-1)
 
-def compute_residuals(project, solution_number):
-    terrain = np.hstack((project.model.solutions[solution_number].terrain, np.zeros((len(project.model.solutions[0].terrain), 1))))
-
+def compute_residuals(internal, camera, terrain, observations, rows, cols):
     # in model0 all points are visible in all cams
-    image_pixels = pymodel0.model0_projection_array(project.model.internal, project.model.solutions[solution_number].cameras[0], terrain)
+    image_pixels = pymodel0.model0_projection_array(internal, camera, terrain)
     # subtract to features
-    pix = sensor_types.sensor_to_pixel(image_pixels, project.model.pixel_size, project.model.rows, project.model.cols)
-    residuals = pix - project.features.edges[0].obs_a
-    return residuals
+    pix = sensor_types.sensor_to_pixel(image_pixels, pixel_size(internal), rows, cols)
+    return pix - observations
 
 def main():
     project_dir = sys.argv[1]
-    model_filename = os.path.join(project_dir, "project.json")
-    project = Project(model_filename)
-
-    residuals = compute_residuals(project, 0)
+    model_number = int(sys.argv[2]) if len(sys.argv) > 2 else 0
+
+    project = pymodel0.Project(project_dir)
+    rows, cols = project.image_shape
+    features = project.model_features(model_number)
+    if features is None:
+        print("Model {} has no features".format(model_number)); sys.exit(-1)
+    obs_a = project.observations(features, 0)[0]
+
+    # Initial solution, from the model's logged solutions
+    internal, external, terrain = project.initial_solution(model_number)
+    residuals = compute_residuals(internal, external[0], terrain, obs_a, rows, cols)
     plt.plot(residuals[:,0], residuals[:,1], '.', color="k")
 
-    residuals = compute_residuals(project, -1)
+    # Final solution
+    internal = project.final_internal(model_number)
+    residuals = compute_residuals(internal, project.final_external(model_number)[0], project.final_terrain(model_number), obs_a, rows, cols)
     plt.plot(residuals[:,0], residuals[:,1], '+', color="k")
 
     plt.show()
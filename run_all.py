@@ -18,8 +18,56 @@ def features_analysis():
     system("./python/features_analysis.py ../results/features_analysis")
     system("./python/features_table.py ../results/features_analysis")
 
+def features_benchmark():
+    "Detector/descriptor timings and compressed descriptor recall, to ../results/features_analysis/*.csv"
+    system("./build/features_analysis ../data ../results --benchmark")
+    system("./build/features_analysis ../data ../results --compression")
+
+def benchmarks():
+    "Run the benchmark suite, results are written to ../results/benchmarks.json"
+    build()
+    system("mkdir -p ../results")
+    system("./build/benchmarks --json ../results/benchmarks.json")
+
+def perf_gate():
+    "Compare performance to benchmarks/perf_baseline.json, fails on regressions"
+    build()
+    system("./benchmarks/perf_gate.py")
+
+def synth_scaling():
+    "Solve synthetic scenes of increasing size and compare them to ground truth"
+    import json
+    build()
+    for points in [100, 1000, 10000, 100000, 1000000]:
+        project_dir = "../results/synth/{}".format(points)
+        system("mkdir -p {}".format(project_dir))
+        options_file = os.path.join(project_dir, "synth.json")
+        if not os.path.exists(options_file):
+            system("./build/geosolve ../data {} synth".format(project_dir))
+        with open(options_file) as f:
+            options = json.load(f)
+        options["points"] = points
+        with open(options_file, "w") as f:
+            json.dump(options, f, indent=4)
+        system("./build/geosolve ../data {} synth".format(project_dir))
+        system("time -p ./build/geosolve ../data {} solve".format(project_dir))
+        system("./build/geosolve ../data {} synth_error".format(project_dir))
+
+def multires():
+    "Compare a cold full resolution solve with the coarse-to-fine multires command"
+    for mode, commands in [("cold", ["features", "solve"]), ("multires", ["multires"])]:
+        project_dir = "../results/multires/{}".format(mode)
+        system("mkdir -p {}".format(project_dir))
+        system("./build/geosolve ../data {} base_model0_200".format(project_dir))
+        for command in commands:
+            system("time -p ./build/geosolve ../data {} {}".format(project_dir, command))
+
 def geosolve_dir(name):
-    "Run all of a given geosolve result directory"
+    """
+    Run all of a given geosolve result directory
+    Set GEOSOLVE_SERVER to the socket of a running './build/geosolve serve <socket>'
+    to have geosolve commands executed by the resident server
+    """
 
     project_dir = os.path.join("../results/geosolve", name)
 
@@ -35,9 +83,9 @@ def geosolve_dir(name):
     system("mkdir -p {}".format(project_dir))
     do_log("./build/geosolve ../data {} base_{}".format(project_dir, name))
     do_log("./build/geosolve ../data {} model_terrain".format(project_dir, name))
-    do_log("./build/geosolve ../data {} features".format(project_dir))
-    do_log("./build/geosolve ../data {} solve".format(project_dir))
-    do_log("./build/geosolve ../data {} bootstrap".format(project_dir))
+    do_log("./build/geosolve ../data {} run".format(project_dir))
+    do_log("./build/geosolve ../data {} dem".format(project_dir))
+    do_log("./build/geosolve ../data {} export_octree".format(project_dir))
     do_log("./python/orthoimage.py ../data {}".format(project_dir))
     do_log("./python/dtm.py ../data {}".format(project_dir))
     # Call potree.py on all dtm* directoris
@@ -0,0 +1,66 @@
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "camera_models.h"
+#include "batch_kernels.h"
+
+// Small batches aren't worth starting threads for
+static const size_t min_rows_per_thread = 4096;
+
+// Call f(begin, end) over contiguous slices of [0, n)
+static void parallel_rows(size_t n, size_t num_threads, const std::function<void (size_t, size_t)>& f) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    num_threads = std::max<size_t>(1, std::min(num_threads, n / min_rows_per_thread));
+    const size_t slice = (n + num_threads - 1) / num_threads;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++) {
+        const size_t begin = std::min(n, t * slice);
+        threads.push_back(std::thread(f, begin, std::min(n, begin + slice)));
+    }
+    f(0, std::min(n, slice));
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void model0_projection_batch(const double* internal,
+                             const double* external,
+                             const double* points, size_t n, size_t point_stride,
+                             double* result,
+                             size_t num_threads) {
+    parallel_rows(n, num_threads, [=](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            model0_projection<double, double>(internal, external, points + k*point_stride, result + 2*k);
+        }
+    });
+}
+
+void pinhole_projection_batch(const double* internal,
+                              const double* external,
+                              const double* points, size_t n, size_t point_stride,
+                              double* result,
+                              size_t num_threads) {
+    parallel_rows(n, num_threads, [=](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            pinhole_projection<double, double, double, double>(internal, external, points + k*point_stride, result + 2*k);
+        }
+    });
+}
+
+void model0_image_to_world_batch(const double* internal,
+                                 const double* external,
+                                 const double* pix, size_t n, size_t pix_stride,
+                                 double elevation,
+                                 double* result, size_t result_stride,
+                                 size_t num_threads) {
+    parallel_rows(n, num_threads, [=](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            double* out = result + k*result_stride;
+            image_to_world<double>(internal, external, pix + k*pix_stride, &elevation, &out[0], &out[1]);
+        }
+    });
+}
@@ -0,0 +1,35 @@
+#ifndef BATCH_KERNELS_H
+#define BATCH_KERNELS_H
+
+#include <cstddef>
+
+// Camera model kernels applied to whole arrays of points at once
+// Arrays are row major, point arrays have point_stride doubles per row of which
+// the first two (model0) or three (pinhole) are used, so terrain arrays can be
+// passed as they are. Rows are split between num_threads threads, 0 uses the
+// hardware concurrency. These never touch Python objects and can run without the GIL.
+
+// model0_projection of each point, result is (n, 2)
+void model0_projection_batch(const double* internal,
+                             const double* external,
+                             const double* points, size_t n, size_t point_stride,
+                             double* result,
+                             size_t num_threads = 0);
+
+// pinhole_projection of each point, result is (n, 2)
+void pinhole_projection_batch(const double* internal,
+                              const double* external,
+                              const double* points, size_t n, size_t point_stride,
+                              double* result,
+                              size_t num_threads = 0);
+
+// image_to_world of each sensor point at a fixed elevation
+// result is (n, result_stride), only the first two columns are written
+void model0_image_to_world_batch(const double* internal,
+                                 const double* external,
+                                 const double* pix, size_t n, size_t pix_stride,
+                                 double elevation,
+                                 double* result, size_t result_stride,
+                                 size_t num_threads = 0);
+
+#endif
@@ -1,5 +1,11 @@
 #include <random>
+#include <string>
+#include <cstdlib>
+#include <cerrno>
+#include <stdexcept>
 #include "bootstrap.h"
+#include "trace.h"
+#include "cancellation.h"
 
 typedef std::mt19937 RandomNumberGenerator;
 using std::vector;
@@ -15,44 +21,67 @@ vector<size_t> sample_with_replacement(RandomNumberGenerator& rng, size_t vector
     return result;
 }
 
-// Sample a vector by a vector of indexes
-template<typename T>
-vector<T> sample(const vector<T>& input, vector<size_t> indexes) {
-    vector<T> output(indexes.size());
-    for (size_t i = 0; i < indexes.size(); i++) {
-        output[i] = input[indexes[i]];
+bool environment_seed(unsigned long& seed) {
+    const char* value = std::getenv("GEOSOLVE_SEED");
+    if (value == NULL) {
+        return false;
     }
-    return output;
+    const std::string s(value);
+    // strtoul accepts signs and leading spaces, a seed is digits only
+    if (s.empty() || s.size() > 20 || s.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error("GEOSOLVE_SEED must be an unsigned integer, got '" + s + "'");
+    }
+    errno = 0;
+    seed = std::strtoul(value, NULL, 10);
+    if (errno == ERANGE) {
+        throw std::runtime_error("GEOSOLVE_SEED is out of range: " + s);
+    }
+    return true;
 }
 
 void Bootstrap::solve() {
+    TRACE_SCOPE("bootstrap");
     // Uniform distribution for sampling observations
-    std::random_device rd;
-    RandomNumberGenerator rng(rd());
+    // GEOSOLVE_SEED makes the samples reproducible, for performance comparisons
+    unsigned long seed;
+    if (!environment_seed(seed)) {
+        std::random_device rd;
+        seed = rd();
+    }
+    RandomNumberGenerator rng(seed);
 
-    // For each bootstrap sample
-    for (size_t i = 0; i < number_of_samples; i++) {
+    // For each bootstrap sample, until the command is cancelled
+    size_t completed = 0;
+    for (size_t i = 0; i < number_of_samples && !CancellationToken::command().cancelled(); i++) {
         std::cout << '\r' << i+1 << "/" << number_of_samples;
         std::cout.flush();
 
         // Deep-copy base model using 'virtual constructor' idiom
+        TraceScope clone_scope("bootstrap_clone");
         shared_ptr<Model> bs_sample(base_model->clone());
-        bs_sample->features.reset(new FeaturesGraph(*bs_sample->features));
-
-        // Only consider first edge for now, this should be extended
-        obs_pair& edge = bs_sample->features->edges[0];
+        clone_scope.end();
 
         // Bootstrap and solve
-        vector<size_t> indexes = sample_with_replacement(rng, edge.obs_a.size(), size_of_samples);
-        bs_sample->features->number_of_matches = size_of_samples;
-        edge.obs_a = sample(edge.obs_a, indexes);
-        edge.obs_b = sample(edge.obs_b, indexes);
+        // Only consider first edge for now, this should be extended
+        // The sample's graph holds the resampled index pairs of that edge and
+        // shares the keypoint tables of the base model's graph
+        TraceScope resample_scope("bootstrap_resample");
+        vector<size_t> indexes = sample_with_replacement(rng, base_model->features->edges[0].size(), size_of_samples);
+        bs_sample->features = std::make_shared<FeaturesGraph>(base_model->features->resampled_edge(0, indexes));
+        resample_scope.end();
         bs_sample->options.minimizer_progress_to_stdout = false;
         bs_sample->solve();
+        if (bs_sample->solve_record.partial) {
+            break; // An unconverged sample would bias the distribution
+        }
 
         // Save
         externals.push_back(bs_sample->final_external());
         internals.push_back(bs_sample->final_internal());
+        solve_records.push_back(bs_sample->solve_record);
+        completed++;
     }
     std::cout << std::endl;
+    // Keep the samples of a cancelled run
+    number_of_samples = completed;
 }
@@ -15,6 +15,10 @@
 #include "model.h"
 #include "internal.h"
 
+// Seed of bootstrap samples from GEOSOLVE_SEED, which makes them reproducible
+// Returns false if it isn't set, throws if it isn't an unsigned integer
+bool environment_seed(unsigned long& seed);
+
 // Takes a Model and perform the bootstrap method on it
 class Bootstrap {
 public:
@@ -27,6 +31,9 @@ public:
            NVP(base_model),
            NVP(internals),
            NVP(externals));
+        if (archive_version() > 0) {
+            ar(NVP(solve_records));
+        }
     }
 
     size_t number_of_samples;
@@ -35,6 +42,7 @@ public:
 
     std::vector<internal_t> internals;
     std::vector<std::vector<std::array<double, 6>>> externals;
+    std::vector<SolveRecord> solve_records; // One per sample
 };
 
 #endif
@@ -0,0 +1,42 @@
+#include "cancellation.h"
+
+static thread_local CancellationToken* installed = nullptr;
+
+CancellationToken& CancellationToken::command() {
+    return installed != nullptr ? *installed : process();
+}
+
+CancellationToken& CancellationToken::process() {
+    static CancellationToken token;
+    return token;
+}
+
+CommandTokenScope::CommandTokenScope(CancellationToken& token) : saved(installed) {
+    installed = &token;
+}
+
+CommandTokenScope::~CommandTokenScope() {
+    installed = saved;
+}
+
+void CancellationToken::set_budget(double seconds) {
+    if (seconds <= 0) {
+        deadline.store(0, std::memory_order_relaxed);
+        return;
+    }
+    const clock::duration budget = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+    deadline.store((clock::now() + budget).time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+void CancellationToken::reset() {
+    requested.store(false, std::memory_order_relaxed);
+    deadline.store(0, std::memory_order_relaxed);
+}
+
+bool CancellationToken::cancelled() const {
+    if (requested.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    const int64_t d = deadline.load(std::memory_order_relaxed);
+    return d != 0 && clock::now().time_since_epoch().count() >= d;
+}
@@ -0,0 +1,56 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Cooperative cancellation of long running work
+// Work polls cancelled() at points where it can stop with a usable result.
+// The token is cancelled by cancel(), which is safe to call from a signal
+// handler, or once the deadline of a time budget has passed.
+class CancellationToken {
+public:
+    CancellationToken() : requested(false), deadline(0) {}
+
+    // Token of the geosolve command run by the calling thread: the one installed
+    // by a CommandTokenScope, the process token otherwise
+    static CancellationToken& command();
+
+    // Token of the command run from the command line, cancelled by signals
+    static CancellationToken& process();
+
+    void cancel() { requested.store(true, std::memory_order_relaxed); }
+
+    // Cancel seconds from now, <= 0 removes the budget
+    void set_budget(double seconds);
+
+    // Clear the cancellation and the budget
+    void reset();
+
+    bool cancelled() const;
+
+private:
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    typedef std::chrono::steady_clock clock;
+    std::atomic<bool> requested;
+    std::atomic<int64_t> deadline; // clock ticks since epoch, 0 if none
+};
+
+// Makes token the command token of the calling thread for the scope's lifetime
+// Each request of the geosolve server runs under its own token, and threads
+// working for a command install the command's token.
+class CommandTokenScope {
+public:
+    explicit CommandTokenScope(CancellationToken& token);
+    ~CommandTokenScope();
+
+private:
+    CommandTokenScope(const CommandTokenScope&) = delete;
+    CommandTokenScope& operator=(const CommandTokenScope&) = delete;
+    CancellationToken* saved;
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include <cmath>
+#include <queue>
+#include <thread>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include "dem.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+TerrainIndex::TerrainIndex(const vector<array<double, 3>>& points, double cell_size) : pts(points) {
+    if (pts.empty()) {
+        throw std::runtime_error("Cannot index an empty terrain.");
+    }
+
+    // Bounding box
+    x0 = x1 = pts[0][0];
+    y0 = y1 = pts[0][1];
+    for (auto& p : pts) {
+        x0 = std::min(x0, p[0]);
+        x1 = std::max(x1, p[0]);
+        y0 = std::min(y0, p[1]);
+        y1 = std::max(y1, p[1]);
+    }
+
+    // Default to about one point per cell
+    if (cell_size <= 0.0) {
+        double area = (x1 - x0) * (y1 - y0);
+        cell_size = area > 0.0 ? std::sqrt(area / pts.size()) : 1.0;
+    }
+    cell = cell_size;
+    nx = static_cast<size_t>((x1 - x0) / cell) + 1;
+    ny = static_cast<size_t>((y1 - y0) / cell) + 1;
+
+    // Counting sort of the points by cell
+    vector<size_t> cell_ids(pts.size());
+    start.assign(nx*ny + 1, 0);
+    for (size_t n = 0; n < pts.size(); n++) {
+        cell_ids[n] = cell_of(pts[n][1], y0, ny) * nx + cell_of(pts[n][0], x0, nx);
+        start[cell_ids[n] + 1]++;
+    }
+    for (size_t c = 0; c < nx*ny; c++) {
+        start[c + 1] += start[c];
+    }
+    order.resize(pts.size());
+    vector<size_t> fill(start.begin(), start.end() - 1);
+    for (size_t n = 0; n < pts.size(); n++) {
+        order[fill[cell_ids[n]]++] = n;
+    }
+}
+
+// Cell coordinate along one axis, clamped to the grid
+size_t TerrainIndex::cell_of(double v, double origin, size_t n) const {
+    double c = std::floor((v - origin) / cell);
+    if (c < 0.0) return 0;
+    if (c >= static_cast<double>(n)) return n - 1;
+    return static_cast<size_t>(c);
+}
+
+vector<size_t> TerrainIndex::nearest(double x, double y, size_t k) const {
+    typedef std::pair<double, size_t> candidate; // (squared distance, point index)
+    std::priority_queue<candidate> best; // max-heap of the k best so far
+    k = std::min(k, pts.size());
+    if (k == 0) {
+        return vector<size_t>();
+    }
+
+    const long cx = static_cast<long>(cell_of(x, x0, nx));
+    const long cy = static_cast<long>(cell_of(y, y0, ny));
+    const long max_ring = static_cast<long>(std::max(nx, ny));
+
+    // Visit rings of cells at increasing Chebyshev distance from the query cell
+    for (long r = 0; r <= max_ring; r++) {
+        for (long j = cy - r; j <= cy + r; j++) {
+            if (j < 0 || j >= static_cast<long>(ny)) continue;
+            // Only the border of the ring, except for the top and bottom rows
+            const long step = (j == cy - r || j == cy + r) ? 1 : std::max(2*r, 1L);
+            for (long i = cx - r; i <= cx + r; i += step) {
+                if (i < 0 || i >= static_cast<long>(nx)) continue;
+                const size_t c = static_cast<size_t>(j) * nx + static_cast<size_t>(i);
+                for (size_t o = start[c]; o < start[c + 1]; o++) {
+                    const size_t n = order[o];
+                    const double dx = pts[n][0] - x;
+                    const double dy = pts[n][1] - y;
+                    const double d2 = dx*dx + dy*dy;
+                    if (best.size() < k) {
+                        best.push(candidate(d2, n));
+                    } else if (d2 < best.top().first) {
+                        best.pop();
+                        best.push(candidate(d2, n));
+                    }
+                }
+            }
+        }
+
+        // Any point in the next ring is at least r cells away
+        const double bound = r * cell;
+        if (best.size() == k && best.top().first <= bound*bound) {
+            break;
+        }
+    }
+
+    vector<size_t> result(best.size());
+    for (size_t n = result.size(); n > 0; n--) {
+        result[n - 1] = best.top().second;
+        best.pop();
+    }
+    return result;
+}
+
+double idw_elevation(const TerrainIndex& index, double x, double y, const IDWParameters& params) {
+    const vector<array<double, 3>>& points = index.points();
+    double sum_weights = 0.0;
+    double sum_values = 0.0;
+    for (size_t n : index.nearest(x, y, params.neighbours)) {
+        const double dx = points[n][0] - x;
+        const double dy = points[n][1] - y;
+        const double d = std::sqrt(dx*dx + dy*dy);
+        if (d > params.max_distance) {
+            break;
+        }
+        // Exactly on a point
+        if (d == 0.0) {
+            return points[n][2];
+        }
+        const double w = 1.0 / std::pow(d, params.power);
+        sum_weights += w;
+        sum_values += w * points[n][2];
+    }
+    if (sum_weights == 0.0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return sum_values / sum_weights;
+}
+
+DEM DEM::from_terrain(const vector<array<double, 3>>& points,
+                      double gsd,
+                      const IDWParameters& params,
+                      size_t num_threads) {
+    if (gsd <= 0.0) {
+        throw std::runtime_error("Invalid DEM ground sampling distance: " + std::to_string(gsd));
+    }
+    TerrainIndex index(points);
+
+    DEM dem;
+    dem.gsd = gsd;
+    dem.origin_x = index.min_x();
+    dem.origin_y = index.max_y();
+    dem.cols = static_cast<size_t>((index.max_x() - index.min_x()) / gsd) + 1;
+    dem.rows = static_cast<size_t>((index.max_y() - index.min_y()) / gsd) + 1;
+    dem.heights.resize(dem.rows * dem.cols);
+
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    num_threads = std::min(num_threads, dem.rows);
+
+    // Interleave rows between threads to balance sparse and dense areas
+    auto worker = [&](size_t first) {
+        for (size_t i = first; i < dem.rows; i += num_threads) {
+            const double y = dem.origin_y - i * gsd;
+            for (size_t j = 0; j < dem.cols; j++) {
+                dem.at(i, j) = idw_elevation(index, dem.origin_x + j * gsd, y, params);
+            }
+        }
+    };
+
+    vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++) {
+        threads.push_back(std::thread(worker, t));
+    }
+    worker(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+    return dem;
+}
+
+double DEM::elevation_at(double x, double y) const {
+    const double fj = (x - origin_x) / gsd;
+    const double fi = (origin_y - y) / gsd;
+    if (rows == 0 || cols == 0 || fi < 0.0 || fj < 0.0 || fi > rows - 1 || fj > cols - 1) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    const size_t i0 = static_cast<size_t>(fi);
+    const size_t j0 = static_cast<size_t>(fj);
+    const size_t i1 = std::min(i0 + 1, rows - 1);
+    const size_t j1 = std::min(j0 + 1, cols - 1);
+    const double di = fi - i0;
+    const double dj = fj - j0;
+
+    return (1 - di) * ((1 - dj) * at(i0, j0) + dj * at(i0, j1))
+         +      di  * ((1 - dj) * at(i1, j0) + dj * at(i1, j1));
+}
+
+void DEM::write_ascii_grid(const string& filename) const {
+    std::ofstream ofs(filename);
+    if (!ofs.good()) {
+        throw std::runtime_error("Can't open " + filename);
+    }
+    const double nodata = -9999;
+
+    // Header corner is the lower left corner of the lower left pixel
+    ofs << std::setprecision(12);
+    ofs << "ncols " << cols << "\n"
+        << "nrows " << rows << "\n"
+        << "xllcorner " << origin_x - gsd/2 << "\n"
+        << "yllcorner " << origin_y - (rows - 1) * gsd - gsd/2 << "\n"
+        << "cellsize " << gsd << "\n"
+        << "NODATA_value " << nodata << "\n";
+
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            const double h = at(i, j);
+            ofs << (std::isnan(h) ? nodata : h) << (j + 1 < cols ? " " : "\n");
+        }
+    }
+}
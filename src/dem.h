@@ -0,0 +1,79 @@
+#ifndef DEM_H
+#define DEM_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <limits>
+
+// Uniform grid spatial index over scattered terrain points
+// Points are bucketed by their (x, y) coordinates, elevation is ignored
+class TerrainIndex {
+public:
+    // cell_size <= 0 picks a size giving about one point per cell
+    TerrainIndex(const std::vector<std::array<double, 3>>& points, double cell_size = 0.0);
+
+    // Indexes of the (at most) k nearest points to (x, y), closest first
+    std::vector<size_t> nearest(double x, double y, size_t k) const;
+
+    // Bounding box of the indexed points
+    double min_x() const { return x0; }
+    double min_y() const { return y0; }
+    double max_x() const { return x1; }
+    double max_y() const { return y1; }
+    double cell_size() const { return cell; }
+
+    const std::vector<std::array<double, 3>>& points() const { return pts; }
+
+private:
+    size_t cell_of(double v, double origin, size_t n) const;
+
+    std::vector<std::array<double, 3>> pts;
+    double x0, y0, x1, y1;
+    double cell;
+    size_t nx, ny;
+    // Compressed buckets: points of cell c are order[start[c]] to order[start[c+1]-1]
+    std::vector<size_t> start;
+    std::vector<size_t> order;
+};
+
+// Inverse distance weighting parameters
+struct IDWParameters {
+    IDWParameters() : neighbours(8), power(2.0), max_distance(std::numeric_limits<double>::infinity()) {}
+    size_t neighbours; // Number of nearest points used per estimate
+    double power; // Distance exponent
+    double max_distance; // Points further than this are ignored, no data if none is left
+};
+
+// Inverse distance weighted elevation at (x, y), NaN if no point is close enough
+double idw_elevation(const TerrainIndex& index, double x, double y, const IDWParameters& params);
+
+// Regular grid Digital Elevation Model
+// Pixel (i, j) is centered on world (origin_x + j*gsd, origin_y - i*gsd)
+struct DEM {
+    DEM() : origin_x(0.0), origin_y(0.0), gsd(0.0), rows(0), cols(0) {}
+
+    // Rasterize scattered terrain points by IDW, output rows are processed in parallel
+    // num_threads == 0 uses the hardware concurrency
+    static DEM from_terrain(const std::vector<std::array<double, 3>>& points,
+                            double gsd,
+                            const IDWParameters& params = IDWParameters(),
+                            size_t num_threads = 0);
+
+    // Bilinear interpolation of the raster at world (x, y)
+    // NaN outside of the grid or next to no data pixels
+    double elevation_at(double x, double y) const;
+
+    double& at(size_t i, size_t j) { return heights[i*cols + j]; }
+    const double& at(size_t i, size_t j) const { return heights[i*cols + j]; }
+
+    // Write in ESRI ASCII grid format (.asc)
+    void write_ascii_grid(const std::string& filename) const;
+
+    double origin_x, origin_y; // World coordinates of the center of pixel (0, 0)
+    double gsd; // Ground sampling distance
+    size_t rows, cols;
+    std::vector<double> heights; // Row major, NaN is no data
+};
+
+#endif
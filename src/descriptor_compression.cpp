@@ -0,0 +1,92 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "descriptor_compression.h"
+
+using std::vector;
+
+void DescriptorCompressor::train(const cv::Mat& samples) {
+    if (samples.rows < dims || dims <= 0 || dims > samples.cols) {
+        throw std::runtime_error("Cannot train a " + std::to_string(dims) + " dimension descriptor compression from "
+                                 + std::to_string(samples.rows) + " samples");
+    }
+    cv::Mat data;
+    samples.convertTo(data, CV_32F);
+    cv::PCA pca(data, cv::noArray(), cv::PCA::DATA_AS_ROW, dims);
+
+    length = data.cols;
+    mean.assign(pca.mean.ptr<float>(), pca.mean.ptr<float>() + length);
+    components.assign(pca.eigenvectors.ptr<float>(), pca.eigenvectors.ptr<float>() + dims * length);
+
+    // Quantize so that the first component's +/- 3 standard deviations fill int8
+    const float deviation = std::sqrt(std::max(pca.eigenvalues.at<float>(0), 1e-12f));
+    scale = 127.0f / (3.0f * deviation);
+}
+
+cv::Mat DescriptorCompressor::compress(const cv::Mat& descriptors) const {
+    if (!trained()) {
+        throw std::runtime_error("DescriptorCompressor used before training");
+    }
+    cv::Mat data;
+    descriptors.convertTo(data, CV_32F);
+    if (data.cols != length) {
+        throw std::runtime_error("Descriptor length doesn't match the trained compression");
+    }
+
+    cv::Mat compressed(data.rows, dims, CV_8S);
+    for (int r = 0; r < data.rows; r++) {
+        const float* d = data.ptr<float>(r);
+        signed char* out = compressed.ptr<signed char>(r);
+        for (int k = 0; k < dims; k++) {
+            const float* component = &components[k * length];
+            float projection = 0.0f;
+            for (int i = 0; i < length; i++) {
+                projection += (d[i] - mean[i]) * component[i];
+            }
+            out[k] = cv::saturate_cast<signed char>(projection * scale);
+        }
+    }
+    return compressed;
+}
+
+cv::Mat DescriptorCompressor::decompress(const cv::Mat& compressed) const {
+    cv::Mat projected;
+    compressed.convertTo(projected, CV_32F, 1.0 / static_cast<double>(scale));
+    return projected;
+}
+
+vector<cv::DMatch> match_compressed(const DescriptorCompressor& compressor,
+                                    const cv::Mat& compressed1, const cv::Mat& compressed2) {
+    vector<cv::DMatch> matches;
+    cv::FlannBasedMatcher matcher;
+    matcher.match(compressor.decompress(compressed1), compressor.decompress(compressed2), matches);
+    std::stable_sort(matches.begin(), matches.end(), [](const cv::DMatch& a, const cv::DMatch& b) {
+        return a.distance < b.distance;
+    });
+    return matches;
+}
+
+double match_recall(const vector<cv::DMatch>& reference, const vector<cv::DMatch>& matches, size_t n) {
+    n = std::min(n, reference.size());
+    if (n == 0) {
+        return 0.0;
+    }
+    // Train index matched by each query keypoint
+    int max_query = 0;
+    for (auto& m : matches) {
+        max_query = std::max(max_query, m.queryIdx);
+    }
+    vector<int> train(max_query + 1, -1);
+    for (auto& m : matches) {
+        train[m.queryIdx] = m.trainIdx;
+    }
+
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++) {
+        const cv::DMatch& m = reference[i];
+        if (m.queryIdx <= max_query && train[m.queryIdx] == m.trainIdx) {
+            found++;
+        }
+    }
+    return static_cast<double>(found) / static_cast<double>(n);
+}
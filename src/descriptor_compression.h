@@ -0,0 +1,47 @@
+#ifndef DESCRIPTOR_COMPRESSION_H
+#define DESCRIPTOR_COMPRESSION_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <cereal/types/vector.hpp>
+
+// Compression of float descriptors (e.g. 128 dimensional SIFT) for matching
+// Descriptors are projected on their first principal components, learned from
+// a sample of the project's descriptors, and quantized to int8. A 32 dimension
+// projection stores 32 bytes per keypoint instead of 512, and matching works on
+// 4 times shorter vectors.
+class DescriptorCompressor {
+public:
+    explicit DescriptorCompressor(int dims = 0) : dims(dims), length(0), scale(1.0f) {}
+
+    // Learn the projection to dims dimensions from descriptors, one per row
+    void train(const cv::Mat& samples);
+    bool trained() const { return dims > 0 && length > 0; }
+
+    // CV_8S rows of dims values
+    cv::Mat compress(const cv::Mat& descriptors) const;
+    // CV_32F rows of dims values, for matching compressed descriptors
+    cv::Mat decompress(const cv::Mat& compressed) const;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(dims), CEREAL_NVP(length), CEREAL_NVP(scale),
+           CEREAL_NVP(mean), CEREAL_NVP(components));
+    }
+
+    int dims; // Dimension of compressed descriptors, 0 disables compression
+    int length; // Dimension of input descriptors
+    float scale; // Quantization step is 1 / scale
+    std::vector<float> mean; // length values
+    std::vector<float> components; // dims rows of length values
+};
+
+// FLANN matches of compressed descriptors, sorted by distance
+std::vector<cv::DMatch> match_compressed(const DescriptorCompressor& compressor,
+                                         const cv::Mat& compressed1, const cv::Mat& compressed2);
+
+// Fraction of the first n reference matches (sorted by distance) for which
+// matches pairs the query keypoint with the same train keypoint
+double match_recall(const std::vector<cv::DMatch>& reference, const std::vector<cv::DMatch>& matches, size_t n);
+
+#endif
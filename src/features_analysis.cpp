@@ -4,10 +4,16 @@
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <fstream>
 #include <cmath>
+#include <map>
+#include <chrono>
 #include <opencv2/opencv.hpp>
 #include "opencv2/xfeatures2d.hpp"
+#include "image_cache.h"
+#include "task_graph.h"
+#include "descriptor_compression.h"
 
 using std::string;
 using std::vector;
@@ -146,86 +152,285 @@ void features_analysis(string path, cv::Mat image1, cv::Mat image2, cv::Ptr<cv::
     ofs << image1.rows << " " << image1.cols << std::endl;
 }
 
+// Detectors and descriptor extractors by name
+cv::Ptr<cv::Feature2D> make_feature(const string& name) {
+    if (name == "ORB") return cv::ORB::create();
+    if (name == "BRISK") return cv::BRISK::create();
+    if (name == "KAZE") return cv::KAZE::create();
+    if (name == "AKAZE") return cv::AKAZE::create();
+    if (name == "SIFT") return cv::xfeatures2d::SIFT::create();
+    if (name == "SURF") return cv::xfeatures2d::SURF::create();
+    if (name == "SURF-o6") return cv::xfeatures2d::SURF::create(400, 6);
+    if (name == "FREAK") return cv::xfeatures2d::FREAK::create();
+    throw std::runtime_error("Unknown feature: " + name);
+}
+
+// Detector and descriptor combinations under test
+struct combination {
+    string detector;
+    string descriptor;
+    string name() const { return detector == descriptor ? detector : detector + "-" + descriptor; }
+};
+
+const vector<combination> combinations {
+    {"ORB", "ORB"},
+    // {"MSER", "ORB"}, {"MSER", "SIFT"}, {"MSER", "SURF"},
+    {"BRISK", "BRISK"},
+    {"BRISK", "ORB"},
+    {"BRISK", "SIFT"},
+    {"BRISK", "SURF"},
+    {"KAZE", "KAZE"},
+    {"KAZE", "ORB"},
+    {"AKAZE", "AKAZE"},
+    {"SIFT", "SIFT"},
+    {"SURF", "SURF"},
+    {"SURF-o6", "SURF-o6"},
+    {"BRISK", "FREAK"}
+};
+
+struct image_pair {
+    string name;
+    string path1, path2;
+    double scale;
+};
+
+// Load both images of a pair, returns false on error
+bool load_pair(const image_pair& pair, cv::Mat& image1, cv::Mat& image2) {
+    try {
+        image1 = load_image(pair.path1, pair.scale);
+        image2 = load_image(pair.path2, pair.scale);
+    } catch (std::runtime_error& err) {
+        std::cerr << "Error reading image for " << pair.name << ": " << err.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
 // Run features analysis test for an image pair
-void test_image_pair(string path, string path1, string path2) {
+void test_image_pair(const string& path, const image_pair& pair) {
     std::cout << "Testing image pair " << path << std::endl;
 
-    // Load images
-    cv::Mat image1 = cv::imread(path1);
-    cv::Mat image2 = cv::imread(path2);
-    if (!image1.data || !image2.data) {
-        std::cerr << "Error reading image for " << path << std::endl;
+    cv::Mat image1, image2;
+    if (!load_pair(pair, image1, image2)) {
         return;
     }
 
     mkdirp(path);
 
     // Perform analysis with different configs
-    cv::Ptr<cv::ORB> orb = cv::ORB::create();
-    // cv::Ptr<cv::MSER> mser = cv::MSER::create();
-    cv::Ptr<cv::BRISK> brisk = cv::BRISK::create();
-    cv::Ptr<cv::KAZE> kaze = cv::KAZE::create();
-    cv::Ptr<cv::AKAZE> akaze = cv::AKAZE::create();
-    cv::Ptr<cv::xfeatures2d::SIFT> sift = cv::xfeatures2d::SIFT::create();
-    cv::Ptr<cv::xfeatures2d::SURF> surf = cv::xfeatures2d::SURF::create();
-    cv::Ptr<cv::xfeatures2d::SURF> surf_o6 = cv::xfeatures2d::SURF::create(400, 6);
-    cv::Ptr<cv::xfeatures2d::FREAK> freak = cv::xfeatures2d::FREAK::create();
-
-    features_analysis(path + "/ORB", image1, image2, orb, orb);
-    // features_analysis(path + "/MSER-ORB", image1, image2, mser, orb);
-    // features_analysis(path + "/MSER-SIFT", image1, image2, mser, sift);
-    // features_analysis(path + "/MSER-SURF", image1, image2, mser, surf);
-    features_analysis(path + "/BRISK", image1, image2, brisk, brisk);
-    features_analysis(path + "/BRISK-ORB", image1, image2, brisk, orb);
-    features_analysis(path + "/BRISK-SIFT", image1, image2, brisk, sift);
-    features_analysis(path + "/BRISK-SURF", image1, image2, brisk, surf);
-    features_analysis(path + "/KAZE", image1, image2, kaze, kaze);
-    features_analysis(path + "/KAZE-ORB", image1, image2, kaze, orb);
-    features_analysis(path + "/AKAZE", image1, image2, akaze, akaze);
-    features_analysis(path + "/SIFT", image1, image2, sift, sift);
-    features_analysis(path + "/SURF", image1, image2, surf, surf);
-    features_analysis(path + "/SURF-o6", image1, image2, surf_o6, surf_o6);
-    features_analysis(path + "/BRISK-FREAK", image1, image2, brisk, freak);
+    for (auto& c : combinations) {
+        features_analysis(path + "/" + c.name(), image1, image2, make_feature(c.detector), make_feature(c.descriptor));
+    }
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time detection, description and matching of every combination on an image pair
+// Each detector runs once and its keypoints are shared by the combinations using it.
+// Combinations run in parallel on num_threads, nothing is rendered.
+void benchmark_image_pair(std::ostream& csv, const image_pair& pair, size_t num_threads) {
+    std::cout << "Benchmarking image pair " << pair.name << std::endl;
+
+    cv::Mat image1, image2;
+    if (!load_pair(pair, image1, image2)) {
+        return;
+    }
+
+    struct detection {
+        vector<cv::KeyPoint> keypoint1, keypoint2;
+        double time;
+    };
+    struct result {
+        size_t keypoints1, keypoints2, matches;
+        double describe_time, match_time;
+    };
+    std::map<string, detection> detections;
+    vector<result> results(combinations.size());
+
+    TaskGraph graph;
+    std::map<string, TaskGraph::task_id> detect_tasks;
+    for (auto& c : combinations) {
+        if (detect_tasks.count(c.detector) == 0) {
+            detection& d = detections[c.detector];
+            const string name = c.detector;
+            detect_tasks[name] = graph.add("detect " + name, [&image1, &image2, &d, name]() {
+                cv::Ptr<cv::Feature2D> detector = make_feature(name);
+                auto start = std::chrono::steady_clock::now();
+                detector->detect(image1, d.keypoint1);
+                detector->detect(image2, d.keypoint2);
+                d.time = seconds_since(start);
+            });
+        }
+    }
+
+    for (size_t i = 0; i < combinations.size(); i++) {
+        const combination& c = combinations[i];
+        const detection& d = detections[c.detector];
+        result& r = results[i];
+        graph.add(c.name(), [&image1, &image2, &d, &r, c]() {
+            // Extractors may drop keypoints, work on copies
+            vector<cv::KeyPoint> keypoint1(d.keypoint1);
+            vector<cv::KeyPoint> keypoint2(d.keypoint2);
+            cv::Mat descriptor1, descriptor2;
+            cv::Ptr<cv::Feature2D> descriptor = make_feature(c.descriptor);
+
+            auto start = std::chrono::steady_clock::now();
+            descriptor->compute(image1, keypoint1, descriptor1);
+            descriptor->compute(image2, keypoint2, descriptor2);
+            r.describe_time = seconds_since(start);
+            r.keypoints1 = keypoint1.size();
+            r.keypoints2 = keypoint2.size();
+
+            // Same matching as features_analysis()
+            start = std::chrono::steady_clock::now();
+            vector<cv::DMatch> matches;
+            if (!descriptor1.empty() && !descriptor2.empty()) {
+                descriptor1.convertTo(descriptor1, CV_32F);
+                descriptor2.convertTo(descriptor2, CV_32F);
+                cv::FlannBasedMatcher matcher;
+                matcher.match(descriptor1, descriptor2, matches);
+                matches = reorder(matches, argsort(matches));
+            }
+            r.match_time = seconds_since(start);
+            r.matches = matches.size();
+        }, {detect_tasks[c.detector]});
+    }
+    graph.run(num_threads);
+
+    for (size_t i = 0; i < combinations.size(); i++) {
+        const combination& c = combinations[i];
+        const detection& d = detections[c.detector];
+        const result& r = results[i];
+        const double keypoints = static_cast<double>(d.keypoint1.size() + d.keypoint2.size());
+        csv << pair.name << "," << c.name() << "," << c.detector << "," << c.descriptor << ","
+            << d.keypoint1.size() << "," << d.keypoint2.size() << ","
+            << r.keypoints1 << "," << r.keypoints2 << ","
+            << d.time << "," << r.describe_time << "," << r.match_time << ","
+            << keypoints / (d.time + r.describe_time) << ","
+            << r.matches << std::endl;
+    }
+}
+
+// Match recall and cost of compressed SIFT descriptors against full descriptors
+// The compression is trained on the pair's own descriptors, as it is per project
+void compression_image_pair(std::ostream& csv, const image_pair& pair) {
+    std::cout << "Compression on image pair " << pair.name << std::endl;
+
+    cv::Mat image1, image2;
+    if (!load_pair(pair, image1, image2)) {
+        return;
+    }
+
+    cv::Ptr<cv::Feature2D> sift = make_feature("SIFT");
+    vector<cv::KeyPoint> keypoint1, keypoint2;
+    cv::Mat descriptor1, descriptor2;
+    sift->detectAndCompute(image1, cv::noArray(), keypoint1, descriptor1);
+    sift->detectAndCompute(image2, cv::noArray(), keypoint2, descriptor2);
+    if (descriptor1.rows < 128 || descriptor2.empty()) {
+        std::cerr << "Not enough keypoints in " << pair.name << std::endl;
+        return;
+    }
+    descriptor1.convertTo(descriptor1, CV_32F);
+    descriptor2.convertTo(descriptor2, CV_32F);
+
+    // Uncompressed baseline
+    auto start = std::chrono::steady_clock::now();
+    vector<cv::DMatch> reference;
+    cv::FlannBasedMatcher matcher;
+    matcher.match(descriptor1, descriptor2, reference);
+    reference = reorder(reference, argsort(reference));
+    const double reference_time = seconds_since(start);
+    csv << pair.name << ",full," << descriptor1.cols * sizeof(float) << ",0,"
+        << reference_time << ",1,1" << std::endl;
+
+    for (int dims : {64, 32, 16}) {
+        DescriptorCompressor compressor(dims);
+        cv::Mat samples;
+        cv::vconcat(descriptor1, descriptor2, samples);
+        start = std::chrono::steady_clock::now();
+        compressor.train(samples);
+        cv::Mat compressed1 = compressor.compress(descriptor1);
+        cv::Mat compressed2 = compressor.compress(descriptor2);
+        const double compress_time = seconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        vector<cv::DMatch> matches = match_compressed(compressor, compressed1, compressed2);
+        const double match_time = seconds_since(start);
+
+        csv << pair.name << ",pca" << dims << "_int8," << dims << ","
+            << compress_time << "," << match_time << ","
+            << match_recall(reference, matches, 100) << ","
+            << match_recall(reference, matches, 500) << std::endl;
+    }
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        std::cerr << "Usage: ./features_analysis data_dir results_dir" << std::endl;
+        std::cerr << "Usage: ./features_analysis data_dir results_dir [--benchmark | --compression] [--threads n]" << std::endl;
         return -1;
     }
 
     string data = std::string(argv[1]);
     string results_dir = std::string(argv[2]) + "/features_analysis";
 
-    test_image_pair(results_dir + "/lake",
-            data + "/features-areas/lake1.jpg",
-            data + "/features-areas/lake2.jpg");
-
-    test_image_pair(results_dir + "/desert",
-            data + "/features-areas/desert1.jpg",
-            data + "/features-areas/desert2.jpg");
-
-    test_image_pair(results_dir + "/cars",
-            data + "/features-areas/cars1.jpg",
-            data + "/features-areas/cars2.jpg");
-
-    test_image_pair(results_dir + "/water",
-            data + "/features-areas/water1.jpg",
-            data + "/features-areas/water2.jpg");
-
-    test_image_pair(results_dir + "/industrial",
-            data + "/features-areas/industrial1.jpg",
-            data + "/features-areas/industrial2.jpg");
+    bool benchmark = false;
+    bool compression = false;
+    size_t num_threads = 0;
+    for (int i = 3; i < argc; i++) {
+        string option(argv[i]);
+        if (option == "--benchmark") {
+            benchmark = true;
+        } else if (option == "--compression") {
+            compression = true;
+        } else if (option == "--threads" && i + 1 < argc) {
+            num_threads = std::stoul(argv[++i]);
+        } else {
+            std::cerr << "Invalid option: " << option << std::endl;
+            return -1;
+        }
+    }
 
-    test_image_pair(results_dir + "/entire-image",
-            data + "/alinta-stockpile/DSC_5521.JPG",
-            data + "/alinta-stockpile/DSC_5522.JPG");
+    const vector<image_pair> pairs {
+        {"lake", data + "/features-areas/lake1.jpg", data + "/features-areas/lake2.jpg", 1.0},
+        {"desert", data + "/features-areas/desert1.jpg", data + "/features-areas/desert2.jpg", 1.0},
+        {"cars", data + "/features-areas/cars1.jpg", data + "/features-areas/cars2.jpg", 1.0},
+        {"water", data + "/features-areas/water1.jpg", data + "/features-areas/water2.jpg", 1.0},
+        {"industrial", data + "/features-areas/industrial1.jpg", data + "/features-areas/industrial2.jpg", 1.0},
+        {"entire-image", data + "/alinta-stockpile/DSC_5521.JPG", data + "/alinta-stockpile/DSC_5522.JPG", 1.0},
+        {"entire-image-quarter", data + "/alinta-stockpile/DSC_5521.JPG", data + "/alinta-stockpile/DSC_5522.JPG", 0.25},
+        {"entire-image-eighth", data + "/alinta-stockpile/DSC_5521.JPG", data + "/alinta-stockpile/DSC_5522.JPG", 0.125}
+    };
+
+    if (compression) {
+        // On the features-areas pairs
+        mkdirp(results_dir);
+        std::ofstream csv((results_dir + "/compression.csv").c_str());
+        csv << "pair,descriptor,bytes_per_keypoint,compress_s,match_s,recall_100,recall_500" << std::endl;
+        for (auto& pair : pairs) {
+            if (pair.path1.find("/features-areas/") != string::npos) {
+                compression_image_pair(csv, pair);
+            }
+        }
+        std::cout << "Compression results written to " << results_dir << "/compression.csv" << std::endl;
+        return 0;
+    }
 
-    test_image_pair(results_dir + "/entire-image-quarter",
-            data + "/alinta-stockpile-quarter/DSC_5521.JPG",
-            data + "/alinta-stockpile-quarter/DSC_5522.JPG");
+    if (benchmark) {
+        // Timings are more representative with --threads 1, at the cost of a longer run
+        mkdirp(results_dir);
+        std::ofstream csv((results_dir + "/benchmark.csv").c_str());
+        csv << "pair,combination,detector,descriptor,detected1,detected2,described1,described2,"
+            << "detect_s,describe_s,match_s,keypoints_per_s,matches" << std::endl;
+        for (auto& pair : pairs) {
+            benchmark_image_pair(csv, pair, num_threads);
+        }
+        std::cout << "Benchmark written to " << results_dir << "/benchmark.csv" << std::endl;
+        return 0;
+    }
 
-    test_image_pair(results_dir + "/entire-image-eighth",
-            data + "/alinta-stockpile-eighth/DSC_5521.JPG",
-            data + "/alinta-stockpile-eighth/DSC_5522.JPG");
+    for (auto& pair : pairs) {
+        test_image_pair(results_dir + "/" + pair.name, pair);
+    }
 }
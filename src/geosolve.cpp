@@ -1,11 +1,21 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <array>
 #include <memory>
 #include <string>
 #include <map>
+#include <set>
 #include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <csignal>
 
 #include <cereal/archives/json.hpp>
 #include <cereal/types/vector.hpp>
@@ -15,9 +25,23 @@
 #include "ceres/ceres.h"
 
 #include "project.h"
+#include "project_store.h"
+#include "project_cache.h"
+#include "image_cache.h"
+#include "server.h"
 #include "model0.h"
 #include "model_terrain.h"
+#include "model_multi.h"
+#include "model_dense.h"
 #include "bootstrap.h"
+#include "dem.h"
+#include "point_cloud.h"
+#include "task_graph.h"
+#include "synth.h"
+#include "multires.h"
+#include "overlap.h"
+#include "trace.h"
+#include "cancellation.h"
 
 using std::tuple;
 using std::make_tuple;
@@ -59,21 +83,118 @@ Project base_model0_project() {
 }
 
 // Add a terrain only model using the previous last model as parent
-void add_model_terrain(Project& project) {
+void add_model_terrain(ProjectStore& store) {
     std::shared_ptr<ModelTerrain> model(new ModelTerrain());
     // Set parent to latest model
-    model->parent = project.models.back();
+    model->parent = store.model(store.models_count() - 1);
 
     // High density features
     std::shared_ptr<FeaturesGraph> feat(new FeaturesGraph());
-    feat->data_set = project.data_set;
+    feat->data_set = store.data_set();
     feat->number_of_matches = 500;
     feat->compute_scale = 0.25;
     feat->add_edge(0, 1);
+    store.add(feat);
+
+    model->features = feat;
+    store.add(model);
+}
+
+// Dense terrain model of the first edge of the latest model
+void add_model_dense(ProjectStore& store) {
+    std::shared_ptr<ModelDense> model(new ModelDense());
+    model->parent = store.model(store.models_count() - 1);
+    model->features = model->parent->features;
+    store.add(model);
+}
+
+// Image retrieval index of the project's data set, kept in <project_dir>/overlap_index.bin
+// Images added since it was saved are described and quantized, then it is saved again.
+OverlapIndex project_overlap_index(const string& data_dir, const string& project_dir, const DataSet& data_set) {
+    const string filename = project_dir + "/overlap_index.bin";
+    OverlapIndex index;
+    if (std::ifstream(filename).good()) {
+        load_object(filename, index);
+    }
+    const vector<string> indexed = index.filenames;
+    update_overlap_index(index, data_dir, data_set);
+    if (index.filenames != indexed) {
+        save_object(filename, index);
+    }
+    return index;
+}
+
+// Model of all the images of the data set, over their discovered overlaps
+// Starts from the cameras of the latest model, which must be solved, and its features
+// settings. Its features graph is computed and the model solved by the features and
+// solve commands.
+void add_model_multi(ProjectStore& store, const string& data_dir, const string& project_dir) {
+    if (store.models_count() == 0 || !store.model_solved(store.models_count() - 1)) {
+        throw std::runtime_error("ModelMulti starts from the latest model, which must be solved");
+    }
+    auto latest = store.model(store.models_count() - 1);
+
+    std::shared_ptr<FeaturesGraph> feat(new FeaturesGraph());
+    feat->data_set = store.data_set();
+    feat->number_of_matches = latest->features->number_of_matches;
+    feat->compute_scale = latest->features->compute_scale;
+    if (feat->data_set->filenames.size() > 2) {
+        discover_edges(*feat, project_overlap_index(data_dir, project_dir, *feat->data_set));
+    } else {
+        feat->add_edge(0, 1);
+    }
+    store.add(feat);
+
+    std::shared_ptr<ModelMulti> model(new ModelMulti());
+    model->features = feat;
+    model->internal = latest->final_internal();
+    model->solutions.push_back(ModelMulti::solution {latest->final_external(), {}});
+    store.add(model);
+}
+
+// Project observing a synthetic scene, with a Model0 on the first edge
+// and a terrain model refining it, as base_model0 and model_terrain do for real images
+Project synthetic_project(const SyntheticScene& scene) {
+    if (scene.edges.empty() || scene.edges[0].cam_a != 0 || scene.edges[0].cam_b != 1) {
+        throw std::runtime_error("Synthetic cameras 0 and 1 don't see enough common points.");
+    }
+
+    Project project;
+    project.data_set = std::shared_ptr<DataSet>(new DataSet());
+    for (size_t c = 0; c < scene.cameras.size(); c++) {
+        project.data_set->filenames.push_back("synthetic/" + std::to_string(c) + ".png");
+    }
+    project.data_set->rows = scene.options.rows;
+    project.data_set->cols = scene.options.cols;
+
+    std::shared_ptr<FeaturesGraph> feat(new FeaturesGraph());
+    feat->data_set = project.data_set;
+    feat->computed = true;
+    for (auto& e : scene.edges) {
+        feat->add_edge(e.cam_a, e.cam_b);
+        for (size_t i = 0; i < e.obs_a.size(); i++) {
+            feat->add_match(feat->edges.size() - 1, e.obs_a[i], e.obs_b[i]);
+        }
+        feat->number_of_matches = std::max(feat->number_of_matches, e.obs_a.size());
+    }
     project.features_list.push_back(feat);
 
+    // The first camera is held constant, so start it at its true pose to fix the datum
+    std::shared_ptr<Model0> model(new Model0());
     model->features = feat;
+    model->internal = scene.options.internal;
+    Model0::solution init;
+    init.cameras.push_back(scene.cameras[0]);
+    init.cameras.push_back(scene.cameras[0]);
+    model->solutions.push_back(init);
     project.models.push_back(model);
+
+    std::shared_ptr<ModelTerrain> terrain(new ModelTerrain());
+    terrain->parent = model;
+    terrain->features = feat;
+    project.models.push_back(terrain);
+
+    return project;
 }
 
 // geosolve commands
@@ -95,107 +216,895 @@ void base_model0_scale(const string&, const string& project_dir, double compute_
     project.to_file(project_dir + "/project.json");
 }
 
+// Match PCA compressed descriptors of the given dimension
+void base_model0_compressed(const string&, const string& project_dir, int descriptor_dims) {
+    Project project = base_model0_project();
+    project.features_list[0]->compressor = DescriptorCompressor(descriptor_dims);
+    project.to_file(project_dir + "/project.json");
+}
+
 void load_test(const string&, const string& project_dir) {
-    Project project = Project::from_file(project_dir + "/project.json");
-    project.to_file(project_dir + "/loadtest-output.json");
+    auto store = open_project(project_dir);
+    store->project().to_file(project_dir + "/loadtest-output.json");
+}
+
+// Switch the project between the JSON and binary formats
+void convert(const string&, const string& project_dir) {
+    auto store = open_project(project_dir);
+    if (store->sectioned()) {
+        throw std::runtime_error("Sectioned projects must be joined before conversion");
+    }
+    string from = store->filename();
+    string to = is_binary_project_name(from) ? project_dir + "/project.json" : project_dir + "/project.bin";
+    std::cout << "Converting " << from << " to " << to << std::endl;
+    // to_file writes a temporary renamed over the target, and throws if any step failed
+    store->project().to_file(to);
+    Project check = Project::from_file(to);
+    if (!check.same_content(store->project())) {
+        throw std::runtime_error("Converted " + to + " doesn't match " + from + ", keeping both");
+    }
+    // Only one of the two can exist, the binary one would take precedence
+    if (std::remove(from.c_str()) != 0) {
+        throw std::runtime_error("Converted to " + to + " but can't remove " + from);
+    }
+    ProjectCache::instance().invalidate(project_dir);
+}
+
+// Move a single file project to the sectioned layout
+void split(const string&, const string& project_dir) {
+    auto store = open_project(project_dir);
+    if (store->sectioned()) {
+        std::cout << "Project is already sectioned" << std::endl;
+        return;
+    }
+    std::cout << "Splitting " << store->filename() << " into sections" << std::endl;
+    // Sections are written atomically, split throws if any write failed
+    ProjectStore::split(project_dir, store->project());
+    ProjectStore check(project_dir);
+    if (!check.sectioned() || !check.project().same_content(store->project())) {
+        throw std::runtime_error("Sections in " + project_dir + " don't match " + store->filename() + ", keeping it");
+    }
+    // The sections take precedence, remove the single file to avoid confusion
+    if (std::remove(store->filename().c_str()) != 0) {
+        throw std::runtime_error("Split into sections but can't remove " + store->filename());
+    }
+    ProjectCache::instance().invalidate(project_dir);
+}
+
+// Merge a sectioned project back into project.json
+void join(const string&, const string& project_dir) {
+    std::cout << "Joining sections into project.json" << std::endl;
+    ProjectStore::join(project_dir);
+    ProjectCache::instance().invalidate(project_dir);
+}
+
+// Time loading and saving the project in both formats
+void load_benchmark(const string&, const string& project_dir) {
+    typedef std::chrono::steady_clock clock;
+    const size_t repeat = 5;
+    auto store = open_project(project_dir);
+    Project& project = store->project();
+
+    std::cout << "format\tsave (ms)\tload (ms)" << std::endl;
+    for (const string& name : {string("loadbench.json"), string("loadbench.bin")}) {
+        string filename = project_dir + "/" + name;
+        double save_ms = 0.0;
+        double load_ms = 0.0;
+        for (size_t i = 0; i < repeat; i++) {
+            auto start = clock::now();
+            project.to_file(filename);
+            auto saved = clock::now();
+            Project::from_file(filename);
+            auto loaded = clock::now();
+            save_ms += std::chrono::duration<double, std::milli>(saved - start).count() / repeat;
+            load_ms += std::chrono::duration<double, std::milli>(loaded - saved).count() / repeat;
+        }
+        std::remove(filename.c_str());
+        std::cout << (is_binary_project_name(name) ? "binary" : "json") << "\t" << save_ms << "\t" << load_ms << std::endl;
+    }
+}
+
+// Select how the logged solutions of every model are stored
+void history_encoding(const string&, const string& project_dir, bool delta) {
+    auto store = open_project(project_dir);
+    for (size_t i = 0; i < store->models_count(); i++) {
+        auto model = store->model(i);
+        if (model->history.delta != delta) {
+            model->history.delta = delta;
+            store->touch(model);
+        }
+    }
+    store->commit();
 }
 
 void features(const string& data_dir, const string& project_dir) {
-    string project_filename = project_dir + "/project.json";
-    Project project = Project::from_file(project_filename);
-    for (auto& feat : project.features_list) {
-        if (feat->computed) {
+    auto store = open_project(project_dir);
+    for (size_t i = 0; i < store->features_count(); i++) {
+        if (store->features_computed(i)) {
             std::cout << "Features already computed, skipping" << std::endl;
         } else {
             std::cout << "Computing features" << std::endl;
+            auto feat = store->features(i);
             feat->compute(data_dir);
+            store->touch(feat);
+        }
+    }
+    store->commit();
+}
+
+// Replace the edges of features graphs not computed yet by the overlapping image pairs
+// found by image retrieval. Model0 solves edges[0], the lowest indexed pair.
+void discover_pairs(const string& data_dir, const string& project_dir) {
+    auto store = open_project(project_dir);
+    for (size_t i = 0; i < store->features_count(); i++) {
+        if (store->features_computed(i)) {
+            std::cout << "Features already computed, skipping" << std::endl;
+            continue;
+        }
+        auto feat = store->features(i);
+        discover_edges(*feat, project_overlap_index(data_dir, project_dir, *feat->data_set));
+        std::cout << "Discovered " << feat->edges.size() << " overlapping pairs:";
+        for (auto& edge : feat->edges) {
+            std::cout << " " << edge.cam_a << "-" << edge.cam_b;
         }
+        std::cout << std::endl;
+        store->touch(feat);
     }
-    project.to_file(project_filename);
+    store->commit();
 }
 
-void solve(const string&, const string& project_dir) {
-    string project_filename = project_dir + "/project.json";
-    Project project = Project::from_file(project_filename);
-    for (auto& model : project.models) {
+void solve(const string& data_dir, const string& project_dir) {
+    auto store = open_project(project_dir);
+    for (size_t i = 0; i < store->models_count(); i++) {
+        if (CancellationToken::command().cancelled()) {
+            std::cout << "Cancelled, remaining models not solved" << std::endl;
+            break;
+        }
         // If model hasn't been solved yet
-        if (model->solved) {
+        if (store->model_solved(i)) {
             std::cout << "Model already solved, skipping" << std::endl;
         } else {
             std::cout << "Solving..." << std::endl;
+            auto model = store->model(i);
             // Verify features have been computed
             if (!model->features || model->features->edges.size() == 0 || model->features->computed == false) {
                 throw std::runtime_error("Attempting to solve model but no observations are available");
             }
-            ceres::Solver::Summary summary = model->solve();
+            ceres::Solver::Summary summary = model->solve_with_images(data_dir);
             std::cout << summary.FullReport() << "\n";
+            if (model->solve_record.partial) {
+                std::cout << "Solve stopped early, partial solution saved" << std::endl;
+            }
             model->solved = true;
+            store->touch(model);
+        }
+    }
+    store->commit();
+}
+
+// Compute features and solve Model0s coarse-to-fine, instead of features and solve
+void multires(const string& data_dir, const string& project_dir) {
+    auto store = open_project(project_dir);
+    for (size_t i = 0; i < store->models_count(); i++) {
+        if (store->model_solved(i)) {
+            std::cout << "Model already solved, skipping" << std::endl;
+            continue;
+        }
+        auto model = std::dynamic_pointer_cast<Model0>(store->model(i));
+        if (!model) {
+            continue;
+        }
+        model->set_progress_output(false);
+        vector<MultiResLevel> levels = multires_solve(*model, data_dir);
+        model->solved = true;
+        store->touch(model->features);
+        store->touch(model);
+
+        std::cout << "scale      matches  features (s)  solve (s)  iterations  final cost" << std::endl;
+        for (auto& level : levels) {
+            std::printf("%-10g %7zu  %12.3f  %9.3f  %10zu  %10g\n",
+                level.compute_scale, level.matches, level.features_time,
+                level.record.total_time, level.record.iterations.size(), level.record.final_cost);
         }
     }
-    project.to_file(project_filename);
+    store->commit();
 }
 
 void model_terrain(const string&, const string& project_dir) {
-    string project_filename = project_dir + "/project.json";
-    Project project = Project::from_file(project_filename);
+    auto store = open_project(project_dir);
     std::cout << "Adding Model Terrain to existing project file" << std::endl;
-    add_model_terrain(project);
-    project.to_file(project_filename);
+    add_model_terrain(*store);
+    store->commit();
+}
+
+void model_multi(const string& data_dir, const string& project_dir) {
+    auto store = open_project(project_dir);
+    std::cout << "Adding Model Multi to existing project file" << std::endl;
+    add_model_multi(*store, data_dir, project_dir);
+    store->commit();
+}
+
+// Images to append to a project, read from <project_dir>/append.json
+struct AppendedImages {
+    vector<string> filenames; // Relative to data_dir, as in the data set
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(filenames));
+    }
+};
+
+// Append the images listed in append.json to the data set and register them in
+// every ModelMulti: overlaps of the new images are discovered and matched, and
+// solved models are updated with solve_incremental()
+void append_images(const string& data_dir, const string& project_dir) {
+    auto store = open_project(project_dir);
+    AppendedImages appended;
+    load_object(project_dir + "/append.json", appended);
+    const vector<string>& existing = store->data_set()->filenames;
+    vector<string> filenames;
+    for (auto& name : appended.filenames) {
+        if (std::find(existing.begin(), existing.end(), name) == existing.end() &&
+            std::find(filenames.begin(), filenames.end(), name) == filenames.end()) {
+            filenames.push_back(name);
+        }
+    }
+    if (filenames.empty()) {
+        std::cout << "No new images to append" << std::endl;
+        return;
+    }
+    const size_t first_new = existing.size();
+    store->append_images(filenames);
+    std::cout << "Appended " << filenames.size() << " images" << std::endl;
+
+    // Pairs with a new image, discovered once for all models
+    // Only the new images are described, against the vocabulary saved with the project
+    const OverlapIndex index = project_overlap_index(data_dir, project_dir, *store->data_set());
+    vector<std::pair<size_t, size_t>> new_pairs;
+    for (auto& p : query_overlaps(index)) {
+        if (p.second >= first_new) {
+            new_pairs.push_back(p);
+        }
+    }
+    for (size_t c = first_new; c < store->data_set()->filenames.size(); c++) {
+        bool found = false;
+        for (auto& p : new_pairs) {
+            found = found || p.first == c || p.second == c;
+        }
+        if (!found) {
+            throw std::runtime_error("No overlap found for appended image " + store->data_set()->filenames[c]);
+        }
+    }
+
+    std::set<FeaturesGraph*> extended; // Graphs can be shared by several models
+    for (size_t i = 0; i < store->models_count(); i++) {
+        auto model = std::dynamic_pointer_cast<ModelMulti>(store->model(i));
+        if (!model) {
+            continue;
+        }
+        std::shared_ptr<FeaturesGraph> feat = model->features;
+        if (extended.insert(feat.get()).second) {
+            const size_t first_edge = feat->edges.size();
+            for (auto& p : new_pairs) {
+                feat->add_edge(p.first, p.second);
+            }
+            if (feat->computed) {
+                feat->compute_new_edges(data_dir, first_edge);
+            }
+            store->touch(feat);
+        }
+        if (model->solved) {
+            std::cout << "Registering " << new_pairs.size() << " new edges in model " << i << std::endl;
+            ceres::Solver::Summary summary = model->solve_incremental();
+            std::cout << summary.BriefReport() << std::endl;
+            store->touch(model);
+        }
+    }
+    store->commit();
+}
+
+void model_dense(const string&, const string& project_dir) {
+    auto store = open_project(project_dir);
+    std::cout << "Adding Model Dense to existing project file" << std::endl;
+    add_model_dense(*store);
+    store->commit();
 }
 
 void bootstrap(const string&, const string& project_dir) {
-    string project_filename = project_dir + "/project.json";
-    Project project = Project::from_file(project_filename);
+    auto store = open_project(project_dir);
     std::cout << "Bootstraping models" << std::endl;
-    for (auto& model : project.models) {
-        if (model->bootstrapable()) {
+    for (size_t i = 0; i < store->models_count() && !CancellationToken::command().cancelled(); i++) {
+        if (store->model_bootstrapable(i)) {
+            auto model = store->model(i);
             std::shared_ptr<Bootstrap> boot(new Bootstrap());
             boot->base_model = model;
             boot->size_of_samples = model->features->number_of_matches;
             boot->number_of_samples = 100;
             boot->solve();
-            project.bootstraps.push_back(boot);
+            // Keep the samples solved before a cancellation
+            if (boot->number_of_samples > 0) {
+                store->add(boot);
+            }
         }
     }
-    project.to_file(project_filename);
+    store->commit();
 }
 
-void help(const string&, const string&, const std::map<string, std::function<void (const string&, const string&)>>& commands) {
-    for (auto& it : commands) {
-        std::cout << it.first << std::endl;
+// Compute features, solve models and bootstrap them in one go
+// Independent work runs in parallel: models wait for their features and parent,
+// bootstraps for their model. Objects are loaded up front and the project is
+// committed once at the end, keeping whatever finished if a task failed.
+// Once cancelled, models and bootstraps that haven't started are skipped.
+void run(const string& data_dir, const string& project_dir, size_t num_threads) {
+    auto store = open_project(project_dir);
+    // Tasks run on the graph's threads, under the token of this command
+    CancellationToken& token = CancellationToken::command();
+    TaskGraph graph;
+    std::mutex output;
+    auto report = [&](const string& message) {
+        std::lock_guard<std::mutex> guard(output);
+        std::cout << message << std::endl;
+    };
+
+    // Task computing each features graph, if it needs to run
+    const TaskGraph::task_id none = static_cast<TaskGraph::task_id>(-1);
+    vector<TaskGraph::task_id> features_task(store->features_count(), none);
+    vector<shared_ptr<FeaturesGraph>> computed;
+    for (size_t i = 0; i < store->features_count(); i++) {
+        if (!store->features_computed(i)) {
+            auto feat = store->features(i);
+            computed.push_back(feat);
+            features_task[i] = graph.add("features " + std::to_string(i), [=, &report, &token]() {
+                CommandTokenScope scope(token);
+                report("Computing features " + std::to_string(i));
+                feat->compute(data_dir);
+            });
+        }
+    }
+
+    // Parents always come before their children in the models list
+    vector<TaskGraph::task_id> model_task(store->models_count(), none);
+    vector<shared_ptr<Model>> solved;
+    for (size_t i = 0; i < store->models_count(); i++) {
+        if (store->model_solved(i)) {
+            continue;
+        }
+        auto model = store->model(i);
+        vector<TaskGraph::task_id> deps;
+        for (size_t f = 0; f < features_task.size(); f++) {
+            if (features_task[f] != none && store->features(f) == model->features) {
+                deps.push_back(features_task[f]);
+            }
+        }
+        for (size_t p = 0; p < i; p++) {
+            if (model_task[p] != none && store->model(p) == model->get_parent()) {
+                deps.push_back(model_task[p]);
+            }
+        }
+        solved.push_back(model);
+        model_task[i] = graph.add("model " + std::to_string(i), [=, &report, &token]() {
+            CommandTokenScope scope(token);
+            if (!model->features || model->features->edges.size() == 0 || model->features->computed == false) {
+                throw std::runtime_error("Attempting to solve model but no observations are available");
+            }
+            if (token.cancelled()) {
+                return;
+            }
+            report("Solving model " + std::to_string(i));
+            ceres::Solver::Summary summary = model->solve_with_images(data_dir);
+            report(summary.FullReport());
+            if (model->solve_record.partial) {
+                report("Model " + std::to_string(i) + " stopped early, partial solution saved");
+            }
+            model->solved = true;
+        }, deps);
+    }
+
+    // Bootstrap models that don't have one yet
+    vector<bool> has_bootstrap(store->models_count(), false);
+    for (size_t b = 0; b < store->bootstraps_count(); b++) {
+        long base = store->bootstrap_base_model(b);
+        if (base >= 0) {
+            has_bootstrap[base] = true;
+        }
+    }
+    vector<shared_ptr<Bootstrap>> boots;
+    for (size_t i = 0; i < store->models_count(); i++) {
+        if (has_bootstrap[i] || !store->model_bootstrapable(i)) {
+            continue;
+        }
+        auto model = store->model(i);
+        std::shared_ptr<Bootstrap> boot(new Bootstrap());
+        boot->base_model = model;
+        boots.push_back(boot);
+        vector<TaskGraph::task_id> deps;
+        if (model_task[i] != none) {
+            deps.push_back(model_task[i]);
+        }
+        graph.add("bootstrap " + std::to_string(i), [=, &report, &token]() {
+            CommandTokenScope scope(token);
+            if (!model->solved || token.cancelled()) {
+                boot->number_of_samples = 0;
+                return;
+            }
+            report("Bootstraping model " + std::to_string(i));
+            boot->size_of_samples = model->features->number_of_matches;
+            boot->number_of_samples = 100;
+            boot->solve();
+        }, deps);
+    }
+
+    std::exception_ptr error;
+    try {
+        graph.run(num_threads);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // Tasks were added features first, then models, then bootstraps
+    size_t id = 0;
+    for (auto& feat : computed) {
+        if (graph.status(id++) == TaskGraph::done) store->touch(feat);
+    }
+    for (auto& model : solved) {
+        if (graph.status(id++) == TaskGraph::done && model->solved) store->touch(model);
+    }
+    for (auto& boot : boots) {
+        if (graph.status(id++) == TaskGraph::done && boot->number_of_samples > 0) store->add(boot);
+    }
+    store->commit();
+
+    for (id = 0; id < graph.size(); id++) {
+        if (graph.status(id) != TaskGraph::done) {
+            std::cout << graph.name(id) << (graph.status(id) == TaskGraph::failed ? " failed" : " skipped") << std::endl;
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
     }
 }
 
-int main(int argc, char* argv[]) {
-    google::InitGoogleLogging(argv[0]);
+// Generate a synthetic project from the options in project_dir/synth.json
+// The file is created with default options if it doesn't exist
+// Ground truth is written to project_dir/ground_truth.json
+void synth(const string&, const string& project_dir) {
+    SynthOptions options;
+    const string options_file = project_dir + "/synth.json";
+    if (std::ifstream(options_file).good()) {
+        load_object(options_file, options);
+    } else {
+        save_object(options_file, options);
+    }
 
-    if (argc < 4) {
-        std::cerr << "Usage: ./geosolve <data_dir> <project_dir> command" << std::endl;
-        return -1;
+    SyntheticScene scene = synthesize(options);
+    size_t observations = 0;
+    for (auto& e : scene.edges) {
+        observations += e.points.size();
     }
+    std::cout << "Synthesized " << scene.cameras.size() << " cameras, "
+              << scene.terrain.size() << " points, "
+              << scene.edges.size() << " edges, "
+              << observations << " observation pairs" << std::endl;
 
-    string data_dir(argv[1]);
-    string project_dir(argv[2]);
-    string command(argv[3]);
+    Project project = synthetic_project(scene);
+    project.to_file(project_dir + "/project.json");
+    save_object(project_dir + "/ground_truth.json", scene);
+}
+
+// RMS distance between camera positions
+double camera_position_rms(const vector<array<double, 6>>& cameras, const vector<array<double, 6>>& truth) {
+    double sq = 0.0;
+    const size_t count = std::min(cameras.size(), truth.size());
+    for (size_t c = 0; c < count; c++) {
+        for (size_t k = 0; k < 3; k++) {
+            sq += std::pow(cameras[c][k] - truth[c][k], 2);
+        }
+    }
+    return std::sqrt(sq / count);
+}
+
+// Solve the first half of a synthetic survey with a ModelMulti, then append
+// the other cameras one at a time with incremental solves, and finish with
+// a global pass. Initial guesses are the true poses with GPS-like noise.
+void synth_incremental(const string&, const string& project_dir) {
+    SynthOptions options;
+    const string options_file = project_dir + "/synth.json";
+    if (std::ifstream(options_file).good()) {
+        load_object(options_file, options);
+    }
+    SyntheticScene scene = synthesize(options);
+    const size_t count = scene.cameras.size();
+    const size_t initial = std::max<size_t>(2, count / 2);
+
+    std::mt19937 rng(options.seed);
+    std::normal_distribution<double> position_noise(0.0, 2.0);
+    std::normal_distribution<double> angle_noise(0.0, 0.01);
+    vector<array<double, 6>> guesses;
+    for (size_t c = 0; c < count; c++) {
+        array<double, 6> guess = scene.cameras[c];
+        for (size_t k = 0; k < 6 && c > 0; k++) {
+            guess[k] += k < 3 ? position_noise(rng) : angle_noise(rng);
+        }
+        guesses.push_back(guess);
+    }
+
+    std::shared_ptr<DataSet> data_set(new DataSet());
+    data_set->rows = options.rows;
+    data_set->cols = options.cols;
+    std::shared_ptr<FeaturesGraph> feat(new FeaturesGraph());
+    feat->data_set = data_set;
+    feat->computed = true;
+    auto append_camera = [&](size_t c) {
+        data_set->filenames.push_back("synthetic/" + std::to_string(c) + ".png");
+        for (auto& e : scene.edges) {
+            if (std::max(e.cam_a, e.cam_b) == c) {
+                feat->add_edge(e.cam_a, e.cam_b);
+                for (size_t i = 0; i < e.obs_a.size(); i++) {
+                    feat->add_match(feat->edges.size() - 1, e.obs_a[i], e.obs_b[i]);
+                }
+            }
+        }
+    };
+
+    ModelMulti model;
+    model.features = feat;
+    model.internal = options.internal;
+    model.solutions.push_back(ModelMulti::solution {guesses, {}});
+    model.set_progress_output(false);
+
+    auto timed = [&model](bool incremental) {
+        auto start = std::chrono::steady_clock::now();
+        if (incremental) {
+            model.solve_incremental();
+        } else {
+            model.solve();
+        }
+        model.solved = true;
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    for (size_t c = 0; c < initial; c++) {
+        append_camera(c);
+    }
+    std::cout << "step	cameras	edges	residuals	seconds	camera rms" << std::endl;
+    double seconds = timed(false);
+    std::cout << "global	" << initial << "	" << feat->edges.size() << "	" << model.solve_record.num_residuals
+              << "	" << seconds << "	" << camera_position_rms(model.final_external(), scene.cameras) << std::endl;
+
+    for (size_t c = initial; c < count; c++) {
+        append_camera(c);
+        seconds = timed(true);
+        std::cout << "append	" << c + 1 << "	" << feat->edges.size() << "	" << model.solve_record.num_residuals
+                  << "	" << seconds << "	" << camera_position_rms(model.final_external(), scene.cameras) << std::endl;
+    }
+
+    seconds = timed(false);
+    std::cout << "global	" << count << "	" << feat->edges.size() << "	" << model.solve_record.num_residuals
+              << "	" << seconds << "	" << camera_position_rms(model.final_external(), scene.cameras) << std::endl;
+}
+
+// Compare the solved models of a synthetic project to its ground truth
+void synth_error(const string&, const string& project_dir) {
+    SyntheticScene truth;
+    load_object(project_dir + "/ground_truth.json", truth);
+    const SyntheticScene::edge& edge = truth.edges.at(0);
+
+    auto store = open_project(project_dir);
+    std::cout << "model\tcamera rms\tterrain xy rms\tterrain z rms" << std::endl;
+    for (size_t n = 0; n < store->models_count(); n++) {
+        if (!store->model_solved(n)) {
+            continue;
+        }
+        auto model = store->model(n);
+        vector<array<double, 6>> cameras = model->final_external();
+        vector<array<double, 3>> terrain = model->final_terrain();
+        if (terrain.size() != edge.points.size()) {
+            std::cout << n << "\tterrain doesn't match the first edge, skipping" << std::endl;
+            continue;
+        }
+
+        double camera_sq = 0.0;
+        const size_t camera_count = std::min(cameras.size(), truth.cameras.size());
+        for (size_t c = 0; c < camera_count; c++) {
+            for (size_t k = 0; k < 3; k++) {
+                camera_sq += std::pow(cameras[c][k] - truth.cameras[c][k], 2);
+            }
+        }
+
+        // Outliers have no true position
+        double xy_sq = 0.0, z_sq = 0.0;
+        size_t inliers = 0;
+        for (size_t i = 0; i < terrain.size(); i++) {
+            if (edge.outlier[i]) {
+                continue;
+            }
+            const array<double, 3>& p = truth.terrain[edge.points[i]];
+            xy_sq += std::pow(terrain[i][0] - p[0], 2) + std::pow(terrain[i][1] - p[1], 2);
+            z_sq += std::pow(terrain[i][2] - p[2], 2);
+            inliers++;
+        }
+
+        // "-" when there is nothing to compare, a model without cameras or all points outliers
+        auto rms = [](double sq, size_t count) {
+            std::ostringstream os;
+            if (count > 0) {
+                os << std::sqrt(sq / count);
+            } else {
+                os << "-";
+            }
+            return os.str();
+        };
+        std::cout << n << "\t" << rms(camera_sq, camera_count)
+                  << "\t" << rms(xy_sq, inliers)
+                  << "\t" << rms(z_sq, inliers) << std::endl;
+    }
+}
 
-    std::map<string, std::function<void (const string&, const string&)>> commands {
+// Print one row of the perf_report table
+void print_totals(const string& name, const SolveTotals& t) {
+    auto percent = [&](double time) {
+        return t.total_time > 0 ? string(std::to_string(static_cast<int>(std::round(100 * time / t.total_time))) + "%") : string("-");
+    };
+    string terminations;
+    for (auto& it : t.terminations) {
+        terminations += (terminations.empty() ? "" : ", ") + it.first + " " + std::to_string(it.second);
+    }
+    std::cout << name
+              << "\t" << t.solves
+              << "\t" << t.iterations
+              << "\t" << t.total_time
+              << "\t" << percent(t.residual_evaluation_time)
+              << "\t" << percent(t.jacobian_evaluation_time)
+              << "\t" << percent(t.linear_solver_time)
+              << "\t" << percent(t.preprocessor_time)
+              << "\t" << terminations << std::endl;
+}
+
+// Where solver time went, from the solve records stored with models and bootstraps
+void perf_report(const string&, const string& project_dir) {
+    auto store = open_project(project_dir);
+    SolveTotals all;
+
+    std::cout << "solves\tcount\titerations\ttime (s)\tresiduals\tjacobians\tlinear solver\tpreprocessor\ttermination" << std::endl;
+    for (size_t n = 0; n < store->models_count(); n++) {
+        if (!store->model_solved(n)) {
+            continue;
+        }
+        SolveTotals t;
+        t.add(store->model(n)->solve_record);
+        print_totals("model " + std::to_string(n), t);
+        all.add(t);
+    }
+    for (size_t b = 0; b < store->bootstraps_count(); b++) {
+        SolveTotals t;
+        for (const SolveRecord& r : store->bootstrap(b)->solve_records) {
+            t.add(r);
+        }
+        print_totals("bootstrap " + std::to_string(b) + " (model " + std::to_string(store->bootstrap_base_model(b)) + ")", t);
+        all.add(t);
+    }
+    print_totals("total", all);
+}
+
+void dem(const string&, const string& project_dir) {
+    auto store = open_project(project_dir);
+    for (size_t n = 0; n < store->models_count(); n++) {
+        if (!store->model_solved(n)) {
+            std::cout << "Model " << n << " not solved, skipping" << std::endl;
+            continue;
+        }
+        auto model = store->model(n);
+        vector<array<double, 3>> terrain = model->final_terrain();
+
+        // Sample at about the density of the terrain points
+        double gsd = TerrainIndex(terrain).cell_size();
+        DEM model_dem = DEM::from_terrain(terrain, gsd);
+
+        string filename = project_dir + "/dem" + std::to_string(n) + ".asc";
+        std::cout << "Writing " << model_dem.rows << "x" << model_dem.cols << " DEM to " << filename << std::endl;
+        model_dem.write_ascii_grid(filename);
+    }
+}
+
+// Export the solved terrain of each model to PLY, colored from the first image
+// With build_octree, also build a level of detail octree next to it
+void export_cloud(const string& data_dir, const string& project_dir, bool build_octree) {
+    auto store = open_project(project_dir);
+    cv::Mat image = load_image(data_dir + "/" + store->data_set()->filenames[0]);
+
+    for (size_t n = 0; n < store->models_count(); n++) {
+        if (!store->model_solved(n)) {
+            std::cout << "Model " << n << " not solved, skipping" << std::endl;
+            continue;
+        }
+        auto model = store->model(n);
+        string basename = project_dir + "/cloud" + std::to_string(n);
+        CloudExportStats stats = export_terrain_cloud(model->final_terrain(),
+                model->final_internal(),
+                model->final_external()[0],
+                image,
+                basename + ".ply",
+                build_octree ? basename + "-octree" : string());
+        std::cout << "Wrote " << stats.written << " points to " << basename << ".ply";
+        if (build_octree) {
+            std::cout << " and " << basename << "-octree";
+        }
+        std::cout << std::endl;
+        if (stats.dropped > 0) {
+            std::cout << stats.dropped << " points outside of " << store->data_set()->filenames[0]
+                      << " were not exported" << std::endl;
+        }
+    }
+}
+
+typedef std::map<string, std::function<void (const string&, const string&)>> command_map;
+
+void help(const string&, const string&, const command_map& commands) {
+    for (auto& it : commands) {
+        std::cout << it.first << std::endl;
+    }
+}
+
+command_map make_commands() {
+    command_map commands {
         {"base_model0", base_model0},
         {"base_model0_200", base_model0_200},
         {"base_model0_half", std::bind(base_model0_scale, _1, _2, 0.5)},
         {"base_model0_quarter", std::bind(base_model0_scale, _1, _2, 0.25)},
+        {"base_model0_pca32", std::bind(base_model0_compressed, _1, _2, 32)},
+        {"synth", synth},
+        {"synth_error", synth_error},
+        {"synth_incremental", synth_incremental},
         {"model_terrain", model_terrain},
+        {"model_dense", model_dense},
+        {"model_multi", model_multi},
+        {"append_images", append_images},
         {"loadtest", load_test},
+        {"loadbench", load_benchmark},
+        {"convert", convert},
+        {"split", split},
+        {"join", join},
+        {"compress_history", std::bind(history_encoding, _1, _2, true)},
+        {"expand_history", std::bind(history_encoding, _1, _2, false)},
+        {"discover_edges", discover_pairs},
         {"features", features},
         {"solve", solve},
-        {"bootstrap", bootstrap}
+        {"multires", multires},
+        {"bootstrap", bootstrap},
+        {"run", std::bind(run, _1, _2, 0)},
+        {"run_serial", std::bind(run, _1, _2, 1)},
+        {"perf_report", perf_report},
+        {"dem", dem},
+        {"export_cloud", std::bind(export_cloud, _1, _2, false)},
+        {"export_octree", std::bind(export_cloud, _1, _2, true)}
     };
 
     commands[string("help")] = std::bind(help, _1, _2, commands);
+    return commands;
+}
 
+// First SIGINT or SIGTERM cancels the command so that it saves what it has,
+// a second one terminates
+static void cancel_command(int sig) {
+    CancellationToken::process().cancel();
+    std::signal(sig, SIG_DFL);
+}
+
+int main(int argc, char* argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    const command_map commands = make_commands();
+
+    // Resident server mode: ./geosolve serve <socket> [image cache size in MB] [workers]
+    if (argc >= 3 && string(argv[1]) == "serve") {
+        size_t cache_mb = argc >= 4 ? std::stoul(argv[3]) : 2048;
+        size_t workers = argc >= 5 ? std::stoul(argv[4]) : 4;
+        ImageCache::instance().enable(cache_mb * 1024 * 1024);
+        ProjectCache::instance().enable();
+        serve(argv[2], [&commands](const string& data_dir, const string& project_dir, const string& command) {
+            auto it = commands.find(command);
+            if (it == commands.end()) {
+                throw std::runtime_error("Invalid command: " + command);
+            }
+            // Requests run concurrently, each under its own token
+            CancellationToken token;
+            CommandTokenScope scope(token);
+            it->second(data_dir, project_dir);
+        }, workers);
+        return 0;
+    }
+
+    if (argc < 4) {
+        std::cerr << "Usage: ./geosolve <data_dir> <project_dir> command [--trace trace.json] [--mem-report]" << std::endl;
+        std::cerr << "       [--time-budget seconds] [--model-budget seconds] [--model0-solver ceres|two_view]" << std::endl;
+        std::cerr << "       ./geosolve serve <socket_path> [image_cache_mb] [workers]" << std::endl;
+        return -1;
+    }
+
+    string data_dir(argv[1]);
+    string project_dir(argv[2]);
+    string command(argv[3]);
+
+    // Options following the command
+    string trace_file;
+    bool mem_report = false;
+    double time_budget = 0;
+    const bool has_options = argc > 4;
+    for (int i = 4; i < argc; i++) {
+        string option(argv[i]);
+        if (option == "--trace" && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (option == "--mem-report") {
+            mem_report = true;
+        } else if (option == "--time-budget" && i + 1 < argc) {
+            time_budget = std::stod(argv[++i]);
+        } else if (option == "--model-budget" && i + 1 < argc) {
+            Model::default_time_budget() = std::stod(argv[++i]);
+        } else if (option == "--model0-solver" && i + 1 < argc) {
+            string solver(argv[++i]);
+            if (solver == "ceres") {
+                Model0::default_backend() = Model0::ceres_solver;
+            } else if (solver == "two_view") {
+                Model0::default_backend() = Model0::two_view_solver;
+            } else {
+                std::cerr << "Invalid Model0 solver: " << solver << std::endl;
+                return -1;
+            }
+        } else {
+            std::cerr << "Invalid option: " << option << std::endl;
+            return -1;
+        }
+    }
+    // Checked now rather than when a bootstrap is reached
     try {
-        commands.at(command)(data_dir, project_dir);
-    } catch (std::out_of_range& err) {
+        unsigned long seed;
+        environment_seed(seed);
+    } catch (std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        return -1;
+    }
+    if (!trace_file.empty()) {
+        Tracer::instance().enable();
+    }
+    if (mem_report) {
+        MemoryAccount::instance().enable();
+    }
+
+    // Forward to a resident server if there is one
+    // Options apply to this process, the server would run the command without them
+    const char* server = std::getenv("GEOSOLVE_SERVER");
+    if (server != NULL && command != "help") {
+        if (has_options) {
+            std::cerr << "Options can't be used with GEOSOLVE_SERVER, unset it to run the command locally" << std::endl;
+            return -1;
+        }
+        string error;
+        if (!send_command(server, data_dir, project_dir, command, error)) {
+            std::cerr << error << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    // The budget covers the command only, not the setup above
+    CancellationToken::process().set_budget(time_budget);
+    std::signal(SIGINT, cancel_command);
+    std::signal(SIGTERM, cancel_command);
+    auto it = commands.find(command);
+    if (it == commands.end()) {
         std::cerr << "Invalid command: " << command << std::endl;
         return -1;
     }
+    it->second(data_dir, project_dir);
+
+    if (!trace_file.empty()) {
+        Tracer::instance().disable();
+        Tracer::instance().write_chrome_trace(trace_file);
+        std::cout << "\nTrace written to " << trace_file << std::endl;
+        Tracer::instance().write_summary(std::cout);
+    }
+    if (mem_report) {
+        MemoryAccount::instance().disable();
+        std::cout << "\nMemory per stage:" << std::endl;
+        MemoryAccount::instance().write_report(std::cout);
+    }
 }
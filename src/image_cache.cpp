@@ -0,0 +1,291 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include <errno.h>
+#include "image_cache.h"
+#include "trace.h"
+
+using std::string;
+
+static const char raw_magic[8] = {'G', 'S', 'I', 'M', 'G', '0', '1', '\0'};
+
+ImageCache& ImageCache::instance() {
+    static ImageCache cache;
+    return cache;
+}
+
+const uint64_t ImageCache::default_disk_bytes;
+
+ImageCache::ImageCache() : disk_max_bytes(default_disk_bytes), enabled(false), max_bytes(0), bytes(0) {
+    const char* dir = std::getenv("GEOSOLVE_IMAGE_CACHE");
+    if (dir != NULL) {
+        const char* mb = std::getenv("GEOSOLVE_IMAGE_CACHE_MB");
+        enable_disk(dir, mb != NULL ? std::strtoull(mb, NULL, 10) << 20 : default_disk_bytes);
+    }
+}
+
+// mkdir -p
+static void make_directories(const string& dir) {
+    for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1)) {
+        string sub = dir.substr(0, pos);
+        if (::mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Cannot create image cache directory " + sub);
+        }
+        if (pos == string::npos) {
+            break;
+        }
+    }
+}
+
+void ImageCache::enable_disk(const string& dir, uint64_t max_bytes) {
+    if (!dir.empty()) {
+        make_directories(dir);
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    disk_dir = dir;
+    disk_max_bytes = max_bytes;
+}
+
+string ImageCache::file_key(const string& path) {
+    struct stat st;
+    std::ifstream file(path, std::ios::binary);
+    if (!file || ::stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Cannot load image " + path);
+    }
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+    const uint64_t mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    const uint64_t inode = static_cast<uint64_t>(st.st_ino);
+    const uint64_t sample = 64 * 1024;
+
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash](const unsigned char* data, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ data[i]) * 1099511628211ULL;
+        }
+    };
+    add(reinterpret_cast<const unsigned char*>(&size), sizeof(size));
+    add(reinterpret_cast<const unsigned char*>(&mtime), sizeof(mtime));
+    add(reinterpret_cast<const unsigned char*>(&inode), sizeof(inode));
+
+    std::vector<char> buffer(static_cast<size_t>(std::min(size, sample)));
+    file.seekg(0);
+    file.read(buffer.data(), buffer.size());
+    add(reinterpret_cast<const unsigned char*>(buffer.data()), buffer.size());
+    if (size > sample) {
+        file.seekg(static_cast<std::streamoff>(size - sample));
+        file.read(buffer.data(), buffer.size());
+        add(reinterpret_cast<const unsigned char*>(buffer.data()), buffer.size());
+    }
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+static string level_path(const string& dir, const string& key, double scale) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s_%g.raw", key.c_str(), scale);
+    return dir + "/" + name;
+}
+
+// Returns an empty Mat if the file doesn't exist or isn't a valid level
+// A level is used, which keeps it from eviction, when it is read
+static cv::Mat read_raw(const string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    const uint64_t file_size = file ? static_cast<uint64_t>(file.tellg()) : 0;
+    const uint64_t header_size = sizeof(raw_magic) + 3 * sizeof(int32_t);
+    char magic[8];
+    int32_t header[3];
+    file.seekg(0);
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, raw_magic, sizeof(magic)) != 0
+            || !file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        return cv::Mat();
+    }
+
+    // The header must describe exactly the pixels that follow it
+    const int32_t rows = header[0], cols = header[1], type = header[2];
+    if (rows <= 0 || cols <= 0 || type < 0 || CV_MAT_DEPTH(type) > CV_64F || type != CV_MAKETYPE(CV_MAT_DEPTH(type), CV_MAT_CN(type))) {
+        return cv::Mat();
+    }
+    const uint64_t elem_size = CV_ELEM_SIZE(type);
+    const uint64_t pixels = (file_size - header_size) / elem_size;
+    if ((file_size - header_size) % elem_size != 0 || pixels % static_cast<uint64_t>(cols) != 0
+            || pixels / static_cast<uint64_t>(cols) != static_cast<uint64_t>(rows)) {
+        return cv::Mat();
+    }
+
+    cv::Mat im(rows, cols, type);
+    if (!file.read(reinterpret_cast<char*>(im.data), im.total() * im.elemSize())) {
+        return cv::Mat();
+    }
+    ::utime(filename.c_str(), NULL);
+    return im;
+}
+
+// Written to a temporary file then renamed, so concurrent readers never see a partial level
+static void write_raw(const string& filename, const cv::Mat& image) {
+    cv::Mat im = image.isContinuous() ? image : image.clone();
+    const string tmp = filename + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp, std::ios::binary);
+        int32_t header[3] = {im.rows, im.cols, im.type()};
+        file.write(raw_magic, sizeof(raw_magic));
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(im.data), im.total() * im.elemSize());
+        if (!file) {
+            std::remove(tmp.c_str());
+            return; // The cache is best effort
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+    }
+}
+
+// Remove least recently used levels until the directory holds at most max_bytes
+static void trim_disk(const string& dir, uint64_t max_bytes) {
+    struct level {
+        string filename;
+        uint64_t size;
+        time_t used;
+    };
+    std::vector<level> levels;
+    uint64_t total = 0;
+    DIR* d = ::opendir(dir.c_str());
+    if (d == NULL) {
+        return;
+    }
+    const string ext(".raw");
+    while (struct dirent* entry = ::readdir(d)) {
+        const string name(entry->d_name);
+        struct stat st;
+        if (name.size() < ext.size() || name.compare(name.size() - ext.size(), ext.size(), ext) != 0
+                || ::stat((dir + "/" + name).c_str(), &st) != 0) {
+            continue;
+        }
+        levels.push_back(level {dir + "/" + name, static_cast<uint64_t>(st.st_size), st.st_mtime});
+        total += levels.back().size;
+    }
+    ::closedir(d);
+
+    std::sort(levels.begin(), levels.end(), [](const level& a, const level& b) { return a.used < b.used; });
+    for (size_t i = 0; i < levels.size() && total > max_bytes; i++) {
+        if (std::remove(levels[i].filename.c_str()) == 0) {
+            total -= levels[i].size;
+        }
+    }
+}
+
+void ImageCache::enable(size_t max_bytes) {
+    std::lock_guard<std::mutex> guard(mutex);
+    enabled = true;
+    this->max_bytes = max_bytes;
+}
+
+static cv::Mat decode(const string& path) {
+    TRACE_SCOPE("imread");
+    cv::Mat im = cv::imread(path);
+    if (im.data == NULL) {
+        throw std::runtime_error("Cannot load image " + path);
+    }
+    return im;
+}
+
+static cv::Mat rescale(const cv::Mat& im, double scale) {
+    if (scale == 1.0) {
+        return im;
+    }
+    TRACE_SCOPE("resize");
+    cv::Mat resized;
+    cv::resize(im, resized, cv::Size(), scale, scale, cv::INTER_AREA);
+    return resized;
+}
+
+cv::Mat ImageCache::read(const string& path, double scale) {
+    string dir;
+    uint64_t dir_max_bytes;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        dir = disk_dir;
+        dir_max_bytes = disk_max_bytes;
+    }
+    if (dir.empty()) {
+        return rescale(decode(path), scale);
+    }
+
+    const string key = file_key(path);
+    cv::Mat im;
+    {
+        TRACE_SCOPE("image_cache_read");
+        im = read_raw(level_path(dir, key, scale));
+    }
+    if (!im.empty()) {
+        return im;
+    }
+
+    // Levels are always resized from the full resolution image, as without the cache
+    // The full resolution level is stored on the first miss whatever the scale, so
+    // the image is decoded once and every other scale is built from that level.
+    cv::Mat full;
+    if (scale != 1.0) {
+        TRACE_SCOPE("image_cache_read");
+        full = read_raw(level_path(dir, key, 1.0));
+    }
+    if (full.empty()) {
+        full = decode(path);
+        TRACE_SCOPE("image_cache_write");
+        write_raw(level_path(dir, key, 1.0), full);
+        trim_disk(dir, dir_max_bytes);
+    }
+    if (scale == 1.0) {
+        return full;
+    }
+    im = rescale(full, scale);
+    {
+        TRACE_SCOPE("image_cache_write");
+        write_raw(level_path(dir, key, scale), im);
+        trim_disk(dir, dir_max_bytes);
+    }
+    return im;
+}
+
+cv::Mat ImageCache::load(const string& path, double scale) {
+    const entry_key key(path, scale);
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (enabled) {
+            auto it = images.find(key);
+            if (it != images.end()) {
+                recent.splice(recent.begin(), recent, it->second.second);
+                return it->second.first;
+            }
+        }
+    }
+
+    // Decode without holding the lock, concurrent misses may decode twice
+    cv::Mat im = read(path, scale);
+    const size_t size = im.total() * im.elemSize();
+
+    std::lock_guard<std::mutex> guard(mutex);
+    if (enabled && images.count(key) == 0 && size <= max_bytes) {
+        while (bytes + size > max_bytes && !recent.empty()) {
+            auto oldest = images.find(recent.back());
+            bytes -= oldest->second.first.total() * oldest->second.first.elemSize();
+            images.erase(oldest);
+            recent.pop_back();
+        }
+        recent.push_front(key);
+        images[key] = std::make_pair(im, recent.begin());
+        bytes += size;
+    }
+    return im;
+}
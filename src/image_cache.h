@@ -0,0 +1,73 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include <map>
+#include <list>
+#include <mutex>
+#include <utility>
+#include <opencv2/opencv.hpp>
+
+// Decoded images kept in memory between requests of the geosolve server
+// Least recently used images are evicted above the memory budget
+//
+// Decoded and resized images can also persist on disk, in the directory named by
+// the GEOSOLVE_IMAGE_CACHE environment variable or set with enable_disk(). The full
+// resolution image and each requested scale are stored once as raw pixels, keyed by
+// the image file (see file_key()), so an image is decoded at most once across runs
+// and tools, and python reads the full resolution level of any cached image.
+// Levels are removed least recently used first when the directory grows past its
+// size limit, GEOSOLVE_IMAGE_CACHE_MB megabytes if set.
+// python/image_cache.py reads the same files. The raw format is:
+//     char magic[8] = "GSIMG01\0"
+//     int32 rows, cols, type (OpenCV type, 8 bit BGR for photos)
+//     rows * cols * elemSize bytes of pixels, row major
+class ImageCache {
+public:
+    static ImageCache& instance();
+
+    // Caching is off by default, every load decodes the image
+    void enable(size_t max_bytes);
+
+    // Persist decoded images in dir, created if needed, within max_bytes of levels
+    // An empty dir disables it.
+    void enable_disk(const std::string& dir, uint64_t max_bytes = default_disk_bytes);
+    static const uint64_t default_disk_bytes = uint64_t(8) << 30;
+
+    // Image at path, resized by scale with area interpolation
+    // Throws if the image can't be loaded
+    cv::Mat load(const std::string& path, double scale);
+
+    // Key of an image file on disk: hex FNV-1a 64 of its size, modification time,
+    // inode, first and last 64 KB
+    // Hashing whole 24 MP files would cost as much as decoding them, the file's
+    // identity and time tell apart files that only differ in the middle. This is
+    // not a content hash: a copied or checked out again data set gets new keys,
+    // and its images are decoded again.
+    static std::string file_key(const std::string& path);
+
+private:
+    ImageCache();
+    typedef std::pair<std::string, double> entry_key;
+
+    // Load from the disk cache, or decode and store it there
+    cv::Mat read(const std::string& path, double scale);
+
+    std::string disk_dir;
+    uint64_t disk_max_bytes;
+
+    std::mutex mutex;
+    bool enabled;
+    size_t max_bytes;
+    size_t bytes;
+    std::list<entry_key> recent; // Most recently used first
+    std::map<entry_key, std::pair<cv::Mat, std::list<entry_key>::iterator>> images;
+};
+
+// Convenience for ImageCache::instance().load()
+inline cv::Mat load_image(const std::string& path, double scale = 1.0) {
+    return ImageCache::instance().load(path, scale);
+}
+
+#endif
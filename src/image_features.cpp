@@ -1,6 +1,12 @@
 #include <tuple>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <algorithm>
 #include <stdexcept>
 #include "image_features.h"
+#include "image_cache.h"
+#include "trace.h"
 
 using std::vector;
 using std::array;
@@ -10,11 +16,105 @@ using std::tuple;
 FeaturesGraph::FeaturesGraph() :
     number_of_matches(0),
     compute_scale(1.0),
-    computed(false) {
+    computed(false),
+    keypoints(std::make_shared<std::vector<KeypointTable>>()) {
+}
+
+// Exact position of a keypoint, as a lookup key
+static uint64_t position_key(float x, float y) {
+    uint32_t bits_x, bits_y;
+    std::memcpy(&bits_x, &x, sizeof(bits_x));
+    std::memcpy(&bits_y, &y, sizeof(bits_y));
+    return (static_cast<uint64_t>(bits_x) << 32) | bits_y;
+}
+
+uint32_t KeypointTable::add(const pixel_t& p) {
+    const float px = static_cast<float>(p.j - static_cast<double>(cols/2));
+    const float py = static_cast<float>(static_cast<double>(rows/2) - p.i);
+    if (lookup.size() != x.size()) {
+        lookup.clear();
+        for (size_t k = 0; k < x.size(); k++) {
+            lookup.emplace(position_key(x[k], y[k]), static_cast<uint32_t>(k));
+        }
+    }
+    auto inserted = lookup.emplace(position_key(px, py), static_cast<uint32_t>(x.size()));
+    if (inserted.second) {
+        x.push_back(px);
+        y.push_back(py);
+    }
+    return inserted.first->second;
+}
+
+void KeypointTable::release_lookup() {
+    std::unordered_map<uint64_t, uint32_t>().swap(lookup);
+    x.shrink_to_fit();
+    y.shrink_to_fit();
+}
+
+void KeypointTable::clear() {
+    x.clear();
+    y.clear();
+    lookup.clear();
 }
 
 void FeaturesGraph::add_edge(size_t cam_a, size_t cam_b) {
-    edges.push_back(obs_pair {cam_a, cam_b, std::vector<pixel_t>(), std::vector<pixel_t>()});
+    edges.push_back(obs_pair {cam_a, cam_b, std::vector<uint32_t>(), std::vector<uint32_t>()});
+}
+
+std::vector<KeypointTable>& FeaturesGraph::writable_keypoints() {
+    if (keypoints.use_count() != 1) {
+        keypoints = std::make_shared<std::vector<KeypointTable>>(*keypoints);
+    }
+    // The tables are always allocated non-const, only shared as const
+    return const_cast<std::vector<KeypointTable>&>(*keypoints);
+}
+
+KeypointTable& FeaturesGraph::table(size_t cam) {
+    std::vector<KeypointTable>& tables = writable_keypoints();
+    if (cam >= tables.size()) {
+        if (!data_set) {
+            throw std::runtime_error("FeaturesGraph has no associated DataSet.");
+        }
+        tables.resize(cam + 1, KeypointTable(static_cast<unsigned long>(data_set->rows),
+                                             static_cast<unsigned long>(data_set->cols)));
+    }
+    return tables[cam];
+}
+
+void FeaturesGraph::add_match(size_t e, const pixel_t& a, const pixel_t& b) {
+    obs_pair& edge = edges.at(e);
+    table(std::max(edge.cam_a, edge.cam_b));
+    std::vector<KeypointTable>& tables = writable_keypoints();
+    edge.index_a.push_back(tables[edge.cam_a].add(a));
+    edge.index_b.push_back(tables[edge.cam_b].add(b));
+}
+
+void FeaturesGraph::clear_matches() {
+    for (auto& edge : edges) {
+        edge.index_a.clear();
+        edge.index_b.clear();
+    }
+    keypoints = std::make_shared<std::vector<KeypointTable>>();
+}
+
+FeaturesGraph FeaturesGraph::resampled_edge(size_t e, const vector<size_t>& indexes) const {
+    const obs_pair& edge = edges.at(e);
+    FeaturesGraph sample;
+    sample.data_set = data_set;
+    sample.number_of_matches = indexes.size();
+    sample.compute_scale = compute_scale;
+    sample.computed = computed;
+    sample.compressor = compressor;
+    sample.keypoints = keypoints;
+    sample.add_edge(edge.cam_a, edge.cam_b);
+    obs_pair& resampled = sample.edges[0];
+    resampled.index_a.reserve(indexes.size());
+    resampled.index_b.reserve(indexes.size());
+    for (size_t i : indexes) {
+        resampled.index_a.push_back(edge.index_a.at(i));
+        resampled.index_b.push_back(edge.index_b.at(i));
+    }
+    return sample;
 }
 
 // Returns the list of indexes that sort the match array by distance
@@ -40,15 +140,6 @@ vector<size_t> argsort(vector<cv::DMatch> matches) {
     return indexes;
 }
 
-template<typename T>
-vector<T> reorder(const vector<T>& input, vector<size_t> indexes) {
-    vector<T> output(input.size());
-    for (size_t i = 0; i < input.size(); i++) {
-        output[i] = input[indexes[i]];
-    }
-    return output;
-}
-
 void write_matches_image(string path, cv::Mat image1, cv::Mat image2,
                       vector<cv::KeyPoint> keypoint1, vector<cv::KeyPoint> keypoint2,
                       vector<cv::DMatch> matches,
@@ -71,6 +162,20 @@ void write_matches_image(string path, cv::Mat image1, cv::Mat image2,
 }
 
 void FeaturesGraph::compute(const std::string& data_root) {
+    compute(data_root, vector<match_predictor>(), 0.0);
+}
+
+void FeaturesGraph::compute(const std::string& data_root, const vector<match_predictor>& predictors, double search_radius) {
+    compute_edges(data_root, 0, predictors, search_radius);
+}
+
+void FeaturesGraph::compute_new_edges(const std::string& data_root, size_t first_edge) {
+    compute_edges(data_root, first_edge, vector<match_predictor>(), 0.0);
+}
+
+void FeaturesGraph::compute_edges(const std::string& data_root, size_t first_edge,
+                                  const vector<match_predictor>& predictors, double search_radius) {
+    TRACE_SCOPE("features_compute");
     if (!data_set) {
         throw std::runtime_error("FeaturesGraph has no associated DataSet.");
     }
@@ -78,32 +183,137 @@ void FeaturesGraph::compute(const std::string& data_root) {
         throw std::runtime_error("FeaturesGraph has invalid maximum number of matches: " + std::to_string(number_of_matches));
     }
 
-    std::vector<cv::Mat> images;
-    for (auto& name : data_set->filenames) {
-        cv::Mat im = cv::imread(data_root + "/" + name);
-        if (im.data == NULL) {
-            throw std::runtime_error("Cannot load image " + name);
-        }
-        if (compute_scale != 1.0) {
-            cv::Mat resized;
-            cv::resize(im, resized, cv::Size(), compute_scale, compute_scale, cv::INTER_AREA);
-            im = resized;
+    // Only the images of the edges to compute
+    std::vector<cv::Mat> images(data_set->filenames.size());
+    for (size_t i = first_edge; i < edges.size(); i++) {
+        for (size_t cam : {edges[i].cam_a, edges[i].cam_b}) {
+            if (images.at(cam).empty()) {
+                images[cam] = load_image(data_root + "/" + data_set->filenames[cam], compute_scale);
+            }
         }
-        images.push_back(im);
     }
 
     cv::Ptr<cv::xfeatures2d::SIFT> sift = cv::xfeatures2d::SIFT::create();
-    for (size_t i = 0; i < edges.size(); i++) {
-        edges[i].compute(images, sift, sift, compute_scale, number_of_matches);
+    for (size_t i = first_edge; i < edges.size(); i++) {
+        match_predictor predict = i < predictors.size() ? predictors[i] : match_predictor();
+        table(std::max(edges[i].cam_a, edges[i].cam_b));
+        std::vector<KeypointTable>& tables = writable_keypoints();
+        edges[i].compute(images, tables[edges[i].cam_a], tables[edges[i].cam_b],
+                         sift, sift, compute_scale, number_of_matches, predict, search_radius, &compressor);
+    }
+    for (auto& t : writable_keypoints()) {
+        t.release_lookup();
     }
     computed = true;
 }
 
+vector<cv::DMatch> match_sorted(cv::Mat descriptor1, cv::Mat descriptor2) {
+    // Match using FLANN
+    // FLANN needs type of descriptor to be CV_32F
+    if (descriptor1.type()!= CV_32F) {
+        descriptor1.convertTo(descriptor1, CV_32F);
+    }
+    if (descriptor2.type()!= CV_32F) {
+        descriptor2.convertTo(descriptor2, CV_32F);
+    }
+    vector<cv::DMatch> matches;
+    {
+        TRACE_SCOPE("flann_match");
+        cv::FlannBasedMatcher matcher;
+        matcher.match(descriptor1, descriptor2, matches);
+    }
+
+    // Sort matches by distance
+    // Note that keypoints don't need to be reordered because the index
+    // of a match's keypoint is stored in match.queryIdx and match.trainIdx
+    // (i.e. is not given implicitly by the order of the keypoint vector)
+    TRACE_SCOPE("argsort");
+    vector<size_t> order = argsort(matches);
+    return reorder(matches, order);
+}
+
+vector<cv::DMatch> match_guided(const vector<cv::KeyPoint>& keypoint1, cv::Mat descriptor1,
+                                const vector<cv::KeyPoint>& keypoint2, cv::Mat descriptor2,
+                                const vector<cv::Point2f>& predicted, float radius) {
+    TRACE_SCOPE("guided_match");
+    if (descriptor1.type() != CV_32F) {
+        descriptor1.convertTo(descriptor1, CV_32F);
+    }
+    if (descriptor2.type() != CV_32F) {
+        descriptor2.convertTo(descriptor2, CV_32F);
+    }
+    vector<cv::DMatch> matches;
+    if (keypoint2.empty() || radius <= 0) {
+        return matches;
+    }
+
+    // Bucket the keypoints of the second image in a grid of radius sized cells
+    float max_x = 0, max_y = 0;
+    for (auto& kp : keypoint2) {
+        max_x = std::max(max_x, kp.pt.x);
+        max_y = std::max(max_y, kp.pt.y);
+    }
+    const int grid_cols = static_cast<int>(max_x / radius) + 1;
+    const int grid_rows = static_cast<int>(max_y / radius) + 1;
+    vector<vector<int>> grid(grid_cols * grid_rows);
+    for (size_t j = 0; j < keypoint2.size(); j++) {
+        int gx = static_cast<int>(keypoint2[j].pt.x / radius);
+        int gy = static_cast<int>(keypoint2[j].pt.y / radius);
+        grid[gy * grid_cols + gx].push_back(static_cast<int>(j));
+    }
+
+    const int length = descriptor1.cols;
+    for (size_t i = 0; i < keypoint1.size() && i < predicted.size(); i++) {
+        const cv::Point2f& p = predicted[i];
+        if (!(p.x > -radius && p.x < max_x + radius && p.y > -radius && p.y < max_y + radius)) {
+            continue; // Also skips NaN
+        }
+        const float* d1 = descriptor1.ptr<float>(static_cast<int>(i));
+        float best = std::numeric_limits<float>::max();
+        int best_index = -1;
+        const int gx_min = std::max(0, static_cast<int>(std::floor((p.x - radius) / radius)));
+        const int gx_max = std::min(grid_cols - 1, static_cast<int>(std::floor((p.x + radius) / radius)));
+        const int gy_min = std::max(0, static_cast<int>(std::floor((p.y - radius) / radius)));
+        const int gy_max = std::min(grid_rows - 1, static_cast<int>(std::floor((p.y + radius) / radius)));
+        for (int gy = gy_min; gy <= gy_max; gy++) {
+            for (int gx = gx_min; gx <= gx_max; gx++) {
+                for (int j : grid[gy * grid_cols + gx]) {
+                    const cv::Point2f& q = keypoint2[j].pt;
+                    if ((q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y) > radius * radius) {
+                        continue;
+                    }
+                    const float* d2 = descriptor2.ptr<float>(j);
+                    float distance = 0;
+                    for (int k = 0; k < length && distance < best; k++) {
+                        distance += (d1[k] - d2[k]) * (d1[k] - d2[k]);
+                    }
+                    if (distance < best) {
+                        best = distance;
+                        best_index = j;
+                    }
+                }
+            }
+        }
+        if (best_index >= 0) {
+            matches.push_back(cv::DMatch(static_cast<int>(i), best_index, std::sqrt(best)));
+        }
+    }
+
+    TRACE_SCOPE("argsort");
+    vector<size_t> order = argsort(matches);
+    return reorder(matches, order);
+}
+
 void obs_pair::compute(const std::vector<cv::Mat>& images,
+                       KeypointTable& keypoints_a,
+                       KeypointTable& keypoints_b,
                        cv::Ptr<cv::FeatureDetector> detector,
                        cv::Ptr<cv::DescriptorExtractor> descriptor,
                        double compute_scale,
-                       size_t number_of_matches) {
+                       size_t number_of_matches,
+                       const match_predictor& predict,
+                       double search_radius,
+                       DescriptorCompressor* compressor) {
     std::vector<cv::KeyPoint> keypoint1;
     std::vector<cv::KeyPoint> keypoint2;
     cv::Mat descriptor1;
@@ -111,43 +321,63 @@ void obs_pair::compute(const std::vector<cv::Mat>& images,
     std::vector<cv::DMatch> matches;
 
     // Detect and compute descriptors
-    detector->detect(images[cam_a], keypoint1);
-    detector->detect(images[cam_b], keypoint2);
-    descriptor->compute(images[cam_a], keypoint1, descriptor1);
-    descriptor->compute(images[cam_b], keypoint2, descriptor2);
+    {
+        TRACE_SCOPE("sift_detect");
+        detector->detect(images[cam_a], keypoint1);
+        detector->detect(images[cam_b], keypoint2);
+    }
+    {
+        TRACE_SCOPE("sift_compute");
+        descriptor->compute(images[cam_a], keypoint1, descriptor1);
+        descriptor->compute(images[cam_b], keypoint2, descriptor2);
+    }
 
+    // Full descriptors are replaced by their CV_8S compressed form
+    const bool compressed = compressor && compressor->dims > 0 && !descriptor1.empty() && !descriptor2.empty();
     if (descriptor1.empty() || descriptor2.empty()) {
         std::cerr << "Empty descriptor!" << std::endl;
+    } else if (compressed) {
+        TRACE_SCOPE("descriptor_compression");
+        if (!compressor->trained()) {
+            cv::Mat samples;
+            cv::vconcat(descriptor1, descriptor2, samples);
+            compressor->train(samples);
+        }
+        descriptor1 = compressor->compress(descriptor1);
+        descriptor2 = compressor->compress(descriptor2);
     }
 
-    // Match using FLANN
-    // FLANN needs type of descriptor to be CV_32F
-    if (descriptor1.type()!= CV_32F) {
-        descriptor1.convertTo(descriptor1, CV_32F);
-    }
-    if (descriptor2.type()!= CV_32F) {
-        descriptor2.convertTo(descriptor2, CV_32F);
+    if (predict) {
+        // Predicted positions, in the scaled image's (x, y) coordinates
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        vector<cv::Point2f> predicted(keypoint1.size(), cv::Point2f(nan, nan));
+        for (size_t i = 0; i < keypoint1.size(); i++) {
+            pixel_t pa(static_cast<double>(keypoint1[i].pt.y) / compute_scale,
+                       static_cast<double>(keypoint1[i].pt.x) / compute_scale);
+            pixel_t pb;
+            if (predict(pa, pb)) {
+                predicted[i] = cv::Point2f(static_cast<float>(pb.j * compute_scale),
+                                           static_cast<float>(pb.i * compute_scale));
+            }
+        }
+        matches = match_guided(keypoint1, descriptor1, keypoint2, descriptor2,
+                               predicted, static_cast<float>(search_radius));
+    } else if (compressed) {
+        matches = match_compressed(*compressor, descriptor1, descriptor2);
+    } else {
+        matches = match_sorted(descriptor1, descriptor2);
     }
-    cv::FlannBasedMatcher matcher;
-    matcher.match(descriptor1, descriptor2, matches);
-
-    // Sort matches by distance
-    // Note that keypoints don't need to be reordered because the index
-    // of a match's keypoint is stored in match.queryIdx and match.trainIdx
-    // (i.e. is not given implicitly by the order of the keypoint vector)
-    vector<size_t> order = argsort(matches);
-    matches = reorder(matches, order);
 
     // Store into simple ordered by distance vector of observations
     for (size_t i = 0; i < matches.size() && i < number_of_matches; i++) {
         // query is kp1, train is kp2 (see declaration of matcher.match)
         // saved in pixel coordinates: opencv(y, x) == pixel_t(i, j)
-        obs_a.push_back(pixel_t(
+        index_a.push_back(keypoints_a.add(pixel_t(
                 static_cast<double>(keypoint1[matches[i].queryIdx].pt.y) / compute_scale,
-                static_cast<double>(keypoint1[matches[i].queryIdx].pt.x) / compute_scale));
-        obs_b.push_back(pixel_t(
+                static_cast<double>(keypoint1[matches[i].queryIdx].pt.x) / compute_scale)));
+        index_b.push_back(keypoints_b.add(pixel_t(
                 static_cast<double>(keypoint2[matches[i].trainIdx].pt.y) / compute_scale,
-                static_cast<double>(keypoint2[matches[i].trainIdx].pt.x) / compute_scale));
+                static_cast<double>(keypoint2[matches[i].trainIdx].pt.x) / compute_scale)));
     }
 }
 
@@ -4,31 +4,105 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <functional>
+#include <cstdint>
+#include <unordered_map>
 #include <cereal/types/vector.hpp>
 #include <cereal/types/array.hpp>
 #include <opencv2/opencv.hpp>
 #include "opencv2/xfeatures2d.hpp"
 #include "data_set.h"
 #include "types.h"
+#include "descriptor_compression.h"
+#include "project_format.h"
 
 #define NVP(x) CEREAL_NVP(x)
 
+// Returns the list of indexes that sort the match array by distance
+std::vector<size_t> argsort(std::vector<cv::DMatch> matches);
+
+// Permute a vector by a list of indexes
+template<typename T>
+std::vector<T> reorder(const std::vector<T>& input, std::vector<size_t> indexes) {
+    std::vector<T> output(input.size());
+    for (size_t i = 0; i < input.size(); i++) {
+        output[i] = input[indexes[i]];
+    }
+    return output;
+}
+
+// FLANN matches of descriptor1 into descriptor2, sorted by distance
+std::vector<cv::DMatch> match_sorted(cv::Mat descriptor1, cv::Mat descriptor2);
+
+// Matches of descriptor1 into descriptor2, sorted by distance, where each keypoint
+// of the first image is only compared to the keypoints of the second image lying
+// within radius of its predicted position. Keypoints predicted at NaN are unmatched.
+// Descriptors are compared as floats, compressed ones in their quantized units.
+std::vector<cv::DMatch> match_guided(const std::vector<cv::KeyPoint>& keypoint1, cv::Mat descriptor1,
+                                     const std::vector<cv::KeyPoint>& keypoint2, cv::Mat descriptor2,
+                                     const std::vector<cv::Point2f>& predicted, float radius);
+
+// Predicts the full resolution pixel in cam_b of a full resolution pixel in cam_a,
+// typically from a previous solution. Returns false if there is no prediction.
+typedef std::function<bool(const pixel_t&, pixel_t&)> match_predictor;
+
+// Matched keypoints of one image, shared by all the edges of the image
+// Stored as float32 structure of arrays, relative to the image center along the
+// sensor axes (x = j - cols/2, y = rows/2 - i, as in pixel_t::to_sensor), so that
+// sensor coordinates are only a scaling by the pixel size.
+// Keypoints at the same position are stored once.
+class KeypointTable {
+public:
+    explicit KeypointTable(unsigned long rows = 0, unsigned long cols = 0) : rows(rows), cols(cols) {}
+
+    // Index of the keypoint at p, added if there isn't one yet
+    uint32_t add(const pixel_t& p);
+    // Free the lookup used by add(), it is rebuilt by the next add()
+    void release_lookup();
+    void clear();
+
+    size_t size() const { return x.size(); }
+
+    pixel_t pixel(uint32_t k) const {
+        return pixel_t(static_cast<double>(rows/2) - static_cast<double>(y[k]),
+                       static_cast<double>(x[k]) + static_cast<double>(cols/2));
+    }
+
+    sensor_t sensor(uint32_t k, double pixel_size) const {
+        return sensor_t(static_cast<double>(x[k]) * pixel_size, static_cast<double>(y[k]) * pixel_size);
+    }
+
+    unsigned long rows, cols;
+    std::vector<float> x, y;
+
+private:
+    std::unordered_map<uint64_t, uint32_t> lookup;
+};
+
 // Data structure for one edge of the features graph
+// Matches are pairs of indexes into the keypoint tables of cam_a and cam_b
 struct obs_pair {
     size_t cam_a, cam_b;
-    std::vector<pixel_t> obs_a, obs_b;
+    std::vector<uint32_t> index_a, index_b;
+
+    size_t size() const { return index_a.size(); }
 
+    // Without a predictor, keypoints are matched over the whole images
+    // With one, matches are searched within search_radius pixels (at compute_scale)
+    // of the predicted positions
+    // Descriptors are compressed and matched in compressed form if a compressor
+    // with dims > 0 is given, training it on this edge's descriptors if needed
+    // Matched keypoints are added to keypoints_a and keypoints_b
     void compute(const std::vector<cv::Mat>&,
+                 KeypointTable& keypoints_a,
+                 KeypointTable& keypoints_b,
                  cv::Ptr<cv::FeatureDetector>,
                  cv::Ptr<cv::DescriptorExtractor>,
                  double compute_scale,
-                 size_t number_of_matches);
-
-    template <class Archive>
-    void serialize(Archive& ar) {
-        ar(NVP(cam_a), NVP(cam_b),
-           NVP(obs_a), NVP(obs_b));
-    }
+                 size_t number_of_matches,
+                 const match_predictor& predict = match_predictor(),
+                 double search_radius = 0.0,
+                 DescriptorCompressor* compressor = nullptr);
 };
 
 // TODO customizable algorithm, more parameters, etc...
@@ -39,21 +113,99 @@ public:
     FeaturesGraph();
     void add_edge(size_t cam_a, size_t cam_b);
     void compute(const std::string& data_dir);
+    // Compute with guided matching, predictors[i] seeds edges[i] if set
+    void compute(const std::string& data_dir, const std::vector<match_predictor>& predictors, double search_radius);
+    // Compute edges[first_edge] onwards only, such as edges added to a computed graph
+    void compute_new_edges(const std::string& data_dir, size_t first_edge);
 
+    // Append a match of pixel a of cam_a and pixel b of cam_b to edges[e]
+    void add_match(size_t e, const pixel_t& a, const pixel_t& b);
+    // Remove the matches of all edges, and the keypoints
+    void clear_matches();
+    // Graph of edges[e] alone with its matches at indexes, such as a bootstrap
+    // sample. It shares this graph's keypoint tables.
+    FeaturesGraph resampled_edge(size_t e, const std::vector<size_t>& indexes) const;
+
+    pixel_t pixel(size_t cam, uint32_t k) const {
+        return (*keypoints)[cam].pixel(k);
+    }
+
+    sensor_t sensor(size_t cam, uint32_t k, double pixel_size) const {
+        return (*keypoints)[cam].sensor(k, pixel_size);
+    }
+
+    // Edges are saved with their matches as pixels, as they were before keypoint tables
     template <class Archive>
-    void serialize(Archive& ar) {
+    void save(Archive& ar) const {
+        std::vector<edge_record> records;
+        for (auto& edge : edges) {
+            records.push_back(edge_record {edge.cam_a, edge.cam_b, {}, {}});
+            for (size_t i = 0; i < edge.size(); i++) {
+                records.back().obs_a.push_back(pixel(edge.cam_a, edge.index_a[i]));
+                records.back().obs_b.push_back(pixel(edge.cam_b, edge.index_b[i]));
+            }
+        }
         ar(NVP(data_set),
            NVP(number_of_matches),
            NVP(compute_scale),
            NVP(computed),
-           NVP(edges));
+           NVP(compressor),
+           cereal::make_nvp("edges", records));
+    }
+
+    template <class Archive>
+    void load(Archive& ar) {
+        std::vector<edge_record> records;
+        ar(NVP(data_set),
+           NVP(number_of_matches),
+           NVP(compute_scale),
+           NVP(computed));
+        if (archive_version() > 0) {
+            ar(NVP(compressor));
+        }
+        ar(cereal::make_nvp("edges", records));
+        edges.clear();
+        keypoints = std::make_shared<std::vector<KeypointTable>>();
+        for (auto& r : records) {
+            add_edge(r.cam_a, r.cam_b);
+            for (size_t i = 0; i < r.obs_a.size() && i < r.obs_b.size(); i++) {
+                add_match(edges.size() - 1, r.obs_a[i], r.obs_b[i]);
+            }
+        }
+        for (auto& table : writable_keypoints()) {
+            table.release_lookup();
+        }
     }
 
     std::shared_ptr<DataSet> data_set;
     size_t number_of_matches; // Number of matches per edge
     double compute_scale; // Down scale factor for computing features
     bool computed; // true iff compute() has been performed
+    DescriptorCompressor compressor; // Trained on the first edge computed, if dims > 0
     std::vector<obs_pair> edges; // Edges of the features graph
+    // Matched keypoints of each image
+    // Copies of a graph share them until one of the copies adds keypoints
+    std::shared_ptr<const std::vector<KeypointTable>> keypoints;
+
+private:
+    struct edge_record {
+        size_t cam_a, cam_b;
+        std::vector<pixel_t> obs_a, obs_b;
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(NVP(cam_a), NVP(cam_b),
+               NVP(obs_a), NVP(obs_b));
+        }
+    };
+
+    // Keypoint tables to modify, copied first if shared with another graph
+    std::vector<KeypointTable>& writable_keypoints();
+    // Keypoint table of an image, created if needed
+    KeypointTable& table(size_t cam);
+    // Match edges[first_edge] onwards, loading only their images
+    void compute_edges(const std::string& data_dir, size_t first_edge,
+                       const std::vector<match_predictor>& predictors, double search_radius);
 };
 
 #endif
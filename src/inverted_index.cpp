@@ -0,0 +1,94 @@
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "inverted_index.h"
+
+using std::vector;
+using std::pair;
+
+size_t InvertedIndex::add(const vector<int>& words) {
+    if (finalized) {
+        throw std::runtime_error("InvertedIndex: add() after finalize()");
+    }
+    // Term counts, weighted in finalize()
+    std::map<int, float> counts;
+    for (int w : words) {
+        if (w < 0 || static_cast<size_t>(w) >= postings.size()) {
+            throw std::runtime_error("InvertedIndex: word out of vocabulary");
+        }
+        counts[w] += 1.0f;
+    }
+    vector<entry> document;
+    document.reserve(counts.size());
+    for (auto& it : counts) {
+        document.push_back(entry {static_cast<size_t>(it.first), it.second});
+    }
+    documents.push_back(document);
+    return documents.size() - 1;
+}
+
+void InvertedIndex::finalize(double max_document_frequency, size_t min_documents) {
+    const double n = static_cast<double>(documents.size());
+    const bool stop_words = documents.size() >= min_documents;
+    vector<size_t> frequency(postings.size(), 0);
+    for (auto& document : documents) {
+        for (auto& e : document) {
+            frequency[e.id]++;
+        }
+    }
+
+    for (size_t d = 0; d < documents.size(); d++) {
+        vector<entry>& document = documents[d];
+        double norm = 0.0;
+        for (auto& e : document) {
+            const double df = static_cast<double>(frequency[e.id]);
+            // Stop words carry no weight, others do even if in every document
+            const double idf = stop_words && df > max_document_frequency * n ? 0.0 : std::log(1.0 + n / df);
+            e.weight = static_cast<float>(static_cast<double>(e.weight) * idf);
+            norm += static_cast<double>(e.weight) * static_cast<double>(e.weight);
+        }
+        document.erase(std::remove_if(document.begin(), document.end(),
+                                      [](const entry& e) { return e.weight == 0.0f; }),
+                       document.end());
+        norm = std::sqrt(norm);
+        for (auto& e : document) {
+            e.weight = static_cast<float>(static_cast<double>(e.weight) / norm);
+            postings[e.id].push_back(entry {d, e.weight});
+        }
+    }
+    finalized = true;
+}
+
+vector<pair<size_t, double>> InvertedIndex::query(size_t doc, size_t k) const {
+    if (!finalized) {
+        throw std::runtime_error("InvertedIndex: query() before finalize()");
+    }
+    // Accumulate dot products over shared words
+    vector<double> scores(documents.size(), 0.0);
+    vector<size_t> touched;
+    for (auto& word : documents.at(doc)) {
+        for (auto& e : postings[word.id]) {
+            if (e.id == doc) {
+                continue;
+            }
+            if (scores[e.id] == 0.0) {
+                touched.push_back(e.id);
+            }
+            scores[e.id] += static_cast<double>(word.weight) * static_cast<double>(e.weight);
+        }
+    }
+
+    vector<pair<size_t, double>> result;
+    result.reserve(touched.size());
+    for (size_t d : touched) {
+        result.push_back(std::make_pair(d, scores[d]));
+    }
+    auto by_score = [](const pair<size_t, double>& a, const pair<size_t, double>& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+    k = std::min(k, result.size());
+    std::partial_sort(result.begin(), result.begin() + k, result.end(), by_score);
+    result.resize(k);
+    return result;
+}
@@ -0,0 +1,40 @@
+#ifndef INVERTED_INDEX_H
+#define INVERTED_INDEX_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// Inverted index of bag-of-words documents with tf-idf cosine similarity
+// Used to find which images overlap from the visual words of their features.
+// A query only visits the documents sharing a word with it, and words present
+// in too many documents are ignored, so finding the neighbors of all images
+// stays near-linear in their number.
+class InvertedIndex {
+public:
+    explicit InvertedIndex(size_t vocabulary_size) : postings(vocabulary_size), finalized(false) {}
+
+    // Add a document as the words of its features, returns its id (0, 1, ...)
+    size_t add(const std::vector<int>& words);
+
+    // Compute the weights, once all documents are added
+    // Words in more than max_document_frequency of the documents are ignored once
+    // there are min_documents: in fewer, most shared words are in most documents.
+    void finalize(double max_document_frequency = 0.5, size_t min_documents = 4);
+
+    // Up to k most similar documents to doc, excluding itself, by decreasing score
+    std::vector<std::pair<size_t, double>> query(size_t doc, size_t k) const;
+
+    size_t size() const { return documents.size(); }
+
+private:
+    struct entry {
+        size_t id; // Word of a document, or document of a word
+        float weight;
+    };
+    std::vector<std::vector<entry>> postings; // Documents of each word
+    std::vector<std::vector<entry>> documents; // Words of each document
+    bool finalized;
+};
+
+#endif
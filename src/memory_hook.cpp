@@ -0,0 +1,79 @@
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include "memory_report.h"
+
+// Replacement of the global allocation functions feeding MemoryAccount
+// Every block starts with a header holding the bytes it was counted for, 0 if
+// it was allocated while accounting was disabled, so that only counted blocks
+// are subtracted when released.
+
+// Keeps the returned pointer aligned like malloc's
+static const size_t header_size = alignof(std::max_align_t);
+
+static void* allocate(size_t size) {
+    void* block = std::malloc(header_size + size);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    MemoryAccount& account = MemoryAccount::instance();
+    size_t counted = 0;
+    if (account.enabled()) {
+        counted = header_size + size;
+        account.allocated(counted);
+    }
+    *static_cast<size_t*>(block) = counted;
+    return static_cast<char*>(block) + header_size;
+}
+
+static void release(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    void* block = static_cast<char*>(p) - header_size;
+    const size_t counted = *static_cast<size_t*>(block);
+    if (counted > 0) {
+        MemoryAccount::instance().freed(counted);
+    }
+    std::free(block);
+}
+
+void* operator new(size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* p) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    release(p);
+}
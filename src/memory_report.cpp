@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+#include "memory_report.h"
+
+using std::string;
+
+thread_local int64_t MemoryAccount::thread_live = 0;
+thread_local int64_t MemoryAccount::thread_peak = 0;
+
+MemoryAccount& MemoryAccount::instance() {
+    static MemoryAccount account;
+    return account;
+}
+
+// Commands can return without disabling accounting, the sampler must not
+// outlive the account
+MemoryAccount::~MemoryAccount() {
+    disable();
+}
+
+void MemoryAccount::enable() {
+    if (enabled()) {
+        return;
+    }
+    is_enabled = true;
+    sampling = true;
+    sampler = std::thread([this]() {
+        while (sampling) {
+            sample_rss();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+}
+
+void MemoryAccount::disable() {
+    if (!enabled()) {
+        return;
+    }
+    sampling = false;
+    sampler.join();
+    is_enabled = false;
+}
+
+void MemoryAccount::sample_rss() {
+    const int64_t now = current_rss();
+    std::lock_guard<std::mutex> guard(mutex);
+    for (auto& it : rss_watches) {
+        it.second = std::max(it.second, now);
+    }
+}
+
+MemoryAccount::mark MemoryAccount::enter() {
+    const int64_t rss = current_rss();
+    mark m {thread_live, thread_peak, 0};
+    // This thread's peak restarts from its current heap for the stage
+    thread_peak = thread_live;
+    std::lock_guard<std::mutex> guard(mutex);
+    m.rss_watch = next_rss_watch++;
+    rss_watches[m.rss_watch] = rss;
+    return m;
+}
+
+void MemoryAccount::exit(const char* name, const mark& m) {
+    const int64_t rss = current_rss();
+    const int64_t stage_heap_peak = thread_peak;
+    // Enclosing stages see the peak of this one
+    thread_peak = std::max(thread_peak, m.saved_thread_peak);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    auto watch = rss_watches.find(m.rss_watch);
+    const int64_t stage_rss_peak = std::max(watch->second, rss);
+    rss_watches.erase(watch);
+
+    stage_stats& s = stages[name];
+    s.calls++;
+    s.peak_heap = std::max(s.peak_heap, stage_heap_peak - m.thread_live);
+    s.retained_heap += thread_live - m.thread_live;
+    s.peak_rss = std::max(s.peak_rss, stage_rss_peak);
+}
+
+int64_t MemoryAccount::current_rss() {
+    long pages = 0;
+    long resident = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == NULL) {
+        return 0;
+    }
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    std::fclose(statm);
+    return static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+int64_t MemoryAccount::process_peak_rss() {
+    std::ifstream status("/proc/self/status");
+    string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoll(line.substr(6)) * 1024;
+        }
+    }
+    return 0;
+}
+
+std::map<string, MemoryAccount::stage_stats> MemoryAccount::stats() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return stages;
+}
+
+void MemoryAccount::write_report(std::ostream& os) const {
+    std::lock_guard<std::mutex> guard(mutex);
+    const double mb = 1024.0 * 1024.0;
+
+    os << std::left << std::setw(28) << "stage" << std::right
+       << std::setw(8) << "calls" << std::setw(18) << "peak heap (MB)"
+       << std::setw(20) << "retained heap (MB)" << std::setw(16) << "peak RSS (MB)" << "\n";
+    os << std::fixed << std::setprecision(1);
+    for (auto& it : stages) {
+        os << std::left << std::setw(28) << it.first << std::right
+           << std::setw(8) << it.second.calls
+           << std::setw(18) << it.second.peak_heap / mb
+           << std::setw(20) << it.second.retained_heap / mb
+           << std::setw(16) << it.second.peak_rss / mb << "\n";
+    }
+    os << "Process peak heap: " << heap_peak.load() / mb << " MB, "
+       << "peak RSS: " << process_peak_rss() / mb << " MB\n";
+    os.flush();
+}
@@ -0,0 +1,119 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <cstdint>
+#include <ostream>
+
+// Peak and retained memory of pipeline stages
+// Heap bytes are counted by the operator new/delete replacements of memory_hook.cpp,
+// in programs that link it, while accounting is enabled. Memory not allocated through
+// operator new (OpenCV images use their own allocator) only shows in the resident
+// set size, which a background thread samples every few milliseconds.
+// Stages are the TRACE_SCOPE names. Heap figures of a stage count the allocations
+// and releases made by the thread running it, so that stages running concurrently
+// don't see each other's, but not those of worker threads it starts. Peak RSS is
+// of the whole process while the stage runs.
+class MemoryAccount {
+public:
+    // State at the start of a stage, restored when it ends
+    struct mark {
+        int64_t thread_live;
+        int64_t saved_thread_peak;
+        uint64_t rss_watch;
+    };
+
+    struct stage_stats {
+        size_t calls = 0;
+        int64_t peak_heap = 0; // Largest heap growth above the stage's start
+        int64_t retained_heap = 0; // Sum over calls of heap still allocated at the end
+        int64_t peak_rss = 0; // Largest resident set size while running
+    };
+
+    static MemoryAccount& instance();
+    ~MemoryAccount();
+
+    void enable();
+    void disable();
+    bool enabled() const { return is_enabled.load(std::memory_order_relaxed); }
+
+    // Called by the allocation hook
+    void allocated(size_t bytes) {
+        int64_t now = live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        int64_t peak = heap_peak.load(std::memory_order_relaxed);
+        while (now > peak && !heap_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+        thread_live += bytes;
+        thread_peak = std::max(thread_peak, thread_live);
+    }
+    void freed(size_t bytes) {
+        live.fetch_sub(bytes, std::memory_order_relaxed);
+        thread_live -= bytes;
+    }
+
+    mark enter();
+    void exit(const char* name, const mark& m);
+
+    // Current and peak resident set size of the process, in bytes
+    static int64_t current_rss();
+    static int64_t process_peak_rss();
+
+    // Statistics per stage name
+    std::map<std::string, stage_stats> stats() const;
+    void write_report(std::ostream& os) const;
+
+private:
+    MemoryAccount() : is_enabled(false), live(0), heap_peak(0), sampling(false) {}
+    void sample_rss();
+
+    std::atomic<bool> is_enabled;
+    // Process wide heap
+    std::atomic<int64_t> live;
+    std::atomic<int64_t> heap_peak;
+    // Heap of the calling thread, and its peak since the innermost stage started
+    static thread_local int64_t thread_live;
+    static thread_local int64_t thread_peak;
+
+    std::atomic<bool> sampling;
+    std::thread sampler;
+
+    mutable std::mutex mutex;
+    std::map<std::string, stage_stats> stages;
+    // Peak RSS of each running stage, updated by the sampler
+    std::map<uint64_t, int64_t> rss_watches;
+    uint64_t next_rss_watch = 0;
+};
+
+// Accounts the lifetime of the object to a stage, see TraceScope
+class MemoryScope {
+public:
+    explicit MemoryScope(const char* name) :
+        name(MemoryAccount::instance().enabled() ? name : nullptr) {
+        if (this->name) {
+            start = MemoryAccount::instance().enter();
+        }
+    }
+
+    ~MemoryScope() {
+        end();
+    }
+
+    void end() {
+        if (name) {
+            MemoryAccount::instance().exit(name, start);
+            name = nullptr;
+        }
+    }
+
+private:
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+    const char* name;
+    MemoryAccount::mark start;
+};
+
+#endif
@@ -2,14 +2,81 @@
 #define MODEL_H
 
 #include <utility>
+#include <type_traits>
+#include <algorithm>
 #include "ceres/ceres.h"
 #include <cereal/types/base_class.hpp>
 #include <cereal/types/polymorphic.hpp>
 #include <cereal/types/memory.hpp>
 #include <cereal/archives/json.hpp>
+#include <cereal/archives/portable_binary.hpp>
 #include "internal.h"
+#include "solution_history.h"
+#include "solve_record.h"
+#include "project_format.h"
+#include "object_pool.h"
+#include "trace.h"
+#include "cancellation.h"
 
 
+// Automatic differentiation of a functor held by value, with one or two parameter blocks
+// Equivalent to ceres::AutoDiffCostFunction for these cases, but without the separate
+// heap allocated functor, so that cost functions can live in an ObjectPool
+template <typename CostFunctor, int kNumResiduals, int N0, int N1 = 0>
+class InlineAutoDiffCostFunction : public ceres::SizedCostFunction<kNumResiduals, N0, N1> {
+public:
+    explicit InlineAutoDiffCostFunction(const CostFunctor& functor) : functor(functor) {}
+
+    virtual bool Evaluate(double const* const* parameters, double* residuals, double** jacobians) const {
+        if (jacobians == NULL) {
+            return call(parameters, residuals, two_blocks());
+        }
+
+        typedef ceres::Jet<double, N0 + N1> J;
+        J x[N0 + N1];
+        for (int i = 0; i < N0; i++) {
+            x[i] = J(parameters[0][i], i);
+        }
+        for (int i = 0; i < N1; i++) {
+            x[N0 + i] = J(parameters[1][i], N0 + i);
+        }
+        J r[kNumResiduals];
+        const J* blocks[2] = {x, x + N0};
+        if (!call(blocks, r, two_blocks())) {
+            return false;
+        }
+
+        for (int k = 0; k < kNumResiduals; k++) {
+            residuals[k] = r[k].a;
+            if (jacobians[0] != NULL) {
+                for (int i = 0; i < N0; i++) {
+                    jacobians[0][k * N0 + i] = r[k].v[i];
+                }
+            }
+            if (N1 > 0 && jacobians[1] != NULL) {
+                for (int i = 0; i < N1; i++) {
+                    jacobians[1][k * N1 + i] = r[k].v[N0 + i];
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    // Dispatch on the number of parameter blocks, only the matching one is instantiated
+    typedef std::integral_constant<bool, (N1 > 0)> two_blocks;
+    template <typename T>
+    bool call(const T* const* blocks, T* residuals, std::true_type) const {
+        return functor(blocks[0], blocks[1], residuals);
+    }
+    template <typename T>
+    bool call(const T* const* blocks, T* residuals, std::false_type) const {
+        return functor(blocks[0], residuals);
+    }
+
+    const CostFunctor functor;
+};
+
 // Base class for models' cost functions
 // Provides a factory to hide the construction of the autodiff'ed CostFunction object
 template <typename CostFunctor,
@@ -30,8 +97,27 @@ struct CostFunction {
         return new ceres::AutoDiffCostFunction<CostFunctor, kNumResiduals, N0, N1, N2, N3, N4, N5, N6, N7, N8, N9>
             (new CostFunctor(std::forward<Args>(args)...));
     }
+
+    // Cost functions of up to two parameter blocks constructed in a pool
+    // The pool owns them: the Problem must be created with
+    // cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP and must not outlive it
+    typedef InlineAutoDiffCostFunction<CostFunctor, kNumResiduals, N0, N1> pooled_type;
+    typedef ObjectPool<pooled_type> pool_type;
+
+    template <typename... Args>
+    static ceres::CostFunction* make_pooled(pool_type& pool, Args&&... args) {
+        static_assert(N2 == 0, "Pooled cost functions support up to two parameter blocks");
+        return pool.emplace(CostFunctor(std::forward<Args>(args)...));
+    }
 };
 
+// Problem options for the cost functions of a pool
+inline ceres::Problem::Options pooled_problem_options() {
+    ceres::Problem::Options problem_options;
+    problem_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    return problem_options;
+}
+
 // Utility class to enable logging of solutions at each sovler step
 template <typename SolutionType>
 class LogSolutionCallback : public ceres::IterationCallback {
@@ -41,11 +127,32 @@ public:
     LogSolutionCallback(std::vector<SolutionType>& v, const SolutionType& sol) : solutions(v), working_solution(sol) {}
     virtual ~LogSolutionCallback() {}
     virtual ceres::CallbackReturnType operator()(const ceres::IterationSummary&) {
+        TRACE_SCOPE("solution_log");
         solutions.push_back(working_solution);
         return ceres::SOLVER_CONTINUE;
     }
 };
 
+// Stops a solve when the command is cancelled or the solve's own time budget is spent
+// Ceres then keeps the parameters of the last successful step, the best solution so far
+class CancellationCallback : public ceres::IterationCallback {
+public:
+    explicit CancellationCallback(double budget) : stopped(false) { token.set_budget(budget); }
+    virtual ~CancellationCallback() {}
+    virtual ceres::CallbackReturnType operator()(const ceres::IterationSummary&) {
+        if (CancellationToken::command().cancelled() || token.cancelled()) {
+            stopped = true;
+            return ceres::SOLVER_TERMINATE_SUCCESSFULLY;
+        }
+        return ceres::SOLVER_CONTINUE;
+    }
+
+    bool stopped;
+
+private:
+    CancellationToken token;
+};
+
 struct UnprovidedFinal : public std::runtime_error {
     UnprovidedFinal(const std::string& str) : std::runtime_error(std::string("UnprovidedFinal: ") + str) {}
 };
@@ -54,7 +161,7 @@ struct UnprovidedFinal : public std::runtime_error {
 // Must overwrite solve() and clone()
 class Model {
 public:
-    Model() : solved(false) {
+    Model() : solved(false), time_budget(default_time_budget()) {
         // Default solver options common to all models
         options.linear_solver_type = ceres::DENSE_SCHUR;
         options.minimizer_progress_to_stdout = true;
@@ -63,11 +170,38 @@ public:
         options.num_threads = 1;
     }
 
+    // Copies don't keep the solution logger: it refers to the working solution
+    // of a solve of the original
+    Model(const Model& other) :
+        solved(other.solved),
+        features(other.features),
+        history(other.history),
+        solve_record(other.solve_record),
+        time_budget(other.time_budget),
+        options(other.options) {
+        options.callbacks.clear();
+    }
+
+    Model& operator=(const Model& other) {
+        solved = other.solved;
+        features = other.features;
+        history = other.history;
+        solve_record = other.solve_record;
+        time_budget = other.time_budget;
+        options = other.options;
+        options.callbacks.clear();
+        solution_logger.reset();
+        return *this;
+    }
+
     // virtual constructor pattern to allow polymorphic cloning
     // see https://isocpp.org/wiki/faq/virtual-functions#virtual-ctors
     // note this is a shallow copy because the features pointer is a reference
     virtual Model* clone() = 0;
     virtual ceres::Solver::Summary solve() = 0;
+    // Solve with the images of the data set in data_dir
+    // Only models that read the images override it
+    virtual ceres::Solver::Summary solve_with_images(const std::string& /*data_dir*/) { return solve(); }
     // True if it makes sense to bootstrap this model
     virtual bool bootstrapable() const = 0;
     virtual ~Model() {}
@@ -78,26 +212,86 @@ public:
     virtual internal_t final_internal() const { throw UnprovidedFinal("final_internal"); }
     virtual std::vector<std::array<double, 3>> final_terrain() const { throw UnprovidedFinal("final_terrain"); }
 
-    // Enable logging of solutions at every step
+    // Model this one is initialized from, for models that have one
+    virtual std::shared_ptr<Model> get_parent() const { return nullptr; }
+    virtual void set_parent(std::shared_ptr<Model>) {}
+
+    // Time budget of each solve of new models in seconds, <= 0 for none
+    static double& default_time_budget() {
+        static double budget = 0;
+        return budget;
+    }
+
+    // Time budget of each solve of this model in seconds, <= 0 for none
+    void set_time_budget(double seconds) { time_budget = seconds; }
+
+    // Print the solver's progress at every iteration to stdout
+    void set_progress_output(bool enabled) { options.minimizer_progress_to_stdout = enabled; }
+
+    // Enable logging of solutions at every step of the next solve
+    // working_solution must outlive it, run_solver disables logging once done
     template <typename T>
     void enable_logging(std::vector<T>& solutions, const T& working_solution) {
+        disable_logging();
         options.update_state_every_iteration = true;
         solution_logger.reset(new LogSolutionCallback<T>(solutions, working_solution));
         options.callbacks.push_back(solution_logger.get());
     }
 
+    void disable_logging() {
+        options.callbacks.erase(std::remove(options.callbacks.begin(), options.callbacks.end(), solution_logger.get()),
+                                options.callbacks.end());
+        solution_logger.reset();
+    }
+
     template <class Archive>
     void serialize(Archive& ar) {
         ar(cereal::make_nvp("solved", solved),
            cereal::make_nvp("features", features));
+        if (archive_version() > 0) {
+            ar(cereal::make_nvp("solve_record", solve_record));
+        }
     }
 
     bool solved;
     std::shared_ptr<FeaturesGraph> features;
 
+    // Storage of the logged solutions, serialized along with them
+    HistoryEncoding history;
+
+    // Telemetry of the last solve
+    SolveRecord solve_record;
+
 protected:
     friend class Bootstrap;
+
+    // ceres::Solve, stopped early by the time budget or the command's cancellation
+    // Records the solve, as partial if it was stopped
+    ceres::Solver::Summary run_solver(const ceres::Solver::Options& solver_options, ceres::Problem& problem) {
+        return run_solver(solver_options, [&problem](const ceres::Solver::Options& o, ceres::Solver::Summary* s) {
+            ceres::Solve(o, &problem, s);
+        });
+    }
+
+    // Same for a solver taking (options, summary) and honoring options.callbacks as ceres
+    template <typename Solver>
+    ceres::Solver::Summary run_solver(ceres::Solver::Options solver_options, Solver solve_function) {
+        CancellationCallback cancellation(time_budget);
+        solver_options.callbacks.push_back(&cancellation);
+        ceres::Solver::Summary summary;
+        {
+            TRACE_SCOPE("ceres_solve");
+            solve_function(solver_options, &summary);
+        }
+        solve_record = SolveRecord(summary);
+        solve_record.partial = cancellation.stopped;
+        // The logger refers to the caller's working solution, which goes out of scope
+        disable_logging();
+        return summary;
+    }
+
     // Non serialized state
+    double time_budget;
     ceres::Solver::Options options;
     std::shared_ptr<ceres::IterationCallback> solution_logger;
 };
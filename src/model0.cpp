@@ -1,24 +1,24 @@
 #include <memory>
 #include "model0.h"
+#include "trace.h"
+#include "two_view_lm.h"
 
 ceres::Solver::Summary Model0::solve() {
-    ceres::Problem problem;
+    TRACE_SCOPE("model0_solve");
+    TraceScope setup_scope("model0_setup");
     // Note: model0 only works with 2 cams, so will only consider the first edge
     obs_pair& edge = features->edges[0];
 
     // Initialize terrain by down projecting features
     // Right now solutions[0] and solutions[0].cameras is created in base() setup
     // in other models, it is initialized from parent model in Model::solve()
-    solutions[0].terrain.resize(edge.obs_a.size());
-
-    double rows = features->data_set->rows;
-    double cols = features->data_set->cols;
+    solutions[0].terrain.resize(edge.size());
 
     // For each observation
-    for (size_t i = 0; i < edge.obs_a.size(); i++) {
+    for (size_t i = 0; i < edge.size(); i++) {
         // Down project to z=0 to initialize terrain
-        sensor_t sens_a = edge.obs_a[i].to_sensor(pixel_size(internal), rows, cols);
-        sensor_t sens_b = edge.obs_b[i].to_sensor(pixel_size(internal), rows, cols);
+        sensor_t sens_a = features->sensor(edge.cam_a, edge.index_a[i], pixel_size(internal));
+        sensor_t sens_b = features->sensor(edge.cam_b, edge.index_b[i], pixel_size(internal));
 
         double dx_a, dy_a;
         double dx_b, dy_b;
@@ -36,11 +36,31 @@ ceres::Solver::Summary Model0::solve() {
     // The working solution is the one holding ceres' parameter blocks
     Model0::solution working_solution(solutions[0]);
 
+    if (backend == two_view_solver) {
+        vector<sensor_t> observed_a(edge.size()), observed_b(edge.size());
+        for (size_t i = 0; i < edge.size(); i++) {
+            observed_a[i] = features->sensor(edge.cam_a, edge.index_a[i], pixel_size(internal));
+            observed_b[i] = features->sensor(edge.cam_b, edge.index_b[i], pixel_size(internal));
+        }
+        setup_scope.end();
+
+        enable_logging(solutions, working_solution);
+        return run_solver(options, [&](const ceres::Solver::Options& o, ceres::Solver::Summary* summary) {
+            two_view_lm(o, internal.data(), working_solution.cameras[0].data(), working_solution.cameras[1].data(),
+                        observed_a, observed_b, working_solution.terrain, summary);
+        });
+    }
+
+    // Cost functions live in the pool, which outlives the problem
+    Model0ReprojectionError::pool_type cost_functions;
+    cost_functions.reserve(2 * edge.size());
+    ceres::Problem problem(pooled_problem_options());
+
     // Setup parameter and residual blocks
-    for (size_t i = 0; i < edge.obs_a.size(); i++) {
+    for (size_t i = 0; i < edge.size(); i++) {
         // Residual for left cam
-        sensor_t obs_left = edge.obs_a[i].to_sensor(pixel_size(internal), rows, cols);
-		ceres::CostFunction* cost_function_left = Model0ReprojectionError::make(internal, obs_left);
+        sensor_t obs_left = features->sensor(edge.cam_a, edge.index_a[i], pixel_size(internal));
+		ceres::CostFunction* cost_function_left = Model0ReprojectionError::make_pooled(cost_functions, internal, obs_left);
 		problem.AddResidualBlock(cost_function_left,
 			NULL,
 			working_solution.cameras[0].data(),
@@ -48,8 +68,8 @@ ceres::Solver::Summary Model0::solve() {
 			);
 
         // Residual for right cam
-        sensor_t obs_right = edge.obs_b[i].to_sensor(pixel_size(internal), rows, cols);
-		ceres::CostFunction* cost_function_right = Model0ReprojectionError::make(internal, obs_right);
+        sensor_t obs_right = features->sensor(edge.cam_b, edge.index_b[i], pixel_size(internal));
+		ceres::CostFunction* cost_function_right = Model0ReprojectionError::make_pooled(cost_functions, internal, obs_right);
 		problem.AddResidualBlock(cost_function_right,
 			NULL,
 			working_solution.cameras[1].data(),
@@ -58,11 +78,10 @@ ceres::Solver::Summary Model0::solve() {
     }
 
     problem.SetParameterBlockConstant(working_solution.cameras[0].data());
+    setup_scope.end();
 
     enable_logging(solutions, working_solution);
-    ceres::Solver::Summary summary;
-    ceres::Solve(options, &problem, &summary);
-    return summary;
+    return run_solver(options, problem);
 }
 
 internal_t Model0::final_internal() const {
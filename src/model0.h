@@ -20,17 +20,18 @@ using std::array;
 // 2D ground points (z=0)
 // Fixed internals and no distortion
 
+// The internals are shared with the model, not copied, and must outlive the cost function
 struct Model0ReprojectionError : CostFunction<Model0ReprojectionError, 2, 6, 2> {
-    const internal_t internal;
+    const double* internal;
     const sensor_t observed;
 
-	Model0ReprojectionError(const internal_t internal, const sensor_t observed)
-		: internal(internal), observed(observed) {}
+	Model0ReprojectionError(const internal_t& internal, const sensor_t observed)
+		: internal(internal.data()), observed(observed) {}
 
 	template <typename T>
 	bool operator()(const T* const external, const T* const point, T* residuals) const {
         // Subtract observed coordinates
-        bool r = model0_projection<T, T>(internal.data(), external, point, residuals);
+        bool r = model0_projection<T, T>(internal, external, point, residuals);
         residuals[0] -= T(observed.x);
         residuals[1] -= T(observed.y);
         return r;
@@ -48,8 +49,32 @@ public:
             ar(cereal::make_nvp("cameras", cameras),
                cereal::make_nvp("terrain", terrain));
         }
+
+        vector<double> flatten() const {
+            vector<double> flat;
+            append_flat(flat, cameras);
+            append_flat(flat, terrain);
+            return flat;
+        }
+
+        void unflatten(const vector<double>& flat) {
+            read_flat(read_flat(flat.begin(), cameras), terrain);
+        }
     };
 
+    // Solver of the normal equations
+    // ceres_solver: ceres with the options of Model, dense Schur by default
+    // two_view_solver: two_view_lm(), specialized to the one free camera of Model0
+    enum solver_backend { ceres_solver, two_view_solver };
+
+    Model0() : backend(default_backend()) {}
+
+    // Backend of new models
+    static solver_backend& default_backend() {
+        static solver_backend backend = ceres_solver;
+        return backend;
+    }
+
     virtual Model0* clone() override { return new Model0(*this); }
     virtual ceres::Solver::Summary solve() override;
 
@@ -63,11 +88,14 @@ public:
     void serialize(Archive& ar) {
         ar(cereal::make_nvp("base", cereal::base_class<Model>(this)),
            cereal::make_nvp("internal", internal),
-           cereal::make_nvp("solutions", solutions));
+           cereal::make_nvp("solutions", make_history(solutions, history)));
     }
 
     internal_t internal;
 
+    // Not serialized, selected per run
+    solver_backend backend;
+
     // List of solutions, from the initial guess (or parent model) to local optimum
     vector<solution> solutions;
 };
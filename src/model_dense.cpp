@@ -0,0 +1,137 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+#include "model_dense.h"
+#include "rectification.h"
+#include "image_features.h"
+#include "image_cache.h"
+#include "trace.h"
+
+// Rectified grayscale image and the mask of its pixels seen by the camera
+static void rectify(const cv::Mat& image, const cv::Mat& map_x, const cv::Mat& map_y, cv::Mat& rectified, cv::Mat& mask) {
+    cv::Mat gray;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        gray = image;
+    }
+    cv::remap(gray, rectified, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(0));
+    cv::remap(cv::Mat(gray.size(), CV_8U, cv::Scalar(255)), mask, map_x, map_y,
+              cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(0));
+}
+
+ceres::Solver::Summary ModelDense::solve() {
+    throw std::runtime_error("ModelDense reads the images, solve it with solve_with_images");
+}
+
+ceres::Solver::Summary ModelDense::solve_with_images(const std::string& data_dir) {
+    TRACE_SCOPE("model_dense_solve");
+    if (!parent) {
+        throw std::runtime_error("Solving ModelDense but no parent provided.");
+    }
+    // Not a least squares problem, but solved through run_solver for the time budget,
+    // cancellation and solve record of the other models: its callbacks are polled
+    // before each strip, and the summary reports the model size.
+    return run_solver(options, [&](const ceres::Solver::Options& o, ceres::Solver::Summary* summary) {
+        const auto start = std::chrono::steady_clock::now();
+        // Strips are matched on other threads, which poll under this command's token
+        CancellationToken& token = CancellationToken::command();
+        std::mutex mutex;
+        int polls = 0;
+        bool stopped = false;
+        match(data_dir, [&]() {
+            std::lock_guard<std::mutex> guard(mutex);
+            CommandTokenScope scope(token);
+            ceres::IterationSummary iteration;
+            iteration.iteration = polls++;
+            for (ceres::IterationCallback* callback : o.callbacks) {
+                if (!stopped && (*callback)(iteration) != ceres::SOLVER_CONTINUE) {
+                    stopped = true;
+                }
+            }
+            return stopped;
+        });
+        summary->termination_type = stopped ? ceres::USER_SUCCESS : ceres::CONVERGENCE;
+        summary->num_residuals = static_cast<int>(terrain.size());
+        summary->total_time_in_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+}
+
+void ModelDense::match(const std::string& data_dir, const std::function<bool()>& cancelled) {
+    internal = parent->final_internal();
+    cameras = parent->final_external();
+    terrain.clear();
+    const obs_pair& edge = features->edges.at(0);
+    const unsigned long rows = static_cast<unsigned long>(features->data_set->rows);
+    const unsigned long cols = static_cast<unsigned long>(features->data_set->cols);
+    const Rectification rect(internal, cameras[edge.cam_a], cameras[edge.cam_b], rows, cols, scale);
+
+    // Disparity range of the parent's terrain, with a margin for relief it missed
+    double min_d = std::numeric_limits<double>::max(), max_d = 0;
+    for (auto& p : parent->final_terrain()) {
+        const double z = rect.depth(p);
+        if (z > 0) {
+            min_d = std::min(min_d, rect.focal * rect.baseline / z);
+            max_d = std::max(max_d, rect.focal * rect.baseline / z);
+        }
+    }
+    if (max_d <= 0) {
+        throw std::runtime_error("ModelDense: no parent terrain point in front of the cameras");
+    }
+    const double margin = std::max(8.0, 0.25 * (max_d - min_d));
+    sgm.min_disparity = static_cast<int>(std::floor(min_d - margin));
+    sgm.disparities = (static_cast<int>(std::ceil(max_d + margin)) - sgm.min_disparity + 15) / 16 * 16;
+    if (sgm.disparities > max_disparities) {
+        throw std::runtime_error("ModelDense: disparity range of " + std::to_string(sgm.disparities) +
+                                 " pixels is over max_disparities, lower the scale");
+    }
+    if (cancelled()) {
+        return;
+    }
+
+    cv::Mat left, right, mask_left, mask_right;
+    {
+        TRACE_SCOPE("rectify");
+        cv::Mat map_x, map_y;
+        rect.maps(internal, cameras[edge.cam_a], rows, cols, scale, map_x, map_y);
+        rectify(load_image(data_dir + "/" + features->data_set->filenames[edge.cam_a], scale), map_x, map_y, left, mask_left);
+        rect.maps(internal, cameras[edge.cam_b], rows, cols, scale, map_x, map_y);
+        rectify(load_image(data_dir + "/" + features->data_set->filenames[edge.cam_b], scale), map_x, map_y, right, mask_right);
+    }
+
+    SGMOptions options = sgm;
+    options.cancelled = cancelled;
+    vector<float> disparity = sgm_disparity(left.ptr<uint8_t>(), right.ptr<uint8_t>(), rect.rows, rect.cols, options);
+
+    // Strips that weren't matched are NaN, a cancelled solve keeps the others
+    TRACE_SCOPE("triangulate");
+    for (int r = 0; r < rect.rows; r++) {
+        for (int u = 0; u < rect.cols; u++) {
+            const float d = disparity[r * rect.cols + u];
+            if (!(d > 0)) {
+                continue; // Also NaN
+            }
+            const int u_right = static_cast<int>(std::lround(static_cast<double>(u) - static_cast<double>(d)));
+            if (!mask_left.at<uint8_t>(r, u) || u_right < 0 || !mask_right.at<uint8_t>(r, u_right)) {
+                continue;
+            }
+            terrain.push_back(rect.triangulate(r, u, static_cast<double>(d)));
+        }
+    }
+}
+
+internal_t ModelDense::final_internal() const {
+    return internal;
+}
+
+vector<array<double, 6>> ModelDense::final_external() const {
+    return cameras;
+}
+
+vector<array<double, 3>> ModelDense::final_terrain() const {
+    return terrain;
+}
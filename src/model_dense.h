@@ -0,0 +1,69 @@
+#ifndef MODEL_DENSE_H
+#define MODEL_DENSE_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <functional>
+#include <cereal/types/array.hpp>
+#include <cereal/types/string.hpp>
+#include "model.h"
+#include "internal.h"
+#include "sgm.h"
+
+using std::vector;
+using std::array;
+
+// Dense terrain of a solved camera pair, by semi-global matching
+// The images of the first edge's cameras are rectified at scale so that epipolar
+// lines are image rows, matched by sgm_disparity, and every pixel with a
+// consistent disparity is triangulated to a terrain point.
+// Cameras and internals are fixed from parent model, whose terrain bounds the
+// disparity search range. It reads the images, so it is solved by solve_with_images,
+// which stops between strips of the matching once cancelled or over its time budget.
+class ModelDense : public Model {
+public:
+    ModelDense() : scale(0.25), max_disparities(256) {}
+
+    virtual ModelDense* clone() override { return new ModelDense(*this); }
+    virtual ceres::Solver::Summary solve() override;
+    virtual ceres::Solver::Summary solve_with_images(const std::string& data_dir) override;
+
+    virtual bool bootstrapable () const override { return false; }
+
+    virtual internal_t final_internal() const override;
+    virtual vector<array<double, 6>> final_external() const override;
+    virtual vector<array<double, 3>> final_terrain() const override;
+
+    virtual std::shared_ptr<Model> get_parent() const override { return parent; }
+    virtual void set_parent(std::shared_ptr<Model> p) override { parent = p; }
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_nvp("base", cereal::base_class<Model>(this)),
+           cereal::make_nvp("scale", scale),
+           cereal::make_nvp("P1", sgm.P1),
+           cereal::make_nvp("P2", sgm.P2),
+           cereal::make_nvp("cameras", cameras),
+           cereal::make_nvp("internal", internal),
+           cereal::make_nvp("parent", parent),
+           cereal::make_nvp("terrain", terrain));
+    }
+
+    double scale; // Scale of the matched images
+    int max_disparities; // Bound of the disparity range, which sets the memory used
+    SGMOptions sgm; // The disparity range is set from the parent's terrain
+    vector<array<double, 6>> cameras;
+    internal_t internal;
+    vector<array<double, 3>> terrain;
+    std::shared_ptr<Model> parent;
+
+private:
+    // Rectify, match and triangulate the first edge's images into terrain
+    // Stops early, with the terrain of the strips matched so far, once cancelled() returns true
+    void match(const std::string& data_dir, const std::function<bool()>& cancelled);
+};
+
+CEREAL_REGISTER_TYPE(ModelDense);
+
+#endif
@@ -0,0 +1,198 @@
+#include <memory>
+#include <stdexcept>
+#include "model_multi.h"
+#include "trace.h"
+
+using std::set;
+
+vector<size_t> ModelMulti::edge_offsets() const {
+    vector<size_t> offsets(features->edges.size() + 1, 0);
+    for (size_t e = 0; e < features->edges.size(); e++) {
+        offsets[e + 1] = offsets[e] + features->edges[e].size();
+    }
+    return offsets;
+}
+
+size_t ModelMulti::extend(solution& sol) const {
+    const size_t first_new = sol.cameras.size();
+    const size_t count = features->data_set->filenames.size();
+
+    // New cameras start from solutions[0] if it has a guess for them,
+    // else from the pose of a camera they share an edge with
+    vector<bool> guessed(count, true);
+    for (size_t c = first_new; c < count; c++) {
+        if (c < solutions[0].cameras.size()) {
+            sol.cameras.push_back(solutions[0].cameras[c]);
+            continue;
+        }
+        bool found = false;
+        for (auto& edge : features->edges) {
+            size_t other = edge.cam_a == c ? edge.cam_b : (edge.cam_b == c ? edge.cam_a : c);
+            if (other < c) {
+                sol.cameras.push_back(sol.cameras[other]);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            throw std::runtime_error("ModelMulti: no initial pose for camera " + std::to_string(c));
+        }
+        guessed[c] = false;
+    }
+
+    // Down project the matches of new edges to z=0, through the cameras with a guess
+    const vector<size_t> offsets = edge_offsets();
+    sol.terrain.resize(offsets[solved_edges]);
+    for (size_t e = solved_edges; e < features->edges.size(); e++) {
+        const obs_pair& edge = features->edges[e];
+        const bool use[2] = {guessed[edge.cam_a] || !guessed[edge.cam_b],
+                             guessed[edge.cam_b] || !guessed[edge.cam_a]};
+        for (size_t i = 0; i < edge.size(); i++) {
+            double elevation = 0.0;
+            double x = 0.0, y = 0.0;
+            double n = 0.0;
+            for (int side = 0; side < 2; side++) {
+                if (!use[side]) {
+                    continue;
+                }
+                const size_t cam = side == 0 ? edge.cam_a : edge.cam_b;
+                const uint32_t k = side == 0 ? edge.index_a[i] : edge.index_b[i];
+                sensor_t sens = features->sensor(cam, k, pixel_size(internal));
+                double pix[2] = {sens.x, sens.y};
+                double dx, dy;
+                image_to_world(internal.data(), sol.cameras[cam].data(), pix, &elevation, &dx, &dy);
+                x += dx;
+                y += dy;
+                n += 1.0;
+            }
+            sol.terrain.push_back({x / n, y / n});
+        }
+    }
+    return first_new;
+}
+
+set<size_t> ModelMulti::add_edges(ceres::Problem& problem, Model0ReprojectionError::pool_type& pool,
+                                   solution& sol, const vector<size_t>& edges) const {
+    const vector<size_t> offsets = edge_offsets();
+    set<size_t> cameras;
+    for (size_t e : edges) {
+        const obs_pair& edge = features->edges[e];
+        for (size_t i = 0; i < edge.size(); i++) {
+            double* point = sol.terrain[offsets[e] + i].data();
+            sensor_t obs_a = features->sensor(edge.cam_a, edge.index_a[i], pixel_size(internal));
+            problem.AddResidualBlock(Model0ReprojectionError::make_pooled(pool, internal, obs_a), NULL,
+                                     sol.cameras[edge.cam_a].data(), point);
+            sensor_t obs_b = features->sensor(edge.cam_b, edge.index_b[i], pixel_size(internal));
+            problem.AddResidualBlock(Model0ReprojectionError::make_pooled(pool, internal, obs_b), NULL,
+                                     sol.cameras[edge.cam_b].data(), point);
+        }
+        cameras.insert(edge.cam_a);
+        cameras.insert(edge.cam_b);
+    }
+    return cameras;
+}
+
+ceres::Solver::Summary ModelMulti::solve() {
+    TRACE_SCOPE("model_multi_solve");
+    if (solutions.empty()) {
+        throw std::runtime_error("ModelMulti: no initial solution");
+    }
+    TraceScope setup_scope("model_multi_setup");
+    // From the initial guess the first time, then from the last solution
+    ModelMulti::solution working_solution(solutions.back());
+    extend(working_solution);
+    if (solutions.size() == 1) {
+        solutions[0] = working_solution;
+    }
+
+    vector<size_t> edges(features->edges.size());
+    for (size_t e = 0; e < edges.size(); e++) {
+        edges[e] = e;
+    }
+    Model0ReprojectionError::pool_type cost_functions;
+    cost_functions.reserve(2 * working_solution.terrain.size());
+    ceres::Problem problem(pooled_problem_options());
+    set<size_t> cameras = add_edges(problem, cost_functions, working_solution, edges);
+    if (cameras.count(0)) {
+        problem.SetParameterBlockConstant(working_solution.cameras[0].data());
+    }
+    setup_scope.end();
+
+    enable_logging(solutions, working_solution);
+    ceres::Solver::Summary summary = run_solver(options, problem);
+    solved_edges = features->edges.size();
+    return summary;
+}
+
+ceres::Solver::Summary ModelMulti::solve_incremental() {
+    if (!solved) {
+        return solve();
+    }
+    TRACE_SCOPE("model_multi_incremental");
+    TraceScope setup_scope("model_multi_setup");
+    ModelMulti::solution working_solution(solutions.back());
+    const size_t first_new = extend(working_solution);
+
+    // Window: new cameras and cameras of new edges, grown by window_rings
+    set<size_t> window;
+    for (size_t c = first_new; c < working_solution.cameras.size(); c++) {
+        window.insert(c);
+    }
+    for (size_t e = solved_edges; e < features->edges.size(); e++) {
+        window.insert(features->edges[e].cam_a);
+        window.insert(features->edges[e].cam_b);
+    }
+    for (size_t ring = 0; ring < window_rings; ring++) {
+        set<size_t> grown(window);
+        for (auto& edge : features->edges) {
+            if (window.count(edge.cam_a) || window.count(edge.cam_b)) {
+                grown.insert(edge.cam_a);
+                grown.insert(edge.cam_b);
+            }
+        }
+        window.swap(grown);
+    }
+
+    vector<size_t> edges;
+    for (size_t e = 0; e < features->edges.size(); e++) {
+        if (window.count(features->edges[e].cam_a) || window.count(features->edges[e].cam_b)) {
+            edges.push_back(e);
+        }
+    }
+
+    Model0ReprojectionError::pool_type cost_functions;
+    ceres::Problem problem(pooled_problem_options());
+    set<size_t> cameras = add_edges(problem, cost_functions, working_solution, edges);
+    for (size_t c : cameras) {
+        if (c == 0 || window.count(c) == 0) {
+            problem.SetParameterBlockConstant(working_solution.cameras[c].data());
+        }
+    }
+    setup_scope.end();
+
+    // Per iteration logging would copy the whole survey at every step
+    ceres::Solver::Options local_options(options);
+    local_options.callbacks.clear();
+    local_options.update_state_every_iteration = false;
+    ceres::Solver::Summary summary = run_solver(local_options, problem);
+    solutions.push_back(working_solution);
+    solved_edges = features->edges.size();
+    return summary;
+}
+
+internal_t ModelMulti::final_internal() const {
+    return internal;
+}
+
+vector<array<double, 6>> ModelMulti::final_external() const {
+    return solutions.back().cameras;
+}
+
+vector<array<double, 3>> ModelMulti::final_terrain() const {
+    const vector<array<double, 2>>& terrain = solutions.back().terrain;
+    vector<array<double, 3>> result(terrain.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        result[i] = array<double, 3> {terrain[i][0], terrain[i][1], 0.0};
+    }
+    return result;
+}
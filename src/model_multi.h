@@ -0,0 +1,105 @@
+#ifndef MODEL_MULTI_H
+#define MODEL_MULTI_H
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <set>
+#include "ceres/ceres.h"
+#include <cereal/types/array.hpp>
+#include "data_set.h"
+#include "image_features.h"
+#include "camera_models.h"
+#include "types.h"
+#include "model.h"
+#include "model0.h"
+#include "internal.h"
+
+using std::vector;
+using std::array;
+
+// Model0 over every edge of the features graph
+// One 6 dof camera per image of the data set, one 2 dof ground point (z=0)
+// per match of each edge, fixed internals. Camera 0 is held constant.
+//
+// Images and edges can be appended to a solved model: add them to the data set
+// and the features graph (and optionally initial camera guesses to solutions[0]),
+// then solve_incremental() registers them against the last solution by
+// optimizing only a local window, so its cost depends on the size of the change.
+// solve() always runs a global pass over everything.
+class ModelMulti : public Model {
+public:
+    struct solution {
+        vector<array<double, 6>> cameras; // 6 dof cameras
+        vector<array<double, 2>> terrain; // Ground points of all edges, in edge order
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(cereal::make_nvp("cameras", cameras),
+               cereal::make_nvp("terrain", terrain));
+        }
+
+        vector<double> flatten() const {
+            vector<double> flat;
+            append_flat(flat, cameras);
+            append_flat(flat, terrain);
+            return flat;
+        }
+
+        void unflatten(const vector<double>& flat) {
+            read_flat(read_flat(flat.begin(), cameras), terrain);
+        }
+    };
+
+    ModelMulti() : solved_edges(0), window_rings(1) {}
+
+    virtual ModelMulti* clone() override { return new ModelMulti(*this); }
+    virtual ceres::Solver::Summary solve() override;
+    // Local bundle adjustment of the cameras and edges added since the last solve
+    // The window holds the new cameras, the cameras of new edges, and the cameras
+    // within window_rings edges of them. Points of every edge touching the window
+    // are optimized, cameras outside of it are held constant, and edges outside
+    // of it are left out. Only the final solution is logged.
+    ceres::Solver::Summary solve_incremental();
+
+    virtual bool bootstrapable () const override { return false; }
+
+    virtual internal_t final_internal() const override;
+    virtual vector<array<double, 6>> final_external() const override;
+    virtual vector<array<double, 3>> final_terrain() const override;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_nvp("base", cereal::base_class<Model>(this)),
+           cereal::make_nvp("internal", internal),
+           cereal::make_nvp("solved_edges", solved_edges),
+           cereal::make_nvp("window_rings", window_rings),
+           cereal::make_nvp("solutions", make_history(solutions, history)));
+    }
+
+    internal_t internal;
+
+    // Number of edges of the features graph covered by the last solution
+    size_t solved_edges;
+    // Neighborhood of new cameras optimized by solve_incremental()
+    size_t window_rings;
+
+    // List of solutions, from the initial guess to local optimum
+    // Incremental solves append their result
+    vector<solution> solutions;
+
+private:
+    // Initial values of the cameras and edges missing from sol
+    // Returns the index of the first new camera
+    size_t extend(solution& sol) const;
+    // Add the residuals of edges to problem, with parameters in sol and cost functions in pool
+    // Returns the cameras the edges observe
+    std::set<size_t> add_edges(ceres::Problem& problem, Model0ReprojectionError::pool_type& pool,
+                               solution& sol, const vector<size_t>& edges) const;
+    // Index in solution::terrain of each edge's first point
+    vector<size_t> edge_offsets() const;
+};
+
+CEREAL_REGISTER_TYPE(ModelMulti);
+
+#endif
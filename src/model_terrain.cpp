@@ -1,21 +1,22 @@
 #include <memory>
 #include "model_terrain.h"
+#include "trace.h"
 
 // TODO also use in Model0
 // Inverse the features of a given features match at given elevation
 // Returns the average of the two ground points
-vector<array<double, 3>> inverse_features_average(const obs_pair& edge, const double elevation,
-        const double rows,
-        const double cols,
+vector<array<double, 3>> inverse_features_average(const FeaturesGraph& features,
+        const obs_pair& edge,
+        const double elevation,
         const internal_t& internal,
         const vector<array<double, 6>>& cameras) {
     
     vector<array<double, 3>> points;
     // For each observation
-    for (size_t i = 0; i < edge.obs_a.size(); i++) {
+    for (size_t i = 0; i < edge.size(); i++) {
         // Down project to elevation
-        sensor_t sens_a = edge.obs_a[i].to_sensor(pixel_size(internal), rows, cols);
-        sensor_t sens_b = edge.obs_b[i].to_sensor(pixel_size(internal), rows, cols);
+        sensor_t sens_a = features.sensor(edge.cam_a, edge.index_a[i], pixel_size(internal));
+        sensor_t sens_b = features.sensor(edge.cam_b, edge.index_b[i], pixel_size(internal));
 
         double dx_a, dy_a;
         double dx_b, dy_b;
@@ -31,24 +32,25 @@ vector<array<double, 3>> inverse_features_average(const obs_pair& edge, const do
 }
 
 ceres::Solver::Summary ModelTerrain::solve() {
+    TRACE_SCOPE("model_terrain_solve");
     if (!parent) {
         throw("Solving ModelTerrain but no parent provided.");
     }
 
-    ceres::Problem problem;
+    TraceScope setup_scope("model_terrain_setup");
+    // Cost functions live in the pool, which outlives the problem
+    ModelTerrainReprojectionError::pool_type cost_functions;
+    cost_functions.reserve(2 * features->edges[0].size());
+    ceres::Problem problem(pooled_problem_options());
     // Initialize cameras and internals from parent
     internal = parent->final_internal();
     cameras = parent->final_external();
 
-    const double rows = features->data_set->rows;
-    const double cols = features->data_set->cols;
-
     // Initialize solution[0].terrain by inversing features
     // For now only use two cams (= only edges[0])
-    solution sol{inverse_features_average(features->edges[0],
+    solution sol{inverse_features_average(*features,
+            features->edges[0],
             0.0, // initial elevation
-            rows,
-            cols,
             internal,
             cameras)};
     solutions.push_back(sol);
@@ -58,22 +60,22 @@ ceres::Solver::Summary ModelTerrain::solve() {
 
     // Setup parameter and residual blocks
     const obs_pair& edge = features->edges[0];
-    for (size_t i = 0; i < edge.obs_a.size(); i++) {
+    for (size_t i = 0; i < edge.size(); i++) {
         // Residual for left cam
-        sensor_t obs_left = edge.obs_a[i].to_sensor(pixel_size(internal), rows, cols);
-		ceres::CostFunction* cost_function_left = ModelTerrainReprojectionError::make(internal, cameras[edge.cam_a], obs_left);
+        sensor_t obs_left = features->sensor(edge.cam_a, edge.index_a[i], pixel_size(internal));
+		ceres::CostFunction* cost_function_left = ModelTerrainReprojectionError::make_pooled(cost_functions, internal, cameras[edge.cam_a], obs_left);
 		problem.AddResidualBlock(cost_function_left, NULL, working_solution.terrain[i].data());
 
         // Residual for right cam
-        sensor_t obs_right = edge.obs_b[i].to_sensor(pixel_size(internal), rows, cols);
-		ceres::CostFunction* cost_function_right = ModelTerrainReprojectionError::make(internal, cameras[edge.cam_b], obs_right);
+        sensor_t obs_right = features->sensor(edge.cam_b, edge.index_b[i], pixel_size(internal));
+		ceres::CostFunction* cost_function_right = ModelTerrainReprojectionError::make_pooled(cost_functions, internal, cameras[edge.cam_b], obs_right);
 		problem.AddResidualBlock(cost_function_right, NULL, working_solution.terrain[i].data());
     }
 
+    setup_scope.end();
+
     enable_logging(solutions, working_solution);
-    ceres::Solver::Summary summary;
-    ceres::Solve(options, &problem, &summary);
-    return summary;
+    return run_solver(options, problem);
 }
 
 internal_t ModelTerrain::final_internal() const {
@@ -19,18 +19,19 @@ using std::array;
 // Model only the terrain as 3D points
 // Cameras and internals are fixed from parent model
 
+// The internals and camera are shared with the model, not copied, and must outlive the cost function
 struct ModelTerrainReprojectionError : CostFunction<ModelTerrainReprojectionError, 2, 3> {
-    const internal_t internal;
-    const array<double, 6> external;
+    const double* internal;
+    const double* external;
     const sensor_t observed;
 
-	ModelTerrainReprojectionError(const internal_t internal, const array<double, 6> external , const sensor_t observed)
-		: internal(internal), external(external), observed(observed) {}
+	ModelTerrainReprojectionError(const internal_t& internal, const array<double, 6>& external, const sensor_t observed)
+		: internal(internal.data()), external(external.data()), observed(observed) {}
 
 	template <typename T>
 	bool operator()(const T* const point, T* residuals) const {
         // Subtract observed coordinates
-        bool r = pinhole_projection<T, double, double, T>(internal.data(), external.data(), point, residuals);
+        bool r = pinhole_projection<T, double, double, T>(internal, external, point, residuals);
         residuals[0] -= T(observed.x);
         residuals[1] -= T(observed.y);
         return r;
@@ -46,6 +47,16 @@ public:
         void serialize(Archive& ar) {
             ar(cereal::make_nvp("terrain", terrain));
         }
+
+        vector<double> flatten() const {
+            vector<double> flat;
+            append_flat(flat, terrain);
+            return flat;
+        }
+
+        void unflatten(const vector<double>& flat) {
+            read_flat(flat.begin(), terrain);
+        }
     };
 
     virtual ModelTerrain* clone() override { return new ModelTerrain(*this); }
@@ -57,13 +68,16 @@ public:
     virtual vector<array<double, 6>> final_external() const override;
     virtual vector<array<double, 3>> final_terrain() const override;
 
+    virtual std::shared_ptr<Model> get_parent() const override { return parent; }
+    virtual void set_parent(std::shared_ptr<Model> p) override { parent = p; }
+
     template <class Archive>
     void serialize(Archive& ar) {
         ar(cereal::make_nvp("base", cereal::base_class<Model>(this)),
            cereal::make_nvp("cameras", cameras),
            cereal::make_nvp("internal", internal),
            cereal::make_nvp("parent", parent),
-           cereal::make_nvp("solutions", solutions));
+           cereal::make_nvp("solutions", make_history(solutions, history)));
     }
 
     vector<array<double, 6>> cameras;
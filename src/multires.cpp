@@ -0,0 +1,97 @@
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include "multires.h"
+#include "trace.h"
+
+using std::vector;
+using std::string;
+
+match_predictor model0_predictor(const internal_t& internal, const Model0::solution& solution,
+                                 unsigned long rows, unsigned long cols) {
+    const array<double, 6> camera_a = solution.cameras.at(0);
+    const array<double, 6> camera_b = solution.cameras.at(1);
+    return [=](const pixel_t& a, pixel_t& b) {
+        sensor_t sens = a.to_sensor(pixel_size(internal), rows, cols);
+        double pix[2] = {sens.x, sens.y};
+        double elevation = 0.0;
+        double point[2];
+        image_to_world(internal.data(), camera_a.data(), pix, &elevation, &point[0], &point[1]);
+        double projected[2];
+        if (!model0_projection<double, double>(internal.data(), camera_b.data(), point, projected)
+                || !std::isfinite(projected[0]) || !std::isfinite(projected[1])) {
+            return false;
+        }
+        b = sensor_t(projected[0], projected[1]).to_pixel(pixel_size(internal), rows, cols);
+        return true;
+    };
+}
+
+// Compute features of a level and solve its model from init
+static MultiResLevel solve_level(Model0& model, const string& data_dir,
+                                 const Model0::solution& init, const Model0* previous,
+                                 const MultiResOptions& options) {
+    MultiResLevel level;
+    level.compute_scale = model.features->compute_scale;
+
+    auto start = std::chrono::steady_clock::now();
+    vector<match_predictor> predictors;
+    if (previous) {
+        const DataSet& data_set = *model.features->data_set;
+        predictors.push_back(model0_predictor(previous->internal, previous->solutions.back(),
+                                              data_set.rows, data_set.cols));
+    }
+    model.features->compute(data_dir, predictors, options.search_radius);
+    level.features_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    level.matches = model.features->edges[0].size();
+    if (level.matches == 0) {
+        throw std::runtime_error("No matches at compute scale " + std::to_string(level.compute_scale));
+    }
+
+    model.solutions.clear();
+    model.solutions.push_back(init);
+    model.solve();
+    level.record = model.solve_record;
+    return level;
+}
+
+vector<MultiResLevel> multires_solve(Model0& model, const string& data_dir, const MultiResOptions& options) {
+    TRACE_SCOPE("multires_solve");
+    if (!model.features || !model.features->data_set || model.features->edges.empty()) {
+        throw std::runtime_error("multires_solve: model has no features graph to compute");
+    }
+    if (model.solutions.empty()) {
+        throw std::runtime_error("multires_solve: model has no initial solution");
+    }
+
+    // Scales from coarse to fine, ending at the model's own
+    const double final_scale = model.features->compute_scale;
+    const unsigned long cols = model.features->data_set->cols;
+    vector<double> scales;
+    for (size_t k = options.levels; k-- > 1;) {
+        double scale = final_scale / std::pow(2.0, static_cast<double>(k));
+        if (cols * scale >= options.min_cols) {
+            scales.push_back(scale);
+        }
+    }
+    scales.push_back(final_scale);
+
+    vector<MultiResLevel> levels;
+    Model0::solution init = model.solutions.front();
+    std::unique_ptr<Model0> previous;
+    for (size_t l = 0; l + 1 < scales.size(); l++) {
+        // Intermediate level on its own copy of the features graph
+        std::unique_ptr<Model0> level(model.clone());
+        level->features.reset(new FeaturesGraph(*model.features));
+        level->features->compute_scale = scales[l];
+        level->features->clear_matches();
+        levels.push_back(solve_level(*level, data_dir, init, previous.get(), options));
+        init.cameras = level->final_external();
+        previous = std::move(level);
+    }
+
+    model.features->clear_matches();
+    levels.push_back(solve_level(model, data_dir, init, previous.get(), options));
+    return levels;
+}
@@ -0,0 +1,39 @@
+#ifndef MULTIRES_H
+#define MULTIRES_H
+
+#include <string>
+#include <vector>
+#include "model0.h"
+#include "solve_record.h"
+
+struct MultiResOptions {
+    MultiResOptions() : levels(3), search_radius(16.0), min_cols(512) {}
+
+    size_t levels; // Number of resolutions, each twice the previous one
+    double search_radius; // Guided matching radius, in pixels of the level's images
+    unsigned long min_cols; // Coarser levels are dropped below this image width
+};
+
+// One resolution of a multi-resolution solve
+struct MultiResLevel {
+    double compute_scale;
+    size_t matches;
+    double features_time; // Seconds
+    SolveRecord record;
+};
+
+// Coarse-to-fine solve of a Model0
+// Levels compute features at compute_scale / 2^k of the model's features graph.
+// The coarsest level is matched over whole images and solved from the model's
+// initial solution. Each finer level matches around the positions predicted by
+// the previous level's solution and starts its solve from it.
+// The last level is the model itself: its features are computed and it is solved,
+// intermediate levels are discarded.
+std::vector<MultiResLevel> multires_solve(Model0& model, const std::string& data_dir,
+                                          const MultiResOptions& options = MultiResOptions());
+
+// Maps pixels of the first to the second camera of a Model0 solution through the z=0 plane
+match_predictor model0_predictor(const internal_t& internal, const Model0::solution& solution,
+                                 unsigned long rows, unsigned long cols);
+
+#endif
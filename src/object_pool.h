@@ -0,0 +1,76 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+// Storage for many objects of one type, destroyed all at once with the pool
+// Objects are constructed in place in chunks of contiguous memory, so creating
+// n objects costs about n / chunk_size allocations instead of n.
+// Pointers to objects remain valid until the pool is destroyed.
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t chunk_size = 4096) : chunk_size(chunk_size > 0 ? chunk_size : 1), count(0) {}
+
+    ~ObjectPool() {
+        for (auto& c : chunks) {
+            for (size_t i = 0; i < c.used; i++) {
+                reinterpret_cast<T*>(&c.slots[i])->~T();
+            }
+        }
+    }
+
+    // Make room for n more objects in a single chunk
+    void reserve(size_t n) {
+        if (chunks.empty() || chunks.back().capacity - chunks.back().used < n) {
+            add_chunk(n);
+        }
+    }
+
+    template <typename... Args>
+    T* emplace(Args&&... args) {
+        if (chunks.empty() || chunks.back().used == chunks.back().capacity) {
+            add_chunk(chunk_size);
+        }
+        chunk& c = chunks.back();
+        T* object = new (&c.slots[c.used]) T(std::forward<Args>(args)...);
+        c.used++;
+        count++;
+        return object;
+    }
+
+    size_t size() const { return count; }
+
+    // Memory held by the chunks
+    size_t bytes() const {
+        size_t total = 0;
+        for (auto& c : chunks) {
+            total += c.capacity * sizeof(slot);
+        }
+        return total;
+    }
+
+private:
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    typedef typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type slot;
+    struct chunk {
+        std::unique_ptr<slot[]> slots;
+        size_t capacity;
+        size_t used;
+    };
+
+    void add_chunk(size_t capacity) {
+        chunks.push_back(chunk {std::unique_ptr<slot[]>(new slot[capacity]), capacity, 0});
+    }
+
+    size_t chunk_size;
+    size_t count;
+    std::vector<chunk> chunks;
+};
+
+#endif
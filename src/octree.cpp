@@ -0,0 +1,251 @@
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include <sys/stat.h>
+#include "octree.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+void encode_point(const CloudPoint& p, unsigned char* record) {
+    const double xyz[3] = {p.x, p.y, p.z};
+    for (size_t k = 0; k < 3; k++) {
+        uint64_t bits;
+        std::memcpy(&bits, &xyz[k], sizeof(bits));
+        for (size_t b = 0; b < 8; b++) {
+            record[8*k + b] = static_cast<unsigned char>(bits >> (8*b));
+        }
+    }
+    record[24] = p.r;
+    record[25] = p.g;
+    record[26] = p.b;
+}
+
+CloudPoint decode_point(const unsigned char* record) {
+    double xyz[3];
+    for (size_t k = 0; k < 3; k++) {
+        uint64_t bits = 0;
+        for (size_t b = 0; b < 8; b++) {
+            bits |= static_cast<uint64_t>(record[8*k + b]) << (8*b);
+        }
+        std::memcpy(&xyz[k], &bits, sizeof(bits));
+    }
+    return CloudPoint {xyz[0], xyz[1], xyz[2], record[24], record[25], record[26]};
+}
+
+PointFile::PointFile(const string& filename, size_t buffer_points, const string& header) :
+    filename(filename),
+    file(std::fopen(filename.c_str(), "wb")),
+    buffer_points(std::max<size_t>(buffer_points, 1)),
+    count(0) {
+    if (file == NULL) {
+        throw std::runtime_error("Can't open " + filename);
+    }
+    if (!header.empty() && std::fwrite(header.data(), 1, header.size(), file) != header.size()) {
+        throw std::runtime_error("Error writing " + filename);
+    }
+    buffer.reserve(this->buffer_points * cloud_point_record_size);
+}
+
+PointFile::~PointFile() {
+    if (file != NULL) {
+        std::fclose(file);
+    }
+}
+
+void PointFile::append(const CloudPoint& p) {
+    size_t offset = buffer.size();
+    buffer.resize(offset + cloud_point_record_size);
+    encode_point(p, &buffer[offset]);
+    count++;
+    if (buffer.size() >= buffer_points * cloud_point_record_size) {
+        if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            throw std::runtime_error("Error writing " + filename);
+        }
+        buffer.clear();
+    }
+}
+
+void PointFile::close() {
+    if (file == NULL) {
+        return;
+    }
+    if (!buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+        throw std::runtime_error("Error writing " + filename);
+    }
+    const bool closed = std::fclose(file) == 0;
+    file = NULL;
+    buffer = vector<unsigned char>();
+    if (!closed) {
+        throw std::runtime_error("Error writing " + filename);
+    }
+}
+
+PointFileReader::PointFileReader(const string& filename) :
+    filename(filename),
+    file(std::fopen(filename.c_str(), "rb")) {
+    if (file == NULL) {
+        throw std::runtime_error("Can't open " + filename);
+    }
+}
+
+PointFileReader::~PointFileReader() {
+    std::fclose(file);
+}
+
+bool PointFileReader::read(vector<CloudPoint>& chunk, size_t max_points) {
+    buffer.resize(max_points * cloud_point_record_size);
+    size_t n = std::fread(buffer.data(), cloud_point_record_size, max_points, file);
+    chunk.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        chunk[i] = decode_point(&buffer[i * cloud_point_record_size]);
+    }
+    return n > 0;
+}
+
+// Create a directory if it doesn't exist yet
+static const string& ensure_directory(const string& path) {
+    if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Can't create directory " + path);
+    }
+    return path;
+}
+
+OctreeBuilder::OctreeBuilder(const string& output_dir,
+                             const array<double, 3>& min_corner,
+                             const array<double, 3>& max_corner,
+                             const OctreeOptions& options) :
+    output_dir(ensure_directory(output_dir)),
+    min_corner(min_corner),
+    size(std::max(std::max(max_corner[0] - min_corner[0], max_corner[1] - min_corner[1]), max_corner[2] - min_corner[2])),
+    options(options),
+    root_input(staging("r"), options.memory_points / 4) {
+    // Avoid a degenerate cube for flat or single point clouds
+    if (size <= 0.0) {
+        size = 1.0;
+    }
+}
+
+string OctreeBuilder::staging(const string& name) const {
+    return output_dir + "/" + name + ".input";
+}
+
+void OctreeBuilder::add(const CloudPoint& p) {
+    root_input.append(p);
+}
+
+void OctreeBuilder::build() {
+    root_input.close();
+    built_nodes.clear();
+    process("r", min_corner, size, 0);
+    write_hierarchy();
+}
+
+void OctreeBuilder::process(const string& name, const array<double, 3>& corner, double node_size, size_t depth) {
+    const string input_name = staging(name);
+    const size_t chunk_points = std::max<size_t>(options.memory_points / 4, 1);
+
+    // Count input points, the staging file is a plain array of records
+    struct stat st;
+    if (::stat(input_name.c_str(), &st) != 0) {
+        throw std::runtime_error("Can't stat " + input_name);
+    }
+    const size_t input_points = static_cast<size_t>(st.st_size) / cloud_point_record_size;
+    const bool leaf = input_points <= options.node_capacity || depth >= options.max_depth;
+
+    PointFile output(output_dir + "/" + name + ".bin", chunk_points);
+    vector<std::unique_ptr<PointFile>> children(8);
+    std::unordered_set<uint64_t> occupied;
+    const double g = static_cast<double>(options.grid_resolution);
+    const double half = node_size / 2;
+
+    auto grid_cell = [&](double v, double origin) {
+        double c = std::floor((v - origin) / node_size * g);
+        return static_cast<uint64_t>(std::min(std::max(c, 0.0), g - 1));
+    };
+
+    {
+        PointFileReader input(input_name);
+        vector<CloudPoint> chunk;
+        while (input.read(chunk, chunk_points)) {
+            for (const CloudPoint& p : chunk) {
+                if (!leaf) {
+                    // Keep the first point of each grid cell at this level
+                    uint64_t key = (grid_cell(p.x, corner[0]) * options.grid_resolution
+                                  + grid_cell(p.y, corner[1])) * options.grid_resolution
+                                  + grid_cell(p.z, corner[2]);
+                    if (!occupied.insert(key).second) {
+                        size_t octant = (p.x >= corner[0] + half ? 4 : 0)
+                                      + (p.y >= corner[1] + half ? 2 : 0)
+                                      + (p.z >= corner[2] + half ? 1 : 0);
+                        if (!children[octant]) {
+                            children[octant].reset(new PointFile(staging(name + std::to_string(octant)),
+                                                                 chunk_points / 8));
+                        }
+                        children[octant]->append(p);
+                        continue;
+                    }
+                }
+                output.append(p);
+            }
+        }
+    }
+    output.close();
+    std::remove(input_name.c_str());
+    built_nodes.push_back(node_info {name, corner, node_size, output.size()});
+
+    // Release this level's memory before descending
+    occupied = std::unordered_set<uint64_t>();
+    for (auto& child : children) {
+        if (child) {
+            child->close();
+        }
+    }
+
+    for (size_t octant = 0; octant < 8; octant++) {
+        if (children[octant]) {
+            children[octant].reset();
+            array<double, 3> child_corner {
+                corner[0] + (octant & 4 ? half : 0.0),
+                corner[1] + (octant & 2 ? half : 0.0),
+                corner[2] + (octant & 1 ? half : 0.0)};
+            process(name + std::to_string(octant), child_corner, half, depth + 1);
+        }
+    }
+}
+
+void OctreeBuilder::write_hierarchy() const {
+    const string filename = output_dir + "/cloud.json";
+    std::ofstream ofs(filename);
+    if (!ofs.good()) {
+        throw std::runtime_error("Can't open " + filename);
+    }
+
+    size_t total = 0;
+    for (auto& node : built_nodes) {
+        total += node.points;
+    }
+
+    ofs << std::setprecision(17);
+    ofs << "{\n"
+        << "    \"format\": \"xyz-float64-rgb-uint8\",\n"
+        << "    \"points\": " << total << ",\n"
+        << "    \"min_corner\": [" << min_corner[0] << ", " << min_corner[1] << ", " << min_corner[2] << "],\n"
+        << "    \"size\": " << size << ",\n"
+        << "    \"spacing\": " << size / options.grid_resolution << ",\n"
+        << "    \"nodes\": [\n";
+    for (size_t n = 0; n < built_nodes.size(); n++) {
+        const node_info& node = built_nodes[n];
+        ofs << "        {\"name\": \"" << node.name << "\", \"points\": " << node.points << "}"
+            << (n + 1 < built_nodes.size() ? ",\n" : "\n");
+    }
+    ofs << "    ]\n}\n";
+}
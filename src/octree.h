@@ -0,0 +1,96 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdio>
+
+// A colored point as stored in point cloud files
+struct CloudPoint {
+    double x, y, z;
+    unsigned char r, g, b;
+};
+
+// Size of one point record on disk: 3 little endian doubles and 3 bytes
+const size_t cloud_point_record_size = 3*sizeof(double) + 3;
+
+void encode_point(const CloudPoint& p, unsigned char* record);
+CloudPoint decode_point(const unsigned char* record);
+
+// Append only binary file of point records with a bounded write buffer
+// The records follow an optional header written on opening
+class PointFile {
+public:
+    PointFile(const std::string& filename, size_t buffer_points, const std::string& header = std::string());
+    ~PointFile();
+    void append(const CloudPoint& p);
+    void close();
+    size_t size() const { return count; }
+private:
+    std::string filename;
+    std::FILE* file;
+    std::vector<unsigned char> buffer;
+    size_t buffer_points;
+    size_t count;
+};
+
+// Reads a point file chunk by chunk
+class PointFileReader {
+public:
+    PointFileReader(const std::string& filename);
+    ~PointFileReader();
+    // Returns false at the end of the file
+    bool read(std::vector<CloudPoint>& chunk, size_t max_points);
+private:
+    std::string filename;
+    std::FILE* file;
+    std::vector<unsigned char> buffer;
+};
+
+struct OctreeOptions {
+    OctreeOptions() : memory_points(1000000), node_capacity(20000), grid_resolution(64), max_depth(12) {}
+    size_t memory_points; // Maximum number of points held in memory at once
+    size_t node_capacity; // Nodes with fewer points are not subdivided
+    size_t grid_resolution; // Each level keeps at most one point per cell of this grid
+    size_t max_depth; // Leaves at this depth keep all their points
+};
+
+// Out of core level of detail octree builder
+// Points are first spilled to disk, then each node streams its input once,
+// keeping a grid subsample for itself and passing the rest down to its 8 children.
+// Node r is the root, r0 to r7 its children, r00 to r07 the children of r0, etc.
+// The output directory contains one <node>.bin point file per node and cloud.json
+class OctreeBuilder {
+public:
+    OctreeBuilder(const std::string& output_dir,
+                  const std::array<double, 3>& min_corner,
+                  const std::array<double, 3>& max_corner,
+                  const OctreeOptions& options = OctreeOptions());
+
+    void add(const CloudPoint& p);
+    // Process all added points, write the nodes and hierarchy
+    void build();
+
+    struct node_info {
+        std::string name;
+        std::array<double, 3> min_corner;
+        double size; // Edge length of the node cube
+        size_t points;
+    };
+    const std::vector<node_info>& nodes() const { return built_nodes; }
+
+private:
+    void process(const std::string& name, const std::array<double, 3>& min_corner, double size, size_t depth);
+    void write_hierarchy() const;
+    std::string staging(const std::string& name) const;
+
+    std::string output_dir;
+    std::array<double, 3> min_corner;
+    double size;
+    OctreeOptions options;
+    PointFile root_input;
+    std::vector<node_info> built_nodes;
+};
+
+#endif
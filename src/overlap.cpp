@@ -0,0 +1,145 @@
+#include <set>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "overlap.h"
+#include "inverted_index.h"
+#include "image_cache.h"
+#include "trace.h"
+
+using std::vector;
+using std::pair;
+using std::string;
+
+void Vocabulary::train(const cv::Mat& descriptors, int size) {
+    TRACE_SCOPE("vocabulary_train");
+    if (descriptors.rows < size) {
+        throw std::runtime_error("Not enough features to train a vocabulary of " + std::to_string(size) + " words");
+    }
+    cv::Mat data;
+    descriptors.convertTo(data, CV_32F);
+    cv::Mat labels;
+    cv::Mat centers;
+    cv::kmeans(data, size, labels, cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 20, 1.0),
+               1, cv::KMEANS_PP_CENTERS, centers);
+    set_words(centers);
+}
+
+void Vocabulary::set_words(const cv::Mat& w) {
+    words = w;
+    index = words.empty() ? cv::Ptr<cv::flann::Index>() : cv::makePtr<cv::flann::Index>(words, cv::flann::KDTreeIndexParams(4));
+}
+
+vector<int> Vocabulary::quantize(const cv::Mat& descriptors) const {
+    if (descriptors.empty()) {
+        return vector<int>();
+    }
+    cv::Mat data;
+    descriptors.convertTo(data, CV_32F);
+    cv::Mat indices, distances;
+    index->knnSearch(data, indices, distances, 1, cv::flann::SearchParams(32));
+    vector<int> result(indices.rows);
+    for (int i = 0; i < indices.rows; i++) {
+        result[i] = indices.at<int>(i, 0);
+    }
+    return result;
+}
+
+void update_overlap_index(OverlapIndex& index, const string& data_dir, const DataSet& data_set,
+                          const OverlapOptions& options) {
+    TRACE_SCOPE("update_overlap_index");
+    const vector<string>& filenames = data_set.filenames;
+    if (index.filenames.size() > filenames.size() ||
+        !std::equal(index.filenames.begin(), index.filenames.end(), filenames.begin())) {
+        index = OverlapIndex();
+    }
+    const size_t first = index.filenames.size();
+    const size_t n = filenames.size();
+    if (first == n) {
+        return;
+    }
+
+    // Strongest features of each new image
+    vector<cv::Mat> descriptors(n - first);
+    cv::Ptr<cv::xfeatures2d::SIFT> sift = cv::xfeatures2d::SIFT::create(options.features_per_image);
+    for (size_t i = first; i < n; i++) {
+        cv::Mat image = load_image(data_dir + "/" + filenames[i], options.scale);
+        vector<cv::KeyPoint> keypoints;
+        sift->detect(image, keypoints);
+        cv::KeyPointsFilter::retainBest(keypoints, options.features_per_image);
+        sift->compute(image, keypoints, descriptors[i - first]);
+    }
+
+    // Learn the vocabulary from a uniform sample of the features of the first images
+    if (index.vocabulary.size() == 0) {
+        vector<pair<size_t, int>> all;
+        for (size_t i = 0; i < descriptors.size(); i++) {
+            for (int r = 0; r < descriptors[i].rows; r++) {
+                all.push_back(std::make_pair(i, r));
+            }
+        }
+        std::mt19937 rng(0);
+        std::shuffle(all.begin(), all.end(), rng);
+        all.resize(std::min(all.size(), static_cast<size_t>(options.training_features)));
+        cv::Mat samples(static_cast<int>(all.size()), 128, CV_32F);
+        for (size_t s = 0; s < all.size(); s++) {
+            descriptors[all[s].first].row(all[s].second).convertTo(samples.row(static_cast<int>(s)), CV_32F);
+        }
+        index.vocabulary.train(samples, std::min(options.vocabulary_size, samples.rows));
+    }
+
+    for (size_t i = first; i < n; i++) {
+        index.filenames.push_back(filenames[i]);
+        index.image_words.push_back(index.vocabulary.quantize(descriptors[i - first]));
+    }
+}
+
+vector<pair<size_t, size_t>> query_overlaps(const OverlapIndex& index, const OverlapOptions& options) {
+    TRACE_SCOPE("query_overlaps");
+    // Weights depend on all the images, building the inverted index from the words is cheap
+    InvertedIndex inverted(static_cast<size_t>(index.vocabulary.size()));
+    for (auto& words : index.image_words) {
+        inverted.add(words);
+    }
+    inverted.finalize();
+
+    std::set<pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < inverted.size(); i++) {
+        for (auto& neighbor : inverted.query(i, options.neighbors)) {
+            if (neighbor.second >= options.min_score) {
+                pairs.insert(std::make_pair(std::min(i, neighbor.first), std::max(i, neighbor.first)));
+            }
+        }
+    }
+    return vector<pair<size_t, size_t>>(pairs.begin(), pairs.end());
+}
+
+vector<pair<size_t, size_t>> discover_overlaps(const string& data_dir, const DataSet& data_set,
+                                               const OverlapOptions& options) {
+    TRACE_SCOPE("discover_overlaps");
+    OverlapIndex index;
+    update_overlap_index(index, data_dir, data_set, options);
+    return query_overlaps(index, options);
+}
+
+void discover_edges(FeaturesGraph& features, const OverlapIndex& index, const OverlapOptions& options) {
+    if (!features.data_set) {
+        throw std::runtime_error("FeaturesGraph has no associated DataSet.");
+    }
+    if (index.filenames != features.data_set->filenames) {
+        throw std::runtime_error("Overlap index doesn't match the features graph's data set");
+    }
+    // The existing edges are kept if none are found
+    const vector<pair<size_t, size_t>> pairs = query_overlaps(index, options);
+    if (pairs.empty()) {
+        throw std::runtime_error("No overlapping image pairs found among " + std::to_string(features.data_set->filenames.size())
+                                 + " images, try a lower min_score");
+    }
+    features.clear_matches();
+    features.edges.clear();
+    features.computed = false;
+    for (auto& p : pairs) {
+        features.add_edge(p.first, p.second);
+    }
+}
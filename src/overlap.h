@@ -0,0 +1,90 @@
+#ifndef OVERLAP_H
+#define OVERLAP_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+#include "image_features.h"
+
+struct OverlapOptions {
+    OverlapOptions() : scale(0.125), features_per_image(1000), vocabulary_size(1000),
+                       training_features(50000), neighbors(4), min_score(0.05) {}
+
+    double scale; // Images are downscaled for retrieval
+    int features_per_image; // Strongest SIFT keypoints kept per image
+    int vocabulary_size; // Number of visual words
+    int training_features; // Sample of descriptors the vocabulary is learned from
+    size_t neighbors; // Proposed overlapping images per image
+    double min_score; // Minimum tf-idf cosine similarity of a proposed pair
+};
+
+// Visual words learned by k-means over SIFT descriptors
+class Vocabulary {
+public:
+    void train(const cv::Mat& descriptors, int size);
+    // Nearest word of each descriptor
+    std::vector<int> quantize(const cv::Mat& descriptors) const;
+    int size() const { return words.rows; }
+
+    // Words are saved as rows of floats, the search index is built again on load
+    template <class Archive>
+    void save(Archive& ar) const {
+        std::vector<float> data;
+        if (!words.empty()) {
+            data.assign(words.ptr<float>(), words.ptr<float>() + words.total());
+        }
+        ar(cereal::make_nvp("length", words.cols), cereal::make_nvp("words", data));
+    }
+
+    template <class Archive>
+    void load(Archive& ar) {
+        int length;
+        std::vector<float> data;
+        ar(cereal::make_nvp("length", length), cereal::make_nvp("words", data));
+        set_words(length > 0 ? cv::Mat(data, true).reshape(1, static_cast<int>(data.size()) / length) : cv::Mat());
+    }
+
+private:
+    void set_words(const cv::Mat& w);
+    cv::Mat words; // CV_32F, one word per row
+    cv::Ptr<cv::flann::Index> index;
+};
+
+// Visual words of the images of a data set, what image retrieval keeps between runs
+// A project saves it so that appended images are only described and quantized:
+// the vocabulary is learned once, from the images indexed first.
+struct OverlapIndex {
+    std::vector<std::string> filenames; // Indexed images, the first of the data set
+    std::vector<std::vector<int>> image_words; // Words of the features of each image
+    Vocabulary vocabulary;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(filenames), CEREAL_NVP(image_words), CEREAL_NVP(vocabulary));
+    }
+};
+
+// Describe and quantize the images of data_set that index doesn't have yet,
+// learning the vocabulary from them if it has none. An index whose images
+// aren't the first of data_set is rebuilt.
+void update_overlap_index(OverlapIndex& index, const std::string& data_dir, const DataSet& data_set,
+                          const OverlapOptions& options = OverlapOptions());
+
+// Proposes the pairs of indexed images (i < j) that are likely to overlap
+// Each image's top neighbors are retrieved from an inverted index of their
+// words, without matching all pairs
+std::vector<std::pair<size_t, size_t>> query_overlaps(const OverlapIndex& index,
+                                                      const OverlapOptions& options = OverlapOptions());
+
+// Same for all the images of a data set, without keeping the index
+std::vector<std::pair<size_t, size_t>> discover_overlaps(const std::string& data_dir, const DataSet& data_set,
+                                                         const OverlapOptions& options = OverlapOptions());
+
+// Replace the edges of a features graph by the overlaps of an index of its data set
+// Throws, leaving the graph unchanged, if no pair is found
+void discover_edges(FeaturesGraph& features, const OverlapIndex& index,
+                    const OverlapOptions& options = OverlapOptions());
+
+#endif
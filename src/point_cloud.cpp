@@ -0,0 +1,115 @@
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include "point_cloud.h"
+#include "camera_models.h"
+#include "types.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+bool colorize_point(const array<double, 3>& terrain,
+                    const internal_t& internal,
+                    const array<double, 6>& external,
+                    const cv::Mat& image,
+                    CloudPoint& point) {
+    double sensor[2];
+    pinhole_projection<double, double, double, double>(internal.data(), external.data(), terrain.data(), sensor);
+    pixel_t pix = sensor_t(sensor[0], sensor[1]).to_pixel(pixel_size(internal), image.rows, image.cols);
+
+    // Nearest neighbour interpolation, same as dtm.py
+    long i = std::lround(pix.i);
+    long j = std::lround(pix.j);
+    if (i < 0 || j < 0 || i >= image.rows || j >= image.cols) {
+        return false;
+    }
+    // OpenCV images are BGR
+    cv::Vec3b color = image.at<cv::Vec3b>(i, j);
+    point = CloudPoint {terrain[0], terrain[1], terrain[2], color[2], color[1], color[0]};
+    return true;
+}
+
+static string ply_header(size_t vertices) {
+    return "ply\n"
+           "format binary_little_endian 1.0\n"
+           "element vertex " + std::to_string(vertices) + "\n"
+           "property double x\n"
+           "property double y\n"
+           "property double z\n"
+           "property uchar red\n"
+           "property uchar green\n"
+           "property uchar blue\n"
+           "end_header\n";
+}
+
+// Point records are already in PLY vertex layout
+PlyWriter::PlyWriter(const string& filename, size_t vertices) :
+    vertices(vertices),
+    points(filename, 65536, ply_header(vertices)) {}
+
+void PlyWriter::close() {
+    points.close();
+    if (points.size() != vertices) {
+        throw std::runtime_error("PLY file has " + std::to_string(points.size()) +
+                                 " points but its header declares " + std::to_string(vertices));
+    }
+}
+
+void write_ply(const string& filename, const vector<CloudPoint>& points) {
+    PlyWriter ply(filename, points.size());
+    for (auto& p : points) {
+        ply.append(p);
+    }
+    ply.close();
+}
+
+CloudExportStats export_terrain_cloud(const vector<array<double, 3>>& terrain,
+                                     const internal_t& internal,
+                                     const array<double, 6>& external,
+                                     const cv::Mat& image,
+                                     const string& ply_filename,
+                                     const string& octree_dir,
+                                     const OctreeOptions& options) {
+    // Count and bounds of the points inside the image
+    CloudExportStats stats {0, 0};
+    array<double, 3> low {{0, 0, 0}}, high {{0, 0, 0}};
+    CloudPoint p;
+    for (auto& t : terrain) {
+        if (!colorize_point(t, internal, external, image, p)) {
+            stats.dropped++;
+            continue;
+        }
+        if (stats.written == 0) {
+            low = high = t;
+        }
+        low = {{std::min(low[0], p.x), std::min(low[1], p.y), std::min(low[2], p.z)}};
+        high = {{std::max(high[0], p.x), std::max(high[1], p.y), std::max(high[2], p.z)}};
+        stats.written++;
+    }
+
+    std::unique_ptr<OctreeBuilder> builder;
+    if (!octree_dir.empty()) {
+        if (stats.written == 0) {
+            throw std::runtime_error("Cannot build octree of an empty point cloud.");
+        }
+        builder.reset(new OctreeBuilder(octree_dir, low, high, options));
+    }
+
+    PlyWriter ply(ply_filename, stats.written);
+    for (auto& t : terrain) {
+        if (colorize_point(t, internal, external, image, p)) {
+            ply.append(p);
+            if (builder) {
+                builder->add(p);
+            }
+        }
+    }
+    ply.close();
+    if (builder) {
+        builder->build();
+    }
+    return stats;
+}
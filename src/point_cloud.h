@@ -0,0 +1,52 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "internal.h"
+#include "octree.h"
+
+// Color of a terrain point from the nearest pixel of its projection in an image
+// Returns false for points that project outside of the image
+bool colorize_point(const std::array<double, 3>& terrain,
+                    const internal_t& internal,
+                    const std::array<double, 6>& external,
+                    const cv::Mat& image,
+                    CloudPoint& point);
+
+// Binary little endian PLY file with double coordinates and uchar colors
+// The vertex count is written in the header, so must be known up front
+class PlyWriter {
+public:
+    PlyWriter(const std::string& filename, size_t vertices);
+    void append(const CloudPoint& p) { points.append(p); }
+    // Throws if the number of appended points isn't the header's vertex count
+    void close();
+private:
+    size_t vertices;
+    PointFile points;
+};
+
+// Write a vector of points with PlyWriter
+void write_ply(const std::string& filename, const std::vector<CloudPoint>& points);
+
+struct CloudExportStats {
+    size_t written; // Points in the PLY file and the octree
+    size_t dropped; // Points projecting outside of the image
+};
+
+// Color terrain points from an image and stream them to a PLY file and, if
+// octree_dir isn't empty, to a level of detail octree
+// Colored points are never held in memory: a first pass computes the count and
+// bounds, a second colors them again and streams them to both outputs.
+CloudExportStats export_terrain_cloud(const std::vector<std::array<double, 3>>& terrain,
+                                     const internal_t& internal,
+                                     const std::array<double, 6>& external,
+                                     const cv::Mat& image,
+                                     const std::string& ply_filename,
+                                     const std::string& octree_dir,
+                                     const OctreeOptions& options = OctreeOptions());
+
+#endif
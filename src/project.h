@@ -2,7 +2,14 @@
 #define PROJECT_H
 
 #include <memory>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
 #include <cereal/archives/json.hpp>
+#include <cereal/archives/portable_binary.hpp>
 #include <cereal/types/vector.hpp>
 #include <cereal/types/array.hpp>
 #include <cereal/types/memory.hpp>
@@ -10,6 +17,8 @@
 #include "image_features.h"
 #include "model.h"
 #include "bootstrap.h"
+#include "trace.h"
+#include "project_format.h"
 
 // Overload std::array for JSON to use []
 namespace cereal {
@@ -34,28 +43,127 @@ namespace cereal {
     }
 }
 
+// Binary project files start with this, followed by a cereal portable binary archive
+// of the format version and the object
+const char project_binary_magic[] = "GEOSOLVE-BINARY-1";
+
+// True if filename has the binary project extension
+inline bool is_binary_project_name(const std::string& filename) {
+    const std::string ext(".bin");
+    return filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// Write a file through a temporary that is renamed over it on success
+// so readers never see a partially written file
+inline void atomic_write(const std::string& filename, std::ios::openmode mode,
+                         const std::function<void (std::ostream&)>& write) {
+    const std::string tmp = filename + ".tmp";
+    {
+        std::ofstream ofs(tmp, mode);
+        if (!ofs.good()) {
+            throw std::runtime_error("Can't open " + tmp);
+        }
+        write(ofs);
+        // Closing flushes the last buffer, which can fail too
+        ofs.close();
+        if (ofs.fail()) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Error writing " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Can't rename " + tmp + " to " + filename);
+    }
+}
+
+// Save or load an object in the format chosen by file name (see Project::to_file)
+// The object's members are written at the root of the archive
+template <typename T>
+void save_object(const std::string& filename, T& object) {
+    TRACE_SCOPE("serialize_save");
+    if (is_binary_project_name(filename)) {
+        atomic_write(filename, std::ios::binary, [&](std::ostream& os) {
+            os.write(project_binary_magic, sizeof(project_binary_magic));
+            cereal::PortableBinaryOutputArchive ar(os);
+            std::uint32_t version = project_format_version;
+            ar(version);
+            object.serialize(ar);
+        });
+    } else {
+        atomic_write(filename, std::ios::out, [&](std::ostream& os) {
+            cereal::JSONOutputArchive ar(os);
+            std::uint32_t version = project_format_version;
+            ar(cereal::make_nvp("format_version", version));
+            object.serialize(ar);
+        });
+    }
+}
+
+inline void check_format_version(std::uint32_t version, const std::string& filename) {
+    if (version > project_format_version) {
+        throw std::runtime_error(filename + " has project format version " + std::to_string(version) +
+                                 ", newer than this build's " + std::to_string(project_format_version));
+    }
+}
+
+template <typename T>
+void load_object(const std::string& filename, T& object) {
+    TRACE_SCOPE("serialize_load");
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs.good()) {
+        throw std::runtime_error("Can't open " + filename);
+    }
+
+    char magic[sizeof(project_binary_magic)] = {0};
+    ifs.read(magic, sizeof(magic));
+    if (ifs.gcount() == sizeof(magic) && std::memcmp(magic, project_binary_magic, sizeof(magic)) == 0) {
+        cereal::PortableBinaryInputArchive ar(ifs);
+        std::uint32_t version;
+        ar(version);
+        check_format_version(version, filename);
+        ArchiveVersionScope scope(version);
+        object.serialize(ar);
+    } else {
+        ifs.clear();
+        ifs.seekg(0);
+        const bool versioned = json_has_format_version(ifs);
+        ifs.clear();
+        ifs.seekg(0);
+        cereal::JSONInputArchive ar(ifs);
+        // Files of the original format have no version
+        std::uint32_t version = 0;
+        if (versioned) {
+            ar(cereal::make_nvp("format_version", version));
+            check_format_version(version, filename);
+        }
+        ArchiveVersionScope scope(version);
+        object.serialize(ar);
+    }
+}
+
 struct Project {
     std::shared_ptr<DataSet> data_set;
     std::vector<std::shared_ptr<FeaturesGraph>> features_list;
     std::vector<std::shared_ptr<Model>> models;
     std::vector<std::shared_ptr<Bootstrap>> bootstraps;
 
+    // Format is detected from the magic bytes, JSON otherwise
     static Project from_file(const std::string& filename) {
         Project p;
-        std::ifstream ifs(filename);
-        if (!ifs.good()) {
-            throw std::runtime_error("Can't open " + filename);
-        }
-        cereal::JSONInputArchive ar(ifs);
-        p.serialize(ar);
+        load_object(filename, p);
         return p;
     }
 
+    // Format is chosen by extension: binary for .bin, JSON otherwise
     void to_file(const std::string& filename) {
-        // TODO this silently fails if directory doesn't exist
-        std::ofstream ofs(filename);
-        cereal::JSONOutputArchive ar(ofs);
-        this->serialize(ar);
+        save_object(filename, *this);
+    }
+
+    // Whether both projects serialize to the same bytes, such as a project and
+    // the copy read back from a converted file
+    bool same_content(Project& other) {
+        return content() == other.content();
     }
 
     template <class Archive>
@@ -65,6 +173,16 @@ struct Project {
            NVP(models),
            NVP(bootstraps));
     }
+
+private:
+    std::string content() {
+        std::ostringstream os(std::ios::binary);
+        {
+            cereal::PortableBinaryOutputArchive ar(os);
+            serialize(ar);
+        }
+        return os.str();
+    }
 };
 
 #endif
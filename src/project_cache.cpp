@@ -0,0 +1,84 @@
+#include <sys/stat.h>
+#include "project_cache.h"
+
+using std::string;
+using std::shared_ptr;
+
+// Modification time and size of the file describing the project
+// Changes whenever the project is written, by us or someone else
+static string project_stamp(const string& project_dir) {
+    const string candidates[] = {
+        project_dir + "/sections/manifest.json",
+        project_dir + "/project.bin",
+        project_dir + "/project.json"};
+    for (const string& file : candidates) {
+        struct stat st;
+        if (::stat(file.c_str(), &st) == 0) {
+            return file + ":" + std::to_string(st.st_size)
+                        + ":" + std::to_string(st.st_mtim.tv_sec)
+                        + "." + std::to_string(st.st_mtim.tv_nsec);
+        }
+    }
+    return string();
+}
+
+ProjectCache& ProjectCache::instance() {
+    static ProjectCache cache;
+    return cache;
+}
+
+void ProjectCache::enable() {
+    std::lock_guard<std::mutex> guard(mutex);
+    enabled = true;
+}
+
+ProjectCache::entry& ProjectCache::get(const string& project_dir) {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::unique_ptr<entry>& e = entries[project_dir];
+    if (!e) {
+        e.reset(new entry());
+    }
+    return *e;
+}
+
+std::unique_lock<std::mutex> ProjectCache::lock(const string& project_dir) {
+    return std::unique_lock<std::mutex>(get(project_dir).lock);
+}
+
+shared_ptr<ProjectStore> ProjectCache::open(const string& project_dir) {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!enabled) {
+            return shared_ptr<ProjectStore>(new ProjectStore(project_dir));
+        }
+    }
+
+    // The caller holds the project lock
+    entry& e = get(project_dir);
+    if (!e.store || e.stamp != project_stamp(project_dir)) {
+        e.store.reset(new ProjectStore(project_dir));
+        e.stamp = project_stamp(project_dir);
+    }
+    e.used = true;
+    return e.store;
+}
+
+void ProjectCache::invalidate(const string& project_dir) {
+    entry& e = get(project_dir);
+    e.store.reset();
+    e.used = false;
+}
+
+void ProjectCache::release(const string& project_dir, bool success) {
+    entry& e = get(project_dir);
+    if (success && e.used) {
+        // Our own writes don't invalidate the cache
+        e.stamp = project_stamp(project_dir);
+    } else {
+        // Failed requests may leave the project half modified,
+        // and requests that didn't open it may have rewritten it
+        e.store.reset();
+        e.stamp.clear();
+    }
+    e.used = false;
+}
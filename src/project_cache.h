@@ -0,0 +1,54 @@
+#ifndef PROJECT_CACHE_H
+#define PROJECT_CACHE_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "project_store.h"
+
+// Keeps opened projects resident between requests of the geosolve server
+// A cached project is reused as long as its files are unchanged on disk
+class ProjectCache {
+public:
+    static ProjectCache& instance();
+
+    // Caching is off by default, every open reads the project from disk
+    void enable();
+
+    // Serialize requests on the same project
+    std::unique_lock<std::mutex> lock(const std::string& project_dir);
+
+    // The project in project_dir, from the cache if possible
+    std::shared_ptr<ProjectStore> open(const std::string& project_dir);
+
+    // End of a request holding the project lock
+    // Keeps the project for the next request if it succeeded, forgets it otherwise
+    void release(const std::string& project_dir, bool success);
+
+    // Forget a project whose layout or format was changed by the current request
+    void invalidate(const std::string& project_dir);
+
+private:
+    ProjectCache() : enabled(false) {}
+
+    struct entry {
+        entry() : used(false) {}
+        std::mutex lock; // Held for the duration of a request
+        std::shared_ptr<ProjectStore> store;
+        std::string stamp; // State of the project files when cached
+        bool used; // Opened during the current request
+    };
+    entry& get(const std::string& project_dir);
+
+    std::mutex mutex; // Protects entries and enabled
+    std::map<std::string, std::unique_ptr<entry>> entries;
+    bool enabled;
+};
+
+// Convenience for ProjectCache::instance().open()
+inline std::shared_ptr<ProjectStore> open_project(const std::string& project_dir) {
+    return ProjectCache::instance().open(project_dir);
+}
+
+#endif
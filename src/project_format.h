@@ -0,0 +1,53 @@
+#ifndef PROJECT_FORMAT_H
+#define PROJECT_FORMAT_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+
+// Version of the project file format
+// Files record the version they were written with: a "format_version" member at
+// the root of JSON files, a uint32 following the magic of binary files.
+// JSON files without one are version 0, the original format: solutions are a plain
+// array, and there are no solve records or descriptor compressors.
+const std::uint32_t project_format_version = 1;
+
+// Format version of the archive being loaded by this thread, project_format_version otherwise
+// serialize() functions skip the members that older versions don't have.
+inline std::uint32_t& archive_version() {
+    static thread_local std::uint32_t version = project_format_version;
+    return version;
+}
+
+// Sets the version of the archive being loaded for the scope's lifetime
+class ArchiveVersionScope {
+public:
+    explicit ArchiveVersionScope(std::uint32_t version) : saved(archive_version()) {
+        archive_version() = version;
+    }
+    ~ArchiveVersionScope() {
+        archive_version() = saved;
+    }
+private:
+    ArchiveVersionScope(const ArchiveVersionScope&) = delete;
+    ArchiveVersionScope& operator=(const ArchiveVersionScope&) = delete;
+    std::uint32_t saved;
+};
+
+// True if the JSON document starts with a "format_version" member, as saved
+// by save_object. Reads from the current position of is.
+inline bool json_has_format_version(std::istream& is) {
+    const std::string member("\"format_version\"");
+    char c;
+    if (!(is >> c) || c != '{' || !(is >> c) || c != member[0]) {
+        return false;
+    }
+    for (size_t i = 1; i < member.size(); i++) {
+        if (is.get() != member[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
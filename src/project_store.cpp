@@ -0,0 +1,341 @@
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "project_store.h"
+
+using std::vector;
+using std::string;
+using std::shared_ptr;
+
+namespace {
+
+// Clears a reference while its owner is serialized in its own section
+template <typename T>
+class detach {
+    shared_ptr<T>& ref;
+    shared_ptr<T> saved;
+public:
+    explicit detach(shared_ptr<T>& r) : ref(r), saved(r) { ref.reset(); }
+    ~detach() { ref = saved; }
+};
+
+// Same for a model's parent, which is only reachable through virtual accessors
+class detach_parent {
+    Model& model;
+    shared_ptr<Model> saved;
+public:
+    explicit detach_parent(Model& m) : model(m), saved(m.get_parent()) { model.set_parent(nullptr); }
+    ~detach_parent() { model.set_parent(saved); }
+};
+
+// Models are polymorphic and must be serialized through a pointer
+struct model_section {
+    shared_ptr<Model> model;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(NVP(model));
+    }
+};
+
+// Position of an object in one of the project lists, -1 for null
+template <typename T, typename U>
+long index_of(const vector<shared_ptr<T>>& list, const shared_ptr<U>& object) {
+    if (!object) {
+        return -1;
+    }
+    auto it = std::find(list.begin(), list.end(), object);
+    if (it == list.end()) {
+        throw std::runtime_error("Referenced object is not part of the project.");
+    }
+    return it - list.begin();
+}
+
+}
+
+ProjectStore::ProjectStore() : is_sectioned(true), dirty_data_set(false), dirty(true) {
+}
+
+ProjectStore::ProjectStore(const string& project_dir) :
+    project_dir(project_dir),
+    dirty_data_set(false),
+    dirty(false) {
+    const string manifest_file = section_path("manifest.json");
+    is_sectioned = std::ifstream(manifest_file).good();
+
+    if (is_sectioned) {
+        load_object(manifest_file, manifest);
+        project_data.features_list.resize(manifest.features.size());
+        project_data.models.resize(manifest.models.size());
+        project_data.bootstraps.resize(manifest.bootstraps.size());
+    } else {
+        project_data = Project::from_file(filename());
+    }
+    dirty_features.assign(features_count(), false);
+    dirty_models.assign(models_count(), false);
+    dirty_bootstraps.assign(bootstraps_count(), false);
+}
+
+void ProjectStore::split(const string& project_dir, Project& project) {
+    ProjectStore store;
+    store.project_dir = project_dir;
+    store.project_data.data_set = project.data_set;
+    store.manifest.data_set = "data_set.json";
+    for (auto& features : project.features_list) {
+        store.add(features);
+    }
+    for (auto& model : project.models) {
+        store.add(model);
+    }
+    for (auto& bootstrap : project.bootstraps) {
+        store.add(bootstrap);
+    }
+
+    const string dir = project_dir + "/sections";
+    if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Can't create directory " + dir);
+    }
+    save_object(store.section_path(store.manifest.data_set), *store.project_data.data_set);
+    store.commit();
+}
+
+void ProjectStore::join(const string& project_dir) {
+    ProjectStore store(project_dir);
+    if (!store.sectioned()) {
+        throw std::runtime_error("Project in " + project_dir + " is not sectioned.");
+    }
+    const string joined = project_dir + "/project.json";
+    store.project().to_file(joined);
+
+    // Read the file back before removing the sections, to_file throws if writing failed
+    Project check = Project::from_file(joined);
+    if (!check.same_content(store.project())) {
+        throw std::runtime_error("Joined " + joined + " doesn't match the sections, keeping them");
+    }
+
+    // Remove the sections now that the single file has been written
+    std::remove(store.section_path(store.manifest.data_set).c_str());
+    for (auto& e : store.manifest.features) std::remove(store.section_path(e.file).c_str());
+    for (auto& e : store.manifest.models) std::remove(store.section_path(e.file).c_str());
+    for (auto& e : store.manifest.bootstraps) std::remove(store.section_path(e.file).c_str());
+    std::remove(store.section_path("manifest.json").c_str());
+    ::rmdir((project_dir + "/sections").c_str());
+}
+
+string ProjectStore::filename() const {
+    string binary = project_dir + "/project.bin";
+    if (std::ifstream(binary).good()) {
+        return binary;
+    }
+    return project_dir + "/project.json";
+}
+
+string ProjectStore::section_path(const string& file) const {
+    return project_dir + "/sections/" + file;
+}
+
+shared_ptr<DataSet> ProjectStore::data_set() {
+    if (!project_data.data_set) {
+        shared_ptr<DataSet> ds(new DataSet());
+        load_object(section_path(manifest.data_set), *ds);
+        project_data.data_set = ds;
+    }
+    return project_data.data_set;
+}
+
+void ProjectStore::append_images(const vector<string>& filenames) {
+    shared_ptr<DataSet> ds = data_set();
+    ds->filenames.insert(ds->filenames.end(), filenames.begin(), filenames.end());
+    dirty_data_set = true;
+    dirty = true;
+}
+
+bool ProjectStore::features_computed(size_t i) const {
+    if (project_data.features_list.at(i)) {
+        return project_data.features_list[i]->computed;
+    }
+    return manifest.features.at(i).computed;
+}
+
+shared_ptr<FeaturesGraph> ProjectStore::features(size_t i) {
+    shared_ptr<FeaturesGraph>& slot = project_data.features_list.at(i);
+    if (!slot) {
+        shared_ptr<FeaturesGraph> features(new FeaturesGraph());
+        load_object(section_path(manifest.features.at(i).file), *features);
+        features->data_set = data_set();
+        slot = features;
+    }
+    return slot;
+}
+
+bool ProjectStore::model_solved(size_t i) const {
+    if (project_data.models.at(i)) {
+        return project_data.models[i]->solved;
+    }
+    return manifest.models.at(i).solved;
+}
+
+bool ProjectStore::model_bootstrapable(size_t i) const {
+    if (project_data.models.at(i)) {
+        return project_data.models[i]->bootstrapable();
+    }
+    return manifest.models.at(i).bootstrapable;
+}
+
+shared_ptr<Model> ProjectStore::model(size_t i) {
+    shared_ptr<Model>& slot = project_data.models.at(i);
+    if (!slot) {
+        const ProjectManifest::model_entry& entry = manifest.models.at(i);
+        model_section section;
+        load_object(section_path(entry.file), section);
+        if (!section.model) {
+            throw std::runtime_error("Empty model section " + entry.file);
+        }
+        if (entry.features >= 0) {
+            section.model->features = features(entry.features);
+        }
+        if (entry.parent >= 0) {
+            section.model->set_parent(model(entry.parent));
+        }
+        slot = section.model;
+    }
+    return slot;
+}
+
+long ProjectStore::bootstrap_base_model(size_t i) const {
+    if (project_data.bootstraps.at(i)) {
+        return index_of(project_data.models, project_data.bootstraps[i]->base_model);
+    }
+    return manifest.bootstraps.at(i).base_model;
+}
+
+shared_ptr<Bootstrap> ProjectStore::bootstrap(size_t i) {
+    shared_ptr<Bootstrap>& slot = project_data.bootstraps.at(i);
+    if (!slot) {
+        const ProjectManifest::bootstrap_entry& entry = manifest.bootstraps.at(i);
+        shared_ptr<Bootstrap> boot(new Bootstrap());
+        load_object(section_path(entry.file), *boot);
+        if (entry.base_model >= 0) {
+            boot->base_model = model(entry.base_model);
+        }
+        slot = boot;
+    }
+    return slot;
+}
+
+Project& ProjectStore::project() {
+    if (is_sectioned) {
+        data_set();
+        for (size_t i = 0; i < features_count(); i++) features(i);
+        for (size_t i = 0; i < models_count(); i++) model(i);
+        for (size_t i = 0; i < bootstraps_count(); i++) bootstrap(i);
+    }
+    return project_data;
+}
+
+void ProjectStore::add(shared_ptr<FeaturesGraph> features) {
+    const size_t i = features_count();
+    project_data.features_list.push_back(features);
+    dirty_features.push_back(true);
+    manifest.features.push_back(ProjectManifest::features_entry {"features" + std::to_string(i) + ".bin", features->computed});
+    dirty = true;
+}
+
+void ProjectStore::add(shared_ptr<Model> model) {
+    const size_t i = models_count();
+    project_data.models.push_back(model);
+    dirty_models.push_back(true);
+    manifest.models.push_back(ProjectManifest::model_entry {"model" + std::to_string(i) + ".bin", -1, -1, model->solved, model->bootstrapable()});
+    dirty = true;
+}
+
+void ProjectStore::add(shared_ptr<Bootstrap> bootstrap) {
+    const size_t i = bootstraps_count();
+    project_data.bootstraps.push_back(bootstrap);
+    dirty_bootstraps.push_back(true);
+    manifest.bootstraps.push_back(ProjectManifest::bootstrap_entry {"bootstrap" + std::to_string(i) + ".bin", -1});
+    dirty = true;
+}
+
+void ProjectStore::touch(const shared_ptr<FeaturesGraph>& features) {
+    dirty_features[index_of(project_data.features_list, features)] = true;
+    dirty = true;
+}
+
+void ProjectStore::touch(const shared_ptr<Model>& model) {
+    dirty_models[index_of(project_data.models, model)] = true;
+    dirty = true;
+}
+
+void ProjectStore::touch(const shared_ptr<Bootstrap>& bootstrap) {
+    dirty_bootstraps[index_of(project_data.bootstraps, bootstrap)] = true;
+    dirty = true;
+}
+
+void ProjectStore::save_features(size_t i) {
+    FeaturesGraph& features = *project_data.features_list[i];
+    ProjectManifest::features_entry& entry = manifest.features[i];
+    entry.computed = features.computed;
+
+    detach<DataSet> d(features.data_set);
+    save_object(section_path(entry.file), features);
+}
+
+void ProjectStore::save_model(size_t i) {
+    shared_ptr<Model>& model = project_data.models[i];
+    ProjectManifest::model_entry& entry = manifest.models[i];
+    entry.features = index_of(project_data.features_list, model->features);
+    entry.parent = index_of(project_data.models, model->get_parent());
+    entry.solved = model->solved;
+    entry.bootstrapable = model->bootstrapable();
+
+    detach<FeaturesGraph> d(model->features);
+    detach_parent p(*model);
+    model_section section {model};
+    save_object(section_path(entry.file), section);
+}
+
+void ProjectStore::save_bootstrap(size_t i) {
+    Bootstrap& boot = *project_data.bootstraps[i];
+    ProjectManifest::bootstrap_entry& entry = manifest.bootstraps[i];
+    entry.base_model = index_of(project_data.models, boot.base_model);
+
+    detach<Model> d(boot.base_model);
+    save_object(section_path(entry.file), boot);
+}
+
+void ProjectStore::commit() {
+    if (!dirty) {
+        return;
+    }
+    if (!is_sectioned) {
+        project_data.to_file(filename());
+        dirty_data_set = false;
+        dirty = false;
+        return;
+    }
+
+    if (dirty_data_set) {
+        save_object(section_path(manifest.data_set), *project_data.data_set);
+    }
+    for (size_t i = 0; i < features_count(); i++) {
+        if (dirty_features[i]) save_features(i);
+    }
+    for (size_t i = 0; i < models_count(); i++) {
+        if (dirty_models[i]) save_model(i);
+    }
+    for (size_t i = 0; i < bootstraps_count(); i++) {
+        if (dirty_bootstraps[i]) save_bootstrap(i);
+    }
+
+    // The manifest goes last so it never points to sections that don't exist yet
+    save_object(section_path("manifest.json"), manifest);
+
+    dirty_features.assign(features_count(), false);
+    dirty_models.assign(models_count(), false);
+    dirty_bootstraps.assign(bootstraps_count(), false);
+    dirty_data_set = false;
+    dirty = false;
+}
@@ -0,0 +1,130 @@
+#ifndef PROJECT_STORE_H
+#define PROJECT_STORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+#include "project.h"
+
+// Index of each section of a sectioned project and what commands need to know
+// about it without loading it
+struct ProjectManifest {
+    struct features_entry {
+        std::string file;
+        bool computed;
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(NVP(file), NVP(computed));
+        }
+    };
+
+    struct model_entry {
+        std::string file;
+        long features; // Index in features, -1 if none
+        long parent; // Index in models, -1 if none
+        bool solved;
+        bool bootstrapable;
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(NVP(file), NVP(features), NVP(parent), NVP(solved), NVP(bootstrapable));
+        }
+    };
+
+    struct bootstrap_entry {
+        std::string file;
+        long base_model; // Index in models, -1 if none
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(NVP(file), NVP(base_model));
+        }
+    };
+
+    std::string data_set;
+    std::vector<features_entry> features;
+    std::vector<model_entry> models;
+    std::vector<bootstrap_entry> bootstraps;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(NVP(data_set), NVP(features), NVP(models), NVP(bootstraps));
+    }
+};
+
+// Access to a project on disk, either a single project.bin or project.json file,
+// or a sectioned layout where the data set, each features graph, model and bootstrap
+// live in their own file under sections/ and are only loaded when requested.
+// Loading a model also loads what it references (features, parent).
+// Objects that are modified must be marked with touch() to be saved by commit().
+// All files are written atomically.
+class ProjectStore {
+public:
+    explicit ProjectStore(const std::string& project_dir);
+
+    // Write a project in sectioned layout into project_dir
+    static void split(const std::string& project_dir, Project& project);
+    // Merge a sectioned project back into project_dir/project.json
+    static void join(const std::string& project_dir);
+
+    bool sectioned() const { return is_sectioned; }
+
+    // Single file backend's file name
+    std::string filename() const;
+
+    std::shared_ptr<DataSet> data_set();
+    // Add images at the end of the data set, saved by commit()
+    void append_images(const std::vector<std::string>& filenames);
+
+    size_t features_count() const { return project_data.features_list.size(); }
+    bool features_computed(size_t i) const;
+    std::shared_ptr<FeaturesGraph> features(size_t i);
+
+    size_t models_count() const { return project_data.models.size(); }
+    bool model_solved(size_t i) const;
+    bool model_bootstrapable(size_t i) const;
+    std::shared_ptr<Model> model(size_t i);
+
+    size_t bootstraps_count() const { return project_data.bootstraps.size(); }
+    // Index of the model a bootstrap was computed from, -1 if none
+    long bootstrap_base_model(size_t i) const;
+    std::shared_ptr<Bootstrap> bootstrap(size_t i);
+
+    // The whole project, loading every section
+    Project& project();
+
+    // Add new objects, their references must already be part of the project
+    void add(std::shared_ptr<FeaturesGraph> features);
+    void add(std::shared_ptr<Model> model);
+    void add(std::shared_ptr<Bootstrap> bootstrap);
+
+    // Mark a loaded object as modified
+    void touch(const std::shared_ptr<FeaturesGraph>& features);
+    void touch(const std::shared_ptr<Model>& model);
+    void touch(const std::shared_ptr<Bootstrap>& bootstrap);
+
+    // Save modified and added objects
+    void commit();
+
+private:
+    ProjectStore();
+    std::string section_path(const std::string& file) const;
+    void save_features(size_t i);
+    void save_model(size_t i);
+    void save_bootstrap(size_t i);
+
+    std::string project_dir;
+    bool is_sectioned;
+    // Loaded objects, null where not yet loaded
+    Project project_data;
+    ProjectManifest manifest;
+    // Objects to save at commit
+    std::vector<bool> dirty_features, dirty_models, dirty_bootstraps;
+    bool dirty_data_set;
+    bool dirty;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <stdexcept>
+#include "project_store.h"
+#include "model0.h"
+#include "python_api.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+PythonProject::PythonProject(const string& project_dir) :
+    store(new ProjectStore(project_dir)) {
+}
+
+PythonProject::~PythonProject() {
+}
+
+size_t PythonProject::images_count() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->data_set()->filenames.size();
+}
+
+string PythonProject::image_filename(size_t i) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->data_set()->filenames.at(i);
+}
+
+double PythonProject::image_rows() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->data_set()->rows;
+}
+
+double PythonProject::image_cols() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->data_set()->cols;
+}
+
+size_t PythonProject::features_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->features_count();
+}
+
+bool PythonProject::features_computed(size_t f) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->features_computed(f);
+}
+
+void PythonProject::compute_features(size_t f, const string& data_dir) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (store->features_computed(f)) {
+        return;
+    }
+    auto feat = store->features(f);
+    feat->compute(data_dir);
+    store->touch(feat);
+    store->commit();
+}
+
+size_t PythonProject::edges_count(size_t f) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->features(f)->edges.size();
+}
+
+size_t PythonProject::edge_size(size_t f, size_t e) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->features(f)->edges.at(e).size();
+}
+
+void PythonProject::edge_observations(size_t f, size_t e, int side, double* observations) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto feat = store->features(f);
+    const obs_pair& edge = feat->edges.at(e);
+    const size_t cam = side == 0 ? edge.cam_a : edge.cam_b;
+    const vector<uint32_t>& index = side == 0 ? edge.index_a : edge.index_b;
+    for (size_t i = 0; i < index.size(); i++) {
+        pixel_t p = feat->pixel(cam, index[i]);
+        observations[2*i] = p.i;
+        observations[2*i + 1] = p.j;
+    }
+}
+
+size_t PythonProject::models_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->models_count();
+}
+
+bool PythonProject::model_solved(size_t m) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->model_solved(m);
+}
+
+long PythonProject::model_features(size_t m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto model = store->model(m);
+    if (!model->features) {
+        return -1;
+    }
+    for (size_t f = 0; f < store->features_count(); f++) {
+        if (store->features(f) == model->features) {
+            return static_cast<long>(f);
+        }
+    }
+    return -1;
+}
+
+void PythonProject::solve(size_t m, const string& data_dir) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (store->model_solved(m)) {
+        return;
+    }
+    auto model = store->model(m);
+    if (!model->features || model->features->edges.size() == 0 || model->features->computed == false) {
+        throw std::runtime_error("Attempting to solve model but no observations are available");
+    }
+    model->solve_with_images(data_dir);
+    model->solved = true;
+    store->touch(model);
+    store->commit();
+}
+
+void PythonProject::final_internal(size_t m, double* internal) {
+    std::lock_guard<std::mutex> lock(mutex);
+    internal_t in = store->model(m)->final_internal();
+    std::copy(in.begin(), in.end(), internal);
+}
+
+size_t PythonProject::cameras_count(size_t m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->model(m)->final_external().size();
+}
+
+void PythonProject::final_external(size_t m, double* external) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const array<double, 6>& cam : store->model(m)->final_external()) {
+        external = std::copy(cam.begin(), cam.end(), external);
+    }
+}
+
+size_t PythonProject::terrain_size(size_t m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return store->model(m)->final_terrain().size();
+}
+
+void PythonProject::final_terrain(size_t m, double* terrain) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const array<double, 3>& p : store->model(m)->final_terrain()) {
+        terrain = std::copy(p.begin(), p.end(), terrain);
+    }
+}
+
+// First logged solution of Model0 m
+static Model0::solution initial_solution(ProjectStore& store, size_t m) {
+    auto model = std::dynamic_pointer_cast<Model0>(store.model(m));
+    if (!model) {
+        throw std::runtime_error("Initial solution is only available for Model0");
+    }
+    if (model->solutions.empty()) {
+        throw std::runtime_error("Model has no initial solution");
+    }
+    return model->solutions.front();
+}
+
+size_t PythonProject::initial_cameras_count(size_t m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return initial_solution(*store, m).cameras.size();
+}
+
+void PythonProject::initial_external(size_t m, double* external) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const array<double, 6>& cam : initial_solution(*store, m).cameras) {
+        external = std::copy(cam.begin(), cam.end(), external);
+    }
+}
+
+size_t PythonProject::initial_terrain_size(size_t m) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return initial_solution(*store, m).terrain.size();
+}
+
+void PythonProject::initial_terrain(size_t m, double* terrain) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const array<double, 2>& p : initial_solution(*store, m).terrain) {
+        *terrain++ = p[0];
+        *terrain++ = p[1];
+        *terrain++ = 0.0;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef PYTHON_API_H
+#define PYTHON_API_H
+
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <mutex>
+
+class ProjectStore;
+
+// Handle on a project for the pymodel0 Python module
+// Only uses standard types so that Cython doesn't need to see cereal, OpenCV or ceres.
+// Array accessors copy into caller buffers. Every call holds the handle's mutex,
+// so pymodel0 can release the GIL around them.
+class PythonProject {
+public:
+    explicit PythonProject(const std::string& project_dir);
+    ~PythonProject();
+
+    size_t images_count();
+    std::string image_filename(size_t i);
+    double image_rows();
+    double image_cols();
+
+    size_t features_count() const;
+    bool features_computed(size_t f) const;
+    // Compute features graph f if it isn't yet and save the project
+    void compute_features(size_t f, const std::string& data_dir);
+
+    size_t edges_count(size_t f);
+    size_t edge_size(size_t f, size_t e);
+    // Observations of one side (0 or 1) of an edge, copied into a caller
+    // buffer of size (edge_size, 2) as rows of {i, j}
+    void edge_observations(size_t f, size_t e, int side, double* observations);
+
+    size_t models_count() const;
+    bool model_solved(size_t m) const;
+    // Index of the features graph model m is solved from, -1 if none
+    long model_features(size_t m);
+    // Solve model m if it isn't yet and save the project
+    void solve(size_t m, const std::string& data_dir);
+
+    // Final values of model m, copied into caller buffers of the given sizes
+    // internal: 4, external: (cameras, 6), terrain: (terrain_size, 3)
+    void final_internal(size_t m, double* internal);
+    size_t cameras_count(size_t m);
+    void final_external(size_t m, double* external);
+    size_t terrain_size(size_t m);
+    void final_terrain(size_t m, double* terrain);
+
+    // Initial solution of Model0 m, the first of its logged solutions, with
+    // the same layout as the final values. Internal parameters are fixed.
+    size_t initial_cameras_count(size_t m);
+    void initial_external(size_t m, double* external);
+    size_t initial_terrain_size(size_t m);
+    void initial_terrain(size_t m, double* terrain);
+
+private:
+    mutable std::mutex mutex;
+    std::unique_ptr<ProjectStore> store;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <stdexcept>
+#include "rectification.h"
+#include "camera_models.h"
+#include "types.h"
+
+using std::array;
+typedef Rectification::matrix3 matrix3;
+typedef Rectification::vector3 vector3;
+
+// Axes of the camera frame in world coordinates, as columns
+// pinhole_projection rotates (x - cx, y - cy, cz - z) by R, so world = diag(1, 1, -1) R^T camera
+// The frame is left handed and cameras look along its -z axis
+static matrix3 camera_axes(const array<double, 6>& external) {
+    matrix3 R = rotation_matrix_3<double, double>(external.data());
+    return vector3(1, 1, -1).asDiagonal() * R.transpose();
+}
+
+static vector3 camera_center(const array<double, 6>& external) {
+    return vector3(external[0], external[1], external[2]);
+}
+
+Rectification::Rectification(const internal_t& internal, const array<double, 6>& cam_a, const array<double, 6>& cam_b,
+                             unsigned long rows, unsigned long cols, double scale) :
+    center(camera_center(cam_a)),
+    rows(static_cast<int>(std::lround(static_cast<double>(rows) * scale))),
+    cols(static_cast<int>(std::lround(static_cast<double>(cols) * scale))),
+    focal(focal_length(internal.data()) / pixel_size(internal) * scale),
+    cu(this->cols / 2.0),
+    cv(this->rows / 2.0) {
+    const vector3 b = camera_center(cam_b) - center;
+    baseline = b.norm();
+    if (baseline <= 0) {
+        throw std::runtime_error("Can't rectify cameras with the same position");
+    }
+    const matrix3 axes_a = camera_axes(cam_a);
+    const matrix3 axes_b = camera_axes(cam_b);
+    const vector3 x = b / baseline;
+    const vector3 view = -(axes_a.col(2) + axes_b.col(2)).normalized();
+    const vector3 z = (view - view.dot(x) * x).normalized();
+    // Left handed as the camera frames, so that rectified images aren't mirrored
+    const vector3 y = x.cross(z);
+    rotation.row(0) = x.transpose();
+    rotation.row(1) = y.transpose();
+    rotation.row(2) = z.transpose();
+}
+
+double Rectification::depth(const array<double, 3>& p) const {
+    return rotation.row(2).dot(vector3(p[0], p[1], p[2]) - center);
+}
+
+array<double, 3> Rectification::triangulate(double row, double u, double d) const {
+    const double z = focal * baseline / d;
+    const vector3 q(z * (u - cu) / focal, z * (cv - row) / focal, z);
+    const vector3 p = center + rotation.transpose() * q;
+    return {{p(0), p(1), p(2)}};
+}
+
+void Rectification::maps(const internal_t& internal, const array<double, 6>& external,
+                         unsigned long image_rows, unsigned long image_cols, double scale,
+                         cv::Mat& map_x, cv::Mat& map_y) const {
+    map_x.create(rows, cols, CV_32F);
+    map_y.create(rows, cols, CV_32F);
+    // Rectified pixel rays to the camera's frame
+    const matrix3 to_camera = camera_axes(external).transpose() * rotation.transpose();
+    const double f = focal_length(internal.data());
+    for (int r = 0; r < rows; r++) {
+        float* mx = map_x.ptr<float>(r);
+        float* my = map_y.ptr<float>(r);
+        for (int u = 0; u < cols; u++) {
+            const vector3 q = to_camera * vector3((u - cu) / focal, (cv - r) / focal, 1.0);
+            if (q(2) >= 0) {
+                mx[u] = my[u] = -1.0f; // Behind the camera
+                continue;
+            }
+            sensor_t s(f * q(0) / q(2) + pp_x(internal.data()), f * q(1) / q(2) + pp_y(internal.data()));
+            pixel_t p = s.to_pixel(pixel_size(internal), image_rows, image_cols);
+            mx[u] = static_cast<float>(p.j * scale);
+            my[u] = static_cast<float>(p.i * scale);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef RECTIFICATION_H
+#define RECTIFICATION_H
+
+#include <array>
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+#include "internal.h"
+
+// Rectified geometry of a camera pair
+// Both rectified cameras have the axes of the rows of rotation, with x along the
+// baseline and z along the viewing direction, and focal length focal in pixels:
+// a point at depth z is seen on the same row of both images, at columns
+// u_a - u_b = focal * baseline / z
+struct Rectification {
+    typedef Eigen::Matrix<double, 3, 3, Eigen::ColMajor> matrix3;
+    typedef Eigen::Matrix<double, 3, 1, Eigen::ColMajor> vector3;
+
+    // Rectified images of rows * cols images at scale
+    Rectification(const internal_t& internal, const std::array<double, 6>& cam_a, const std::array<double, 6>& cam_b,
+                  unsigned long rows, unsigned long cols, double scale);
+
+    // Depth of a world point in the rectified frame
+    double depth(const std::array<double, 3>& p) const;
+
+    // World point of the rectified pixel (row, u) of the first camera at disparity d
+    std::array<double, 3> triangulate(double row, double u, double d) const;
+
+    // Maps of the rectified image pixels into the scaled image of a camera, for cv::remap
+    // Pixels behind the camera map to -1
+    void maps(const internal_t& internal, const std::array<double, 6>& external,
+              unsigned long image_rows, unsigned long image_cols, double scale,
+              cv::Mat& map_x, cv::Mat& map_y) const;
+
+    vector3 center; // Of the first camera
+    matrix3 rotation; // World to rectified frame
+    double baseline;
+    int rows, cols; // Of the rectified images
+    double focal; // In rectified pixels
+    double cu, cv; // Principal point
+};
+
+#endif
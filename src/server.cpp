@@ -0,0 +1,163 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+#include "project_cache.h"
+
+using std::string;
+
+// Maximum length of a request line
+const size_t max_request_size = 65536;
+
+static sockaddr_un socket_address(const string& socket_path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + socket_path);
+    }
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+// Read up to and excluding a newline
+static bool read_line(int fd, string& line) {
+    line.clear();
+    char c;
+    while (line.size() < max_request_size) {
+        ssize_t n = ::recv(fd, &c, 1, 0);
+        if (n <= 0) {
+            return false;
+        }
+        if (c == '\n') {
+            return true;
+        }
+        line.push_back(c);
+    }
+    return false;
+}
+
+static bool write_all(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void handle_client(int fd, const command_runner& run) {
+    string line;
+    string reply;
+    if (!read_line(fd, line)) {
+        reply = "error: malformed request\n";
+    } else {
+        size_t first = line.find('\t');
+        size_t second = first == string::npos ? string::npos : line.find('\t', first + 1);
+        if (second == string::npos) {
+            reply = "error: expected data_dir, project_dir and command separated by tabs\n";
+        } else {
+            const string data_dir = line.substr(0, first);
+            const string project_dir = line.substr(first + 1, second - first - 1);
+            const string command = line.substr(second + 1);
+
+            std::cout << "Request: " << command << " " << project_dir << std::endl;
+            std::unique_lock<std::mutex> project_lock = ProjectCache::instance().lock(project_dir);
+            try {
+                run(data_dir, project_dir, command);
+                ProjectCache::instance().release(project_dir, true);
+                reply = "ok\n";
+            } catch (std::exception& err) {
+                ProjectCache::instance().release(project_dir, false);
+                reply = string("error: ") + err.what() + "\n";
+            } catch (...) {
+                ProjectCache::instance().release(project_dir, false);
+                reply = "error: unknown exception\n";
+            }
+        }
+    }
+    write_all(fd, reply);
+    ::close(fd);
+}
+
+void serve(const string& socket_path, const command_runner& run, size_t workers) {
+    if (workers == 0) {
+        throw std::runtime_error("The server needs at least one worker");
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Can't create socket");
+    }
+    sockaddr_un addr = socket_address(socket_path);
+    ::unlink(socket_path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Can't listen on " + socket_path);
+    }
+
+    std::cout << "Listening on " << socket_path << " with " << workers << " workers" << std::endl;
+    // Workers accept on the same socket, so at most workers clients are served at once
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < workers; i++) {
+        pool.emplace_back([fd, &run]() {
+            for (;;) {
+                int client = ::accept(fd, NULL, NULL);
+                if (client >= 0) {
+                    handle_client(client, run);
+                }
+            }
+        });
+    }
+    for (auto& worker : pool) {
+        worker.join();
+    }
+}
+
+// The server doesn't share our working directory
+static string absolute_path(const string& path) {
+    if (!path.empty() && path[0] == '/') {
+        return path;
+    }
+    char cwd[4096];
+    if (::getcwd(cwd, sizeof(cwd)) == NULL) {
+        throw std::runtime_error("Can't get current directory");
+    }
+    return string(cwd) + "/" + path;
+}
+
+bool send_command(const string& socket_path,
+                  const string& data_dir,
+                  const string& project_dir,
+                  const string& command,
+                  string& error) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Can't create socket");
+    }
+    sockaddr_un addr = socket_address(socket_path);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Can't connect to " + socket_path);
+    }
+
+    string reply;
+    bool sent = write_all(fd, absolute_path(data_dir) + "\t" + absolute_path(project_dir) + "\t" + command + "\n");
+    bool received = sent && read_line(fd, reply);
+    ::close(fd);
+    if (!received) {
+        throw std::runtime_error("Connection to " + socket_path + " lost");
+    }
+    if (reply != "ok") {
+        error = reply;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <functional>
+
+// Runs one geosolve command
+typedef std::function<void (const std::string& data_dir,
+                            const std::string& project_dir,
+                            const std::string& command)> command_runner;
+
+// Listen on a Unix socket and run requests concurrently on a pool of worker threads
+// Each worker serves one connection at a time, further connections wait to be accepted.
+// A request is a single line "data_dir\tproject_dir\tcommand\n",
+// answered by "ok\n" or "error: <message>\n" once the command has completed.
+// Requests on the same project are serialized and the project stays in memory.
+void serve(const std::string& socket_path, const command_runner& run, size_t workers);
+
+// Run a command on a server and wait for it to complete
+// Returns false and sets error if the command failed
+bool send_command(const std::string& socket_path,
+                  const std::string& data_dir,
+                  const std::string& project_dir,
+                  const std::string& command,
+                  std::string& error);
+
+#endif
@@ -0,0 +1,224 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "sgm.h"
+#include "task_graph.h"
+#include "trace.h"
+
+using std::vector;
+
+typedef uint16_t cost_t;
+
+// Matching cost where the right pixel is outside of the image, above any Hamming distance
+static const uint8_t outside_cost = 64;
+// Cost of the padding slots around the disparities of a path, so that the
+// d - 1 and d + 1 neighbours need no bounds check. Plus P1 it still fits a cost_t.
+static const cost_t padding_cost = 0x7FFF;
+
+vector<uint64_t> census_transform(const uint8_t* image, int rows, int cols) {
+    vector<uint64_t> census(static_cast<size_t>(rows) * cols, 0);
+    for (int r = 3; r < rows - 3; r++) {
+        for (int c = 4; c < cols - 4; c++) {
+            const uint8_t center = image[r * cols + c];
+            uint64_t bits = 0;
+            for (int dr = -3; dr <= 3; dr++) {
+                const uint8_t* row = image + (r + dr) * cols + c;
+                for (int dc = -4; dc <= 4; dc++) {
+                    if (dr != 0 || dc != 0) {
+                        bits = (bits << 1) | (row[dc] < center ? 1u : 0u);
+                    }
+                }
+            }
+            census[r * cols + c] = bits;
+        }
+    }
+    return census;
+}
+
+// One step along a path, for disparities 1..D of padded buffers:
+// L(p, d) = C(p, d) + min(L(p-r, d), L(p-r, d-1) + P1, L(p-r, d+1) + P1, min L(p-r) + P2) - min L(p-r)
+static inline void path_step(const uint8_t* cost, const cost_t* previous, cost_t* current, int D, cost_t P1, cost_t P2) {
+    cost_t min_previous = padding_cost;
+    for (int d = 1; d <= D; d++) {
+        min_previous = std::min(min_previous, previous[d]);
+    }
+    const cost_t jump = static_cast<cost_t>(min_previous + P2);
+    for (int d = 1; d <= D; d++) {
+        const cost_t neighbour = static_cast<cost_t>(std::min(previous[d - 1], previous[d + 1]) + P1);
+        const cost_t best = std::min(std::min(previous[d], neighbour), jump);
+        current[d] = static_cast<cost_t>(cost[d - 1] + best - min_previous);
+    }
+}
+
+// Start of a path, L(p, d) = C(p, d)
+static inline void path_start(const uint8_t* cost, cost_t* current, int D) {
+    for (int d = 1; d <= D; d++) {
+        current[d] = cost[d - 1];
+    }
+}
+
+static inline void accumulate(const cost_t* path, cost_t* sum, int D) {
+    for (int d = 0; d < D; d++) {
+        sum[d] = static_cast<cost_t>(sum[d] + path[d + 1]);
+    }
+}
+
+// Index of the smallest of n costs
+static inline int argmin(const cost_t* costs, int n) {
+    int best = 0;
+    for (int k = 1; k < n; k++) {
+        if (costs[k] < costs[best]) {
+            best = k;
+        }
+    }
+    return best;
+}
+
+// Match rows [first, last) into disparity
+static void match_strip(const vector<uint64_t>& census_left, const vector<uint64_t>& census_right,
+                        int rows, int cols, const SGMOptions& options, int first, int last, float* disparity) {
+    TRACE_SCOPE("sgm_strip");
+    const int D = options.disparities;
+    const int top = std::max(0, first - options.overlap);
+    const int bottom = std::min(rows, last + options.overlap);
+    const int height = bottom - top;
+    const cost_t P1 = static_cast<cost_t>(options.P1);
+    const cost_t P2 = static_cast<cost_t>(options.P2);
+    const size_t pixel_stride = static_cast<size_t>(D);
+    const size_t row_stride = pixel_stride * cols;
+
+    // Matching costs of the strip, C(r, c, k) for disparity min_disparity + k
+    vector<uint8_t> cost(row_stride * height);
+    for (int r = 0; r < height; r++) {
+        const uint64_t* left = &census_left[(top + r) * static_cast<size_t>(cols)];
+        const uint64_t* right = &census_right[(top + r) * static_cast<size_t>(cols)];
+        for (int c = 0; c < cols; c++) {
+            uint8_t* pixel = &cost[r * row_stride + c * pixel_stride];
+            for (int k = 0; k < D; k++) {
+                const int c2 = c - options.min_disparity - k;
+                pixel[k] = (c2 >= 0 && c2 < cols) ? static_cast<uint8_t>(__builtin_popcountll(left[c] ^ right[c2])) : outside_cost;
+            }
+        }
+    }
+
+    // Sum of the path costs
+    vector<cost_t> sum(row_stride * height, 0);
+
+    // Horizontal paths, left to right and right to left
+    vector<cost_t> previous(D + 2, padding_cost), current(D + 2, padding_cost);
+    for (int r = 0; r < height; r++) {
+        for (int direction = -1; direction <= 1; direction += 2) {
+            const int start = direction > 0 ? 0 : cols - 1;
+            for (int c = start; c >= 0 && c < cols; c += direction) {
+                const size_t offset = r * row_stride + c * pixel_stride;
+                if (c == start) {
+                    path_start(&cost[offset], current.data(), D);
+                } else {
+                    path_step(&cost[offset], previous.data(), current.data(), D, P1, P2);
+                }
+                accumulate(current.data(), &sum[offset], D);
+                previous.swap(current);
+            }
+        }
+    }
+
+    // Vertical and diagonal paths, top to bottom and bottom to top, one row of pixels at a time
+    const size_t path_stride = static_cast<size_t>(D + 2);
+    vector<cost_t> previous_row(path_stride * cols, padding_cost), current_row(path_stride * cols, padding_cost);
+    for (int dy = -1; dy <= 1; dy += 2) {
+        for (int dx = -1; dx <= 1; dx++) {
+            const int start = dy > 0 ? 0 : height - 1;
+            for (int r = start; r >= 0 && r < height; r += dy) {
+                for (int c = 0; c < cols; c++) {
+                    const size_t offset = r * row_stride + c * pixel_stride;
+                    const int pc = c - dx;
+                    cost_t* path = &current_row[c * path_stride];
+                    if (r == start || pc < 0 || pc >= cols) {
+                        path_start(&cost[offset], path, D);
+                    } else {
+                        path_step(&cost[offset], &previous_row[pc * path_stride], path, D, P1, P2);
+                    }
+                    accumulate(path, &sum[offset], D);
+                }
+                previous_row.swap(current_row);
+            }
+        }
+    }
+
+    // Winner takes all, with left-right consistency check
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    vector<int> right_disparity(cols);
+    for (int r = first - top; r < last - top; r++) {
+        const cost_t* row = &sum[r * row_stride];
+        // Best disparity of each right pixel c2, over the left pixels c2 + d
+        for (int c2 = 0; c2 < cols; c2++) {
+            int best = -1;
+            cost_t best_cost = 0;
+            for (int k = 0; k < D; k++) {
+                const int c = c2 + options.min_disparity + k;
+                if (c < 0 || c >= cols) {
+                    continue;
+                }
+                const cost_t value = row[c * pixel_stride + k];
+                if (best < 0 || value < best_cost) {
+                    best = k;
+                    best_cost = value;
+                }
+            }
+            right_disparity[c2] = best;
+        }
+
+        float* output = disparity + (top + r) * static_cast<size_t>(cols);
+        for (int c = 0; c < cols; c++) {
+            output[c] = nan;
+            const cost_t* costs = &row[c * pixel_stride];
+            const int k = argmin(costs, D);
+            const int c2 = c - options.min_disparity - k;
+            if (c2 < 0 || c2 >= cols || right_disparity[c2] < 0 ||
+                std::abs(right_disparity[c2] - k) > options.max_lr_difference) {
+                continue;
+            }
+            float refined = static_cast<float>(k);
+            if (k > 0 && k < D - 1) {
+                const int denominator = costs[k - 1] - 2 * costs[k] + costs[k + 1];
+                if (denominator > 0) {
+                    refined += static_cast<float>(costs[k - 1] - costs[k + 1]) / static_cast<float>(2 * denominator);
+                }
+            }
+            output[c] = static_cast<float>(options.min_disparity) + refined;
+        }
+    }
+}
+
+vector<float> sgm_disparity(const uint8_t* left, const uint8_t* right, int rows, int cols, const SGMOptions& options) {
+    TRACE_SCOPE("sgm");
+    if (options.disparities <= 0 || options.strip_rows <= 0 || options.overlap < 0) {
+        throw std::runtime_error("Invalid semi-global matching options");
+    }
+    // Path costs are bounded by the largest matching cost plus P2, times 8 paths in the sum
+    if (options.P1 < 0 || options.P2 < options.P1 || 8 * (outside_cost + options.P2) > 0xFFFF) {
+        throw std::runtime_error("Invalid semi-global matching penalties");
+    }
+
+    vector<uint64_t> census_left, census_right;
+    {
+        TRACE_SCOPE("sgm_census");
+        census_left = census_transform(left, rows, cols);
+        census_right = census_transform(right, rows, cols);
+    }
+
+    vector<float> disparity(static_cast<size_t>(rows) * cols, std::numeric_limits<float>::quiet_NaN());
+    TaskGraph strips;
+    for (int first = 0; first < rows; first += options.strip_rows) {
+        const int last = std::min(rows, first + options.strip_rows);
+        strips.add("sgm rows " + std::to_string(first), [&, first, last]() {
+            if (options.cancelled && options.cancelled()) {
+                return;
+            }
+            match_strip(census_left, census_right, rows, cols, options, first, last, disparity.data());
+        });
+    }
+    strips.run(options.threads);
+    return disparity;
+}
@@ -0,0 +1,42 @@
+#ifndef SGM_H
+#define SGM_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+struct SGMOptions {
+    SGMOptions() : min_disparity(0), disparities(64), P1(10), P2(120),
+        strip_rows(64), overlap(16), max_lr_difference(1.0f), threads(0) {}
+
+    int min_disparity;
+    int disparities; // Number of disparities searched from min_disparity
+    int P1; // Penalty of disparity changes of one between neighbours
+    int P2; // Penalty of larger disparity changes
+    int strip_rows; // Rows of the strips matched in parallel
+    int overlap; // Rows above and below a strip where vertical paths start
+    float max_lr_difference; // Largest difference of left and right disparities
+    size_t threads; // 0 uses the hardware concurrency
+    // Polled by the matching threads before each strip, strips not started once
+    // it returned true are left NaN
+    std::function<bool()> cancelled;
+};
+
+// Census transform over a 9x7 window, one 62 bits string per pixel
+// Pixels closer than the window to the border are zero
+std::vector<uint64_t> census_transform(const uint8_t* image, int rows, int cols);
+
+// Semi-global matching of a rectified image pair (Hirschmuller 2008)
+// Returns the disparity of each pixel of left, such that left(r, c) matches
+// right(r, c - d), refined to sub-pixel by parabola fitting, or NaN where
+// the left-right consistency check fails.
+// Costs are Hamming distances of census transforms, aggregated along 8 paths.
+// Strips of strip_rows rows are matched independently on a pool of threads:
+// vertical and diagonal paths start overlap rows outside of the strip, so
+// memory is bounded by about 3 bytes * threads * (strip_rows + 2 overlap) * cols * disparities.
+// Inner loops run over disparities on contiguous 16 bit costs, for the compiler to vectorize.
+std::vector<float> sgm_disparity(const uint8_t* left, const uint8_t* right, int rows, int cols,
+                                 const SGMOptions& options = SGMOptions());
+
+#endif
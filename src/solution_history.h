@@ -0,0 +1,168 @@
+#ifndef SOLUTION_HISTORY_H
+#define SOLUTION_HISTORY_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <cereal/cereal.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+#include "project_format.h"
+
+// How the logged solutions of a model are stored
+// With delta encoding, the first and last solutions are stored at full precision
+// and each intermediate one as integer multiples of quantum away from the first.
+// Decoded values are within quantum/2 of the original, without drift.
+struct HistoryEncoding {
+    HistoryEncoding() : delta(false), quantum(1e-6) {}
+    bool delta;
+    double quantum;
+};
+
+// Helpers for solution types to implement flatten() and unflatten()
+template <size_t N>
+void append_flat(std::vector<double>& flat, const std::vector<std::array<double, N>>& values) {
+    for (auto& v : values) {
+        flat.insert(flat.end(), v.begin(), v.end());
+    }
+}
+
+template <size_t N>
+std::vector<double>::const_iterator read_flat(std::vector<double>::const_iterator it, std::vector<std::array<double, N>>& values) {
+    for (auto& v : values) {
+        std::copy(it, it + N, v.begin());
+        it += N;
+    }
+    return it;
+}
+
+// Serialization wrapper of a model's vector of solutions
+// Solution must provide flatten() and unflatten() over all of its values
+template <typename Solution>
+class SolutionHistory {
+public:
+    SolutionHistory(std::vector<Solution>& solutions, HistoryEncoding& encoding) :
+        solutions(solutions), encoding(encoding) {}
+
+    template <class Archive>
+    void save(Archive& ar) const {
+        std::vector<std::vector<std::int32_t>> deltas;
+        if (encoding.delta && encode(deltas)) {
+            std::vector<Solution> ends {solutions.front(), solutions.back()};
+            ar(cereal::make_nvp("encoding", std::string("delta")),
+               cereal::make_nvp("quantum", encoding.quantum),
+               cereal::make_nvp("full", ends),
+               cereal::make_nvp("deltas", deltas));
+        } else {
+            ar(cereal::make_nvp("encoding", std::string("full")),
+               cereal::make_nvp("quantum", encoding.quantum),
+               cereal::make_nvp("full", solutions),
+               cereal::make_nvp("deltas", deltas));
+        }
+    }
+
+    template <class Archive>
+    void load(Archive& ar) {
+        if (archive_version() == 0) {
+            // Plain array of solutions, as std::vector is archived
+            cereal::size_type size;
+            ar(cereal::make_size_tag(size));
+            solutions.resize(static_cast<size_t>(size));
+            for (auto& s : solutions) {
+                ar(s);
+            }
+            encoding.delta = false;
+            return;
+        }
+        std::string name;
+        std::vector<Solution> full;
+        std::vector<std::vector<std::int32_t>> deltas;
+        ar(cereal::make_nvp("encoding", name),
+           cereal::make_nvp("quantum", encoding.quantum),
+           cereal::make_nvp("full", full),
+           cereal::make_nvp("deltas", deltas));
+
+        if (name == "full") {
+            encoding.delta = false;
+            solutions = std::move(full);
+        } else if (name == "delta") {
+            if (full.size() != 2) {
+                throw std::runtime_error("Delta encoded history needs first and last solutions.");
+            }
+            encoding.delta = true;
+            decode(full, deltas);
+        } else {
+            throw std::runtime_error("Unknown solution history encoding: " + name);
+        }
+    }
+
+private:
+    // False if the history can't be delta encoded
+    bool encode(std::vector<std::vector<std::int32_t>>& deltas) const {
+        if (solutions.size() < 3) {
+            return false;
+        }
+        const std::vector<double> first = solutions.front().flatten();
+        std::vector<long long> previous(first.size(), 0);
+
+        for (size_t k = 1; k + 1 < solutions.size(); k++) {
+            const std::vector<double> x = solutions[k].flatten();
+            if (x.size() != first.size()) {
+                return false;
+            }
+            std::vector<std::int32_t> d(x.size());
+            for (size_t i = 0; i < x.size(); i++) {
+                const double steps = std::round((x[i] - first[i]) / encoding.quantum);
+                if (!std::isfinite(steps) || std::abs(steps) > 1e18) {
+                    return false;
+                }
+                const long long total = static_cast<long long>(steps);
+                const long long delta = total - previous[i];
+                if (delta > std::numeric_limits<std::int32_t>::max() || delta < std::numeric_limits<std::int32_t>::min()) {
+                    return false;
+                }
+                d[i] = static_cast<std::int32_t>(delta);
+                previous[i] = total;
+            }
+            deltas.push_back(d);
+        }
+        return true;
+    }
+
+    void decode(const std::vector<Solution>& ends, const std::vector<std::vector<std::int32_t>>& deltas) {
+        const std::vector<double> first = ends[0].flatten();
+        std::vector<long long> total(first.size(), 0);
+        std::vector<double> x(first.size());
+
+        solutions.clear();
+        solutions.reserve(deltas.size() + 2);
+        solutions.push_back(ends[0]);
+        for (auto& d : deltas) {
+            if (d.size() != first.size()) {
+                throw std::runtime_error("Delta encoded history has inconsistent solution sizes.");
+            }
+            for (size_t i = 0; i < d.size(); i++) {
+                total[i] += d[i];
+                x[i] = first[i] + encoding.quantum * total[i];
+            }
+            Solution s(ends[0]);
+            s.unflatten(x);
+            solutions.push_back(s);
+        }
+        solutions.push_back(ends[1]);
+    }
+
+    std::vector<Solution>& solutions;
+    HistoryEncoding& encoding;
+};
+
+template <typename Solution>
+SolutionHistory<Solution> make_history(std::vector<Solution>& solutions, HistoryEncoding& encoding) {
+    return SolutionHistory<Solution>(solutions, encoding);
+}
+
+#endif
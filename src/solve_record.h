@@ -0,0 +1,135 @@
+#ifndef SOLVE_RECORD_H
+#define SOLVE_RECORD_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ceres/ceres.h"
+#include <cereal/cereal.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/string.hpp>
+
+// Outcome and timings of one ceres solve, kept in the project for performance analysis
+// Times are in seconds
+struct SolveRecord {
+    struct iteration {
+        int number;
+        double cost;
+        double cost_change;
+        bool successful;
+        int linear_solver_iterations;
+        double iteration_time;
+        double step_solver_time;
+        double cumulative_time;
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(CEREAL_NVP(number), CEREAL_NVP(cost), CEREAL_NVP(cost_change),
+               CEREAL_NVP(successful), CEREAL_NVP(linear_solver_iterations),
+               CEREAL_NVP(iteration_time), CEREAL_NVP(step_solver_time), CEREAL_NVP(cumulative_time));
+        }
+    };
+
+    SolveRecord() :
+        solved(false), partial(false), num_parameters(0), num_residuals(0),
+        num_successful_steps(0), num_unsuccessful_steps(0),
+        initial_cost(0), final_cost(0),
+        preprocessor_time(0), minimizer_time(0), postprocessor_time(0), total_time(0),
+        residual_evaluation_time(0), jacobian_evaluation_time(0), linear_solver_time(0) {}
+
+    explicit SolveRecord(const ceres::Solver::Summary& summary) :
+        solved(true),
+        partial(false),
+        termination(ceres::TerminationTypeToString(summary.termination_type)),
+        num_parameters(summary.num_parameters),
+        num_residuals(summary.num_residuals),
+        num_successful_steps(summary.num_successful_steps),
+        num_unsuccessful_steps(summary.num_unsuccessful_steps),
+        initial_cost(summary.initial_cost),
+        final_cost(summary.final_cost),
+        preprocessor_time(summary.preprocessor_time_in_seconds),
+        minimizer_time(summary.minimizer_time_in_seconds),
+        postprocessor_time(summary.postprocessor_time_in_seconds),
+        total_time(summary.total_time_in_seconds),
+        residual_evaluation_time(summary.residual_evaluation_time_in_seconds),
+        jacobian_evaluation_time(summary.jacobian_evaluation_time_in_seconds),
+        linear_solver_time(summary.linear_solver_time_in_seconds) {
+        for (const ceres::IterationSummary& it : summary.iterations) {
+            iterations.push_back(iteration {it.iteration, it.cost, it.cost_change,
+                    it.step_is_successful, it.linear_solver_iterations,
+                    it.iteration_time_in_seconds, it.step_solver_time_in_seconds,
+                    it.cumulative_time_in_seconds});
+        }
+    }
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(solved), CEREAL_NVP(partial), CEREAL_NVP(termination),
+           CEREAL_NVP(num_parameters), CEREAL_NVP(num_residuals),
+           CEREAL_NVP(num_successful_steps), CEREAL_NVP(num_unsuccessful_steps),
+           CEREAL_NVP(initial_cost), CEREAL_NVP(final_cost),
+           CEREAL_NVP(preprocessor_time), CEREAL_NVP(minimizer_time),
+           CEREAL_NVP(postprocessor_time), CEREAL_NVP(total_time),
+           CEREAL_NVP(residual_evaluation_time), CEREAL_NVP(jacobian_evaluation_time),
+           CEREAL_NVP(linear_solver_time), CEREAL_NVP(iterations));
+    }
+
+    bool solved; // False until a solve has been recorded
+    bool partial; // Stopped by cancellation or a time budget before convergence
+    std::string termination;
+    int num_parameters;
+    int num_residuals;
+    int num_successful_steps;
+    int num_unsuccessful_steps;
+    double initial_cost;
+    double final_cost;
+    double preprocessor_time;
+    double minimizer_time;
+    double postprocessor_time;
+    double total_time;
+    double residual_evaluation_time;
+    double jacobian_evaluation_time;
+    double linear_solver_time;
+    std::vector<iteration> iterations;
+};
+
+// Sum of several solve records
+struct SolveTotals {
+    size_t solves = 0;
+    size_t iterations = 0;
+    double total_time = 0;
+    double preprocessor_time = 0;
+    double residual_evaluation_time = 0;
+    double jacobian_evaluation_time = 0;
+    double linear_solver_time = 0;
+    std::map<std::string, size_t> terminations;
+
+    void add(const SolveRecord& r) {
+        if (!r.solved) {
+            return;
+        }
+        solves++;
+        iterations += r.iterations.size();
+        total_time += r.total_time;
+        preprocessor_time += r.preprocessor_time;
+        residual_evaluation_time += r.residual_evaluation_time;
+        jacobian_evaluation_time += r.jacobian_evaluation_time;
+        linear_solver_time += r.linear_solver_time;
+        terminations[r.partial ? std::string("PARTIAL") : r.termination]++;
+    }
+
+    void add(const SolveTotals& t) {
+        solves += t.solves;
+        iterations += t.iterations;
+        total_time += t.total_time;
+        preprocessor_time += t.preprocessor_time;
+        residual_evaluation_time += t.residual_evaluation_time;
+        jacobian_evaluation_time += t.jacobian_evaluation_time;
+        linear_solver_time += t.linear_solver_time;
+        for (auto& it : t.terminations) {
+            terminations[it.first] += it.second;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <map>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <stdexcept>
+#include "camera_models.h"
+#include "synth.h"
+
+using std::vector;
+using std::array;
+
+// Ground size of one image at the flight altitude, along world x (image columns) and y (rows)
+static array<double, 2> footprint(const SynthOptions& options) {
+    const double scale = pixel_size(options.internal) / focal_length(options.internal.data()) * options.altitude;
+    return {{options.cols * scale, options.rows * scale}};
+}
+
+double synth_surface(const SynthOptions& options, double x, double y) {
+    const array<double, 2> size = footprint(options);
+    if (options.surface == "flat") {
+        return 0.0;
+    } else if (options.surface == "plane") {
+        return options.relief * (x / size[0] + y / size[1]);
+    } else if (options.surface == "hills") {
+        const double wavelength = size[0] / 2;
+        return options.relief * std::sin(2 * M_PI * x / wavelength) * std::cos(2 * M_PI * y / wavelength);
+    }
+    throw std::runtime_error("Unknown synthetic surface: " + options.surface);
+}
+
+SyntheticScene synthesize(const SynthOptions& options) {
+    if (options.cameras < 2 || options.strips < 1 || options.strips > options.cameras) {
+        throw std::runtime_error("Synthetic scene needs at least two cameras and one camera per strip.");
+    }
+
+    SyntheticScene scene;
+    scene.options = options;
+    std::mt19937 rng(options.seed);
+    std::normal_distribution<double> attitude(0.0, options.attitude_noise);
+    std::normal_distribution<double> noise(0.0, options.noise);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // Serpentine flight plan
+    const array<double, 2> size = footprint(options);
+    const double step_x = (1.0 - options.overlap) * size[0];
+    const double step_y = (1.0 - options.sidelap) * size[1];
+    const size_t per_strip = (options.cameras + options.strips - 1) / options.strips;
+    for (size_t c = 0; c < options.cameras; c++) {
+        const size_t strip = c / per_strip;
+        const size_t k = strip % 2 == 0 ? c % per_strip : per_strip - 1 - c % per_strip;
+        scene.cameras.push_back({{k * step_x, strip * step_y, options.altitude,
+                                  attitude(rng), attitude(rng), attitude(rng)}});
+    }
+
+    // Terrain over the flown area
+    const size_t strips = (options.cameras + per_strip - 1) / per_strip;
+    const double min_x = -size[0] / 2;
+    const double max_x = (per_strip - 1) * step_x + size[0] / 2;
+    const double min_y = -size[1] / 2;
+    const double max_y = (strips - 1) * step_y + size[1] / 2;
+    for (size_t p = 0; p < options.points; p++) {
+        const double x = min_x + uniform(rng) * (max_x - min_x);
+        const double y = min_y + uniform(rng) * (max_y - min_y);
+        scene.terrain.push_back({{x, y, synth_surface(options, x, y)}});
+    }
+
+    // Observe each point in every pair of cameras that see it
+    const double ps = pixel_size(options.internal);
+    std::map<std::pair<size_t, size_t>, SyntheticScene::edge> edges;
+    vector<std::pair<size_t, pixel_t>> seen;
+    for (size_t p = 0; p < scene.terrain.size(); p++) {
+        seen.clear();
+        for (size_t c = 0; c < scene.cameras.size(); c++) {
+            if (scene.cameras[c][2] <= scene.terrain[p][2]) {
+                continue;
+            }
+            double s[2];
+            pinhole_projection<double, double, double, double>(options.internal.data(), scene.cameras[c].data(), scene.terrain[p].data(), s);
+            pixel_t pix = sensor_t(s[0], s[1]).to_pixel(ps, options.rows, options.cols);
+            if (pix.i >= 0 && pix.i < options.rows && pix.j >= 0 && pix.j < options.cols) {
+                seen.push_back(std::make_pair(c, pix));
+            }
+        }
+
+        for (size_t a = 0; a < seen.size(); a++) {
+            for (size_t b = a + 1; b < seen.size(); b++) {
+                SyntheticScene::edge& e = edges[std::make_pair(seen[a].first, seen[b].first)];
+                e.cam_a = seen[a].first;
+                e.cam_b = seen[b].first;
+                e.points.push_back(p);
+                e.obs_a.push_back(pixel_t(seen[a].second.i + noise(rng), seen[a].second.j + noise(rng)));
+                const bool outlier = uniform(rng) < options.outliers;
+                e.outlier.push_back(outlier);
+                if (outlier) {
+                    e.obs_b.push_back(pixel_t(uniform(rng) * options.rows, uniform(rng) * options.cols));
+                } else {
+                    e.obs_b.push_back(pixel_t(seen[b].second.i + noise(rng), seen[b].second.j + noise(rng)));
+                }
+            }
+        }
+    }
+
+    // Edges ordered by camera pair, so edges[0] is (0, 1) when they overlap
+    for (auto& it : edges) {
+        if (it.second.points.size() >= options.min_shared) {
+            scene.edges.push_back(std::move(it.second));
+        }
+    }
+    return scene;
+}
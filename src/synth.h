@@ -0,0 +1,80 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cereal/cereal.hpp>
+#include <cereal/types/vector.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/string.hpp>
+#include "internal.h"
+#include "types.h"
+
+// Parameters of a synthetic scene
+// Cameras fly a serpentine over `strips` parallel lines at constant altitude,
+// looking down, with the given forward overlap and sidelap between footprints.
+// Terrain points are sampled uniformly over the flown area on a parametric
+// surface and observed through pinhole_projection with gaussian pixel noise.
+// A fraction of observations are replaced by uniformly random pixels (outliers).
+struct SynthOptions {
+    size_t cameras = 4;
+    size_t strips = 1;
+    double altitude = 269.0;
+    double overlap = 0.6;
+    double sidelap = 0.3;
+    double attitude_noise = 0.005; // Radians, standard deviation of camera angles
+    size_t points = 1000;
+    std::string surface = "hills"; // flat, plane or hills
+    double relief = 5.0; // Height amplitude of the surface
+    double noise = 0.5; // Pixels, standard deviation of observations
+    double outliers = 0.0; // Fraction of observations that are outliers
+    size_t min_shared = 8; // Fewer shared points don't make an edge
+    unsigned seed = 1;
+    internal_t internal {{48.3355e-3, 0.0093e-3, -0.0276e-3, 0.0085e-3}};
+    double rows = 2832;
+    double cols = 4256;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(cameras), CEREAL_NVP(strips), CEREAL_NVP(altitude),
+           CEREAL_NVP(overlap), CEREAL_NVP(sidelap), CEREAL_NVP(attitude_noise),
+           CEREAL_NVP(points), CEREAL_NVP(surface), CEREAL_NVP(relief),
+           CEREAL_NVP(noise), CEREAL_NVP(outliers), CEREAL_NVP(min_shared),
+           CEREAL_NVP(seed), CEREAL_NVP(internal), CEREAL_NVP(rows), CEREAL_NVP(cols));
+    }
+};
+
+// Generated scene with its ground truth
+struct SyntheticScene {
+    // Pair of cameras seeing common points
+    struct edge {
+        size_t cam_a, cam_b;
+        std::vector<size_t> points; // Index in terrain of each observation
+        std::vector<bool> outlier; // True where obs_b was replaced by a random pixel
+        std::vector<pixel_t> obs_a, obs_b; // Not part of the ground truth file
+
+        template <class Archive>
+        void serialize(Archive& ar) {
+            ar(CEREAL_NVP(cam_a), CEREAL_NVP(cam_b), CEREAL_NVP(points), CEREAL_NVP(outlier));
+        }
+    };
+
+    SynthOptions options;
+    std::vector<std::array<double, 6>> cameras;
+    std::vector<std::array<double, 3>> terrain;
+    std::vector<edge> edges;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(CEREAL_NVP(options), CEREAL_NVP(cameras), CEREAL_NVP(terrain), CEREAL_NVP(edges));
+    }
+};
+
+// Height of the scene's surface at (x, y)
+double synth_surface(const SynthOptions& options, double x, double y);
+
+// Deterministic for a given seed
+SyntheticScene synthesize(const SynthOptions& options);
+
+#endif
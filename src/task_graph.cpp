@@ -0,0 +1,105 @@
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <condition_variable>
+#include "task_graph.h"
+
+using std::vector;
+using std::string;
+
+TaskGraph::task_id TaskGraph::add(const string& name,
+                                  std::function<void ()> work,
+                                  const vector<task_id>& dependencies) {
+    const task_id id = tasks.size();
+    for (task_id dep : dependencies) {
+        if (dep >= id) {
+            throw std::runtime_error("Task " + name + " depends on a task added after it.");
+        }
+        tasks[dep].dependents.push_back(id);
+    }
+    tasks.push_back(task {name, work, vector<task_id>(), dependencies.size(), pending});
+    return id;
+}
+
+void TaskGraph::run(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<task_id> ready;
+    size_t unfinished = tasks.size();
+    std::exception_ptr first_error;
+
+    for (task_id id = 0; id < tasks.size(); id++) {
+        if (tasks[id].waiting_for == 0) {
+            ready.push_back(id);
+        }
+    }
+
+    // Mark everything downstream of a failed task as skipped
+    // Called with the mutex held
+    std::function<void (task_id)> skip_dependents = [&](task_id id) {
+        for (task_id dep : tasks[id].dependents) {
+            if (tasks[dep].status == pending) {
+                tasks[dep].status = skipped;
+                unfinished--;
+                skip_dependents(dep);
+            }
+        }
+    };
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            changed.wait(lock, [&]() { return !ready.empty() || unfinished == 0; });
+            if (ready.empty()) {
+                return;
+            }
+            task_id id = ready.front();
+            ready.pop_front();
+
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                tasks[id].work();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            unfinished--;
+            if (error) {
+                tasks[id].status = failed;
+                if (!first_error) {
+                    first_error = error;
+                }
+                skip_dependents(id);
+            } else {
+                tasks[id].status = done;
+                for (task_id dep : tasks[id].dependents) {
+                    if (tasks[dep].status == pending && --tasks[dep].waiting_for == 0) {
+                        ready.push_back(dep);
+                    }
+                }
+            }
+            changed.notify_all();
+        }
+    };
+
+    vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <exception>
+
+// Set of tasks with dependencies, run on a pool of threads
+// A task starts as soon as all of its dependencies are done
+class TaskGraph {
+public:
+    typedef size_t task_id;
+    enum task_status { pending, done, failed, skipped };
+
+    // Dependencies must have been added before
+    task_id add(const std::string& name,
+                std::function<void ()> work,
+                const std::vector<task_id>& dependencies = std::vector<task_id>());
+
+    // Run all tasks, ready tasks start in the order they were added
+    // Tasks depending on a failed one are skipped, and the first error
+    // is rethrown once running tasks have finished
+    // num_threads == 0 uses the hardware concurrency
+    void run(size_t num_threads = 0);
+
+    size_t size() const { return tasks.size(); }
+    const std::string& name(task_id id) const { return tasks.at(id).name; }
+    task_status status(task_id id) const { return tasks.at(id).status; }
+
+private:
+    struct task {
+        std::string name;
+        std::function<void ()> work;
+        std::vector<task_id> dependents;
+        size_t waiting_for; // Number of unfinished dependencies
+        task_status status;
+    };
+    std::vector<task> tasks;
+};
+
+#endif
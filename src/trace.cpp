@@ -0,0 +1,114 @@
+#include <map>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include "trace.h"
+
+using std::vector;
+using std::string;
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::enable() {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (auto& buffer : buffers) {
+        std::lock_guard<std::mutex> buffer_guard(buffer->mutex);
+        buffer->events.clear();
+    }
+    origin = clock::now();
+    is_enabled = true;
+}
+
+void Tracer::disable() {
+    is_enabled = false;
+}
+
+Tracer::thread_buffer& Tracer::local_buffer() {
+    thread_local thread_buffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> guard(mutex);
+        buffers.push_back(std::make_shared<thread_buffer>());
+        buffer = buffers.back().get();
+    }
+    return *buffer;
+}
+
+void Tracer::record(const char* name, int64_t start, int64_t end) {
+    thread_buffer& buffer = local_buffer();
+    // Only contended while events are being exported
+    std::lock_guard<std::mutex> guard(buffer.mutex);
+    buffer.events.push_back(event {name, start, end - start});
+}
+
+vector<vector<Tracer::event>> Tracer::events() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    vector<vector<event>> result;
+    for (auto& buffer : buffers) {
+        std::lock_guard<std::mutex> buffer_guard(buffer->mutex);
+        if (!buffer->events.empty()) {
+            result.push_back(buffer->events);
+        }
+    }
+    return result;
+}
+
+void Tracer::write_chrome_trace(const string& filename) const {
+    std::ofstream ofs(filename);
+    if (!ofs.good()) {
+        throw std::runtime_error("Can't open " + filename);
+    }
+
+    // Complete events, with times in microseconds
+    ofs << std::fixed << std::setprecision(3);
+    ofs << "{\"traceEvents\": [\n";
+    bool first = true;
+    const vector<vector<event>> threads = events();
+    for (size_t tid = 0; tid < threads.size(); tid++) {
+        for (const event& e : threads[tid]) {
+            ofs << (first ? "" : ",\n")
+                << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+                << ", \"ts\": " << e.start / 1e3 << ", \"dur\": " << e.duration / 1e3 << "}";
+            first = false;
+        }
+    }
+    ofs << "\n], \"displayTimeUnit\": \"ms\"}\n";
+}
+
+void Tracer::write_summary(std::ostream& os) const {
+    struct stats {
+        size_t count = 0;
+        int64_t total = 0;
+        int64_t max = 0;
+    };
+    std::map<string, stats> by_name;
+    for (auto& thread : events()) {
+        for (const event& e : thread) {
+            stats& s = by_name[e.name];
+            s.count++;
+            s.total += e.duration;
+            s.max = std::max(s.max, e.duration);
+        }
+    }
+
+    vector<std::pair<string, stats>> rows(by_name.begin(), by_name.end());
+    std::sort(rows.begin(), rows.end(), [](const std::pair<string, stats>& a, const std::pair<string, stats>& b) {
+        return a.second.total > b.second.total;
+    });
+
+    os << std::left << std::setw(28) << "scope" << std::right
+       << std::setw(10) << "count" << std::setw(14) << "total (ms)"
+       << std::setw(14) << "mean (ms)" << std::setw(14) << "max (ms)" << "\n";
+    os << std::fixed << std::setprecision(3);
+    for (auto& row : rows) {
+        os << std::left << std::setw(28) << row.first << std::right
+           << std::setw(10) << row.second.count
+           << std::setw(14) << row.second.total / 1e6
+           << std::setw(14) << row.second.total / 1e6 / row.second.count
+           << std::setw(14) << row.second.max / 1e6 << "\n";
+    }
+    os.flush();
+}
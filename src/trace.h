@@ -0,0 +1,99 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include "memory_report.h"
+
+// Records how long scopes of the pipeline take, see TRACE_SCOPE
+// Each thread appends to its own buffer, and when tracing is off a scope
+// costs a single relaxed atomic load.
+// Events can be exported in Chrome's trace event format (chrome://tracing)
+// and summarized per scope name.
+class Tracer {
+public:
+    struct event {
+        const char* name; // Must be a string literal
+        int64_t start; // Nanoseconds since enable()
+        int64_t duration;
+    };
+
+    static Tracer& instance();
+
+    // Tracing is off by default
+    // Enabling clears previously recorded events
+    void enable();
+    void disable();
+    bool enabled() const { return is_enabled.load(std::memory_order_relaxed); }
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - origin).count();
+    }
+    void record(const char* name, int64_t start, int64_t end);
+
+    // Events of each thread, in order of the threads' first event
+    std::vector<std::vector<event>> events() const;
+
+    void write_chrome_trace(const std::string& filename) const;
+    // Count, total, mean and max time per scope name, by decreasing total
+    void write_summary(std::ostream& os) const;
+
+private:
+    typedef std::chrono::steady_clock clock;
+    struct thread_buffer {
+        std::mutex mutex;
+        std::vector<event> events;
+    };
+
+    Tracer() : is_enabled(false) {}
+    thread_buffer& local_buffer();
+
+    std::atomic<bool> is_enabled;
+    clock::time_point origin;
+    mutable std::mutex mutex;
+    // Never removed so that threads can keep a pointer to theirs
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+};
+
+// Records the lifetime of the object as an event
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) :
+        name(Tracer::instance().enabled() ? name : nullptr),
+        start(this->name ? Tracer::instance().now() : 0),
+        memory(name) {}
+
+    ~TraceScope() {
+        end();
+    }
+
+    // Record the event now instead of at the end of the scope
+    void end() {
+        if (name) {
+            Tracer::instance().record(name, start, Tracer::instance().now());
+            name = nullptr;
+        }
+        memory.end();
+    }
+
+private:
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    const char* name;
+    int64_t start;
+    // Scopes are also the stages of the memory report
+    MemoryScope memory;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+// Trace the enclosing scope under name, a string literal
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#endif
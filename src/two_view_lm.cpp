@@ -0,0 +1,387 @@
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include "two_view_lm.h"
+#include "camera_models.h"
+#include "trace.h"
+
+using std::vector;
+using std::array;
+
+typedef Eigen::Matrix<double, 6, 6> matrix6;
+typedef Eigen::Matrix<double, 6, 1> vector6;
+// Stored per point in vectors, so without alignment requirements
+typedef Eigen::Matrix<double, 2, 2, Eigen::DontAlign> matrix2;
+typedef Eigen::Matrix<double, 2, 1, Eigen::DontAlign> vector2;
+typedef Eigen::Matrix<double, 6, 2, Eigen::DontAlign> matrix62;
+typedef Eigen::Matrix<double, 2, 6, Eigen::DontAlign> matrix26;
+
+// Blocks of the normal equations that belong to one point
+struct point_block {
+    matrix2 V; // Point block of J^T J
+    matrix62 W; // Camera-point block of J^T J
+    vector2 g; // Point part of the gradient J^T r
+};
+
+// Bounds of the LM diagonal, as ceres
+static const double min_lm_diagonal = 1e-6;
+static const double max_lm_diagonal = 1e32;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Infinite if a projection fails, which fails the step as ceres does
+static double cost(const double* internal, const double* fixed_camera, const double* camera,
+                   const vector<sensor_t>& observed_fixed, const vector<sensor_t>& observed,
+                   const vector<array<double, 2>>& points) {
+    double sum = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        double ra[2], rb[2];
+        if (!model0_projection<double, double>(internal, fixed_camera, points[i].data(), ra) ||
+            !model0_projection<double, double>(internal, camera, points[i].data(), rb)) {
+            return std::numeric_limits<double>::infinity();
+        }
+        const double dxa = ra[0] - observed_fixed[i].x, dya = ra[1] - observed_fixed[i].y;
+        const double dxb = rb[0] - observed[i].x, dyb = rb[1] - observed[i].y;
+        sum += dxa * dxa + dya * dya + dxb * dxb + dyb * dyb;
+    }
+    return 0.5 * sum;
+}
+
+// Accumulate the normal equations and the cost at the given parameters
+// Returns false if a projection fails, leaving the normal equations partial
+static bool linearize(const double* internal, const double* fixed_camera, const double* camera,
+                      const vector<sensor_t>& observed_fixed, const vector<sensor_t>& observed,
+                      const vector<array<double, 2>>& points,
+                      matrix6& U, vector6& g_camera, vector<point_block>& blocks, double& cost) {
+    typedef ceres::Jet<double, 2> jet2;
+    typedef ceres::Jet<double, 8> jet8;
+    U.setZero();
+    g_camera.setZero();
+    double sum = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        // Fixed camera, derivatives by the point only
+        const jet2 point_a[2] = {jet2(points[i][0], 0), jet2(points[i][1], 1)};
+        jet2 ra[2];
+        if (!model0_projection<jet2, double>(internal, fixed_camera, point_a, ra)) {
+            return false;
+        }
+
+        // Free camera, derivatives by the camera then the point
+        jet8 camera_b[6];
+        for (int k = 0; k < 6; k++) {
+            camera_b[k] = jet8(camera[k], k);
+        }
+        const jet8 point_b[2] = {jet8(points[i][0], 6), jet8(points[i][1], 7)};
+        jet8 rb[2];
+        if (!model0_projection<jet8, jet8>(internal, camera_b, point_b, rb)) {
+            return false;
+        }
+
+        matrix2 Pa, Pb;
+        matrix26 C;
+        vector2 res_a(ra[0].a - observed_fixed[i].x, ra[1].a - observed_fixed[i].y);
+        vector2 res_b(rb[0].a - observed[i].x, rb[1].a - observed[i].y);
+        for (int k = 0; k < 2; k++) {
+            Pa.row(k) = ra[k].v.transpose();
+            C.row(k) = rb[k].v.template head<6>().transpose();
+            Pb.row(k) = rb[k].v.template tail<2>().transpose();
+        }
+
+        U.noalias() += C.transpose() * C;
+        g_camera.noalias() += C.transpose() * res_b;
+        point_block& b = blocks[i];
+        b.V.noalias() = Pa.transpose() * Pa + Pb.transpose() * Pb;
+        b.W.noalias() = C.transpose() * Pb;
+        b.g.noalias() = Pa.transpose() * res_a + Pb.transpose() * res_b;
+        sum += res_a.squaredNorm() + res_b.squaredNorm();
+    }
+    cost = 0.5 * sum;
+    return true;
+}
+
+static double gradient_max_norm(const vector6& g_camera, const vector<point_block>& blocks) {
+    double norm = g_camera.lpNorm<Eigen::Infinity>();
+    for (auto& b : blocks) {
+        norm = std::max(norm, b.g.lpNorm<Eigen::Infinity>());
+    }
+    return norm;
+}
+
+// LM step of damping mu by the Schur complement over the point blocks
+// Returns false if the reduced camera system can't be solved
+static bool solve_step(const matrix6& U, const vector6& g_camera, const vector<point_block>& blocks, double mu,
+                       vector<matrix2>& V_inverse, vector6& step_camera, vector<vector2>& step_points,
+                       double& model_decrease) {
+    auto damping = [mu](double d) { return mu * std::min(std::max(d, min_lm_diagonal), max_lm_diagonal); };
+
+    // S = U - sum W V^-1 W^T, rhs = -g_c + sum W V^-1 g_p
+    matrix6 S = U;
+    for (int k = 0; k < 6; k++) {
+        S(k, k) += damping(U(k, k));
+    }
+    vector6 rhs = -g_camera;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const point_block& b = blocks[i];
+        matrix2 V = b.V;
+        V(0, 0) += damping(b.V(0, 0));
+        V(1, 1) += damping(b.V(1, 1));
+        V_inverse[i] = V.inverse();
+        const matrix62 WV = b.W * V_inverse[i];
+        S.noalias() -= WV * b.W.transpose();
+        rhs.noalias() += WV * b.g;
+    }
+
+    Eigen::LDLT<matrix6> ldlt(S);
+    if (ldlt.info() != Eigen::Success) {
+        return false;
+    }
+    step_camera = ldlt.solve(rhs);
+
+    // Back substitution, and the decrease predicted by the linear model:
+    // -g.d - d^T J^T J d / 2 = (-g.d + mu d^T D d) / 2
+    double g_dot = g_camera.dot(step_camera);
+    double damped = 0;
+    for (int k = 0; k < 6; k++) {
+        damped += damping(U(k, k)) * step_camera(k) * step_camera(k);
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const point_block& b = blocks[i];
+        step_points[i] = V_inverse[i] * (-b.g - b.W.transpose() * step_camera);
+        g_dot += b.g.dot(step_points[i]);
+        damped += damping(b.V(0, 0)) * step_points[i](0) * step_points[i](0)
+                + damping(b.V(1, 1)) * step_points[i](1) * step_points[i](1);
+    }
+    model_decrease = 0.5 * (damped - g_dot);
+    return std::isfinite(model_decrease);
+}
+
+void two_view_lm(const ceres::Solver::Options& options,
+                 const double* internal,
+                 const double* fixed_camera,
+                 double* camera,
+                 const vector<sensor_t>& observed_fixed,
+                 const vector<sensor_t>& observed,
+                 vector<array<double, 2>>& points,
+                 ceres::Solver::Summary* summary) {
+    TRACE_SCOPE("two_view_lm");
+    if (observed_fixed.size() != points.size() || observed.size() != points.size()) {
+        throw std::runtime_error("two_view_lm: observations and points have different sizes");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const size_t n = points.size();
+
+    *summary = ceres::Solver::Summary();
+    summary->minimizer_type = ceres::TRUST_REGION;
+    summary->trust_region_strategy_type = ceres::LEVENBERG_MARQUARDT;
+    summary->linear_solver_type_given = options.linear_solver_type;
+    summary->linear_solver_type_used = ceres::DENSE_SCHUR;
+    summary->num_parameter_blocks = static_cast<int>(n + 1);
+    summary->num_parameters = static_cast<int>(6 + 2 * n);
+    summary->num_effective_parameters = summary->num_parameters;
+    summary->num_residual_blocks = static_cast<int>(2 * n);
+    summary->num_residuals = static_cast<int>(4 * n);
+    summary->num_threads_given = options.num_threads;
+    summary->num_threads_used = 1;
+
+    matrix6 U;
+    vector6 g_camera;
+    vector<point_block> blocks(n);
+    vector<matrix2> V_inverse(n);
+    vector6 step_camera;
+    vector<vector2> step_points(n);
+    array<double, 6> trial_camera;
+    vector<array<double, 2>> trial_points(n);
+
+    double mu = 1.0 / options.initial_trust_region_radius;
+    double nu = 2.0;
+    double jacobian_time = 0, residual_time = 0, linear_solver_time = 0;
+
+    auto now = std::chrono::steady_clock::now();
+    double current_cost = 0;
+    const bool evaluated = linearize(internal, fixed_camera, camera, observed_fixed, observed, points,
+                                     U, g_camera, blocks, current_cost);
+    jacobian_time += seconds_since(now);
+    if (!evaluated) {
+        summary->termination_type = ceres::FAILURE;
+        summary->message = "Residual and Jacobian evaluation failed at the initial parameters.";
+        summary->jacobian_evaluation_time_in_seconds = jacobian_time;
+        summary->minimizer_time_in_seconds = seconds_since(start);
+        summary->total_time_in_seconds = summary->minimizer_time_in_seconds;
+        return;
+    }
+    summary->initial_cost = current_cost;
+
+    if (options.minimizer_progress_to_stdout) {
+        std::printf("iter      cost      cost_change  |gradient|   |step|    tr_ratio  tr_radius  ls_iter  iter_time  total_time\n");
+    }
+
+    ceres::IterationSummary iteration;
+    iteration.iteration = 0;
+    iteration.cost = current_cost;
+    iteration.gradient_max_norm = gradient_max_norm(g_camera, blocks);
+    iteration.trust_region_radius = 1.0 / mu;
+    iteration.iteration_time_in_seconds = iteration.cumulative_time_in_seconds = seconds_since(start);
+
+    // Iteration loop, each round records and reports the last iteration then takes a step
+    bool relinearize = false;
+    double last_iteration_start = 0;
+    for (;;) {
+        if (relinearize) {
+            // Normal equations of the current parameters, after a step that failed to linearize
+            double relinearized_cost;
+            now = std::chrono::steady_clock::now();
+            const bool restored = linearize(internal, fixed_camera, camera, observed_fixed, observed, points,
+                                            U, g_camera, blocks, relinearized_cost);
+            jacobian_time += seconds_since(now);
+            if (!restored) {
+                summary->termination_type = ceres::FAILURE;
+                summary->message = "Residual and Jacobian evaluation failed.";
+                break;
+            }
+            relinearize = false;
+        }
+        iteration.cumulative_time_in_seconds = seconds_since(start);
+        iteration.iteration_time_in_seconds = iteration.cumulative_time_in_seconds - last_iteration_start;
+        summary->iterations.push_back(iteration);
+
+        if (options.minimizer_progress_to_stdout) {
+            std::printf("% 4d % 8e   % 3.2e   % 3.2e  % 3.2e  % 3.2e % 3.2e     % 4d   % 3.2e   % 3.2e\n",
+                        iteration.iteration, iteration.cost, iteration.cost_change, iteration.gradient_max_norm,
+                        iteration.step_norm, iteration.relative_decrease, iteration.trust_region_radius,
+                        iteration.linear_solver_iterations, iteration.iteration_time_in_seconds,
+                        iteration.cumulative_time_in_seconds);
+        }
+
+        bool stop = false;
+        for (ceres::IterationCallback* callback : options.callbacks) {
+            const ceres::CallbackReturnType result = (*callback)(iteration);
+            if (result == ceres::SOLVER_TERMINATE_SUCCESSFULLY) {
+                summary->termination_type = ceres::USER_SUCCESS;
+                summary->message = "User callback returned SOLVER_TERMINATE_SUCCESSFULLY.";
+                stop = true;
+                break;
+            } else if (result == ceres::SOLVER_ABORT) {
+                summary->termination_type = ceres::USER_FAILURE;
+                summary->message = "User callback returned SOLVER_ABORT.";
+                stop = true;
+                break;
+            }
+        }
+        if (stop) {
+            break;
+        }
+
+        // Termination tests on the last iteration
+        if (iteration.gradient_max_norm <= options.gradient_tolerance) {
+            summary->termination_type = ceres::CONVERGENCE;
+            summary->message = "Gradient tolerance reached.";
+            break;
+        }
+        if (iteration.iteration > 0 && iteration.step_is_successful &&
+            std::abs(iteration.cost_change) <= options.function_tolerance * (current_cost + iteration.cost_change)) {
+            summary->termination_type = ceres::CONVERGENCE;
+            summary->message = "Function tolerance reached.";
+            break;
+        }
+        if (iteration.iteration >= options.max_num_iterations) {
+            summary->termination_type = ceres::NO_CONVERGENCE;
+            summary->message = "Maximum number of iterations reached.";
+            break;
+        }
+        if (iteration.cumulative_time_in_seconds >= options.max_solver_time_in_seconds) {
+            summary->termination_type = ceres::NO_CONVERGENCE;
+            summary->message = "Maximum solver time reached.";
+            break;
+        }
+        if (mu > 1.0 / options.min_trust_region_radius) {
+            summary->termination_type = ceres::CONVERGENCE;
+            summary->message = "Minimum trust region radius reached.";
+            break;
+        }
+
+        // Next iteration
+        last_iteration_start = seconds_since(start);
+        iteration.iteration++;
+        iteration.linear_solver_iterations = 1;
+        now = std::chrono::steady_clock::now();
+        double model_decrease = 0;
+        const bool solved = solve_step(U, g_camera, blocks, mu, V_inverse, step_camera, step_points, model_decrease);
+        iteration.step_solver_time_in_seconds = seconds_since(now);
+        linear_solver_time += iteration.step_solver_time_in_seconds;
+
+        double step_squared = step_camera.squaredNorm(), x_squared = 0;
+        for (int k = 0; k < 6; k++) {
+            x_squared += camera[k] * camera[k];
+        }
+        for (size_t i = 0; i < n; i++) {
+            step_squared += step_points[i].squaredNorm();
+            x_squared += points[i][0] * points[i][0] + points[i][1] * points[i][1];
+        }
+        iteration.step_norm = std::sqrt(step_squared);
+        if (solved && iteration.step_norm <= options.parameter_tolerance * (std::sqrt(x_squared) + options.parameter_tolerance)) {
+            summary->termination_type = ceres::CONVERGENCE;
+            summary->message = "Parameter tolerance reached.";
+            break;
+        }
+
+        double trial_cost = std::numeric_limits<double>::infinity();
+        if (solved && model_decrease > 0) {
+            for (int k = 0; k < 6; k++) {
+                trial_camera[k] = camera[k] + step_camera(k);
+            }
+            for (size_t i = 0; i < n; i++) {
+                trial_points[i][0] = points[i][0] + step_points[i](0);
+                trial_points[i][1] = points[i][1] + step_points[i](1);
+            }
+            now = std::chrono::steady_clock::now();
+            trial_cost = cost(internal, fixed_camera, trial_camera.data(), observed_fixed, observed, trial_points);
+            residual_time += seconds_since(now);
+        }
+
+        const double rho = std::isfinite(trial_cost) ? (current_cost - trial_cost) / model_decrease : -1.0;
+        iteration.relative_decrease = rho;
+        bool accept = rho > options.min_relative_decrease;
+        if (accept) {
+            // Normal equations of the next iteration, the step fails if a projection does
+            double trial_linearized_cost;
+            now = std::chrono::steady_clock::now();
+            accept = linearize(internal, fixed_camera, trial_camera.data(), observed_fixed, observed, trial_points,
+                               U, g_camera, blocks, trial_linearized_cost);
+            jacobian_time += seconds_since(now);
+            relinearize = !accept;
+        }
+        if (accept) {
+            // Accept, and grow the trust region as ceres' LM
+            std::copy(trial_camera.begin(), trial_camera.end(), camera);
+            points.swap(trial_points);
+            iteration.step_is_successful = true;
+            iteration.cost_change = current_cost - trial_cost;
+            current_cost = trial_cost;
+            summary->num_successful_steps++;
+            mu *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3));
+            mu = std::max(mu, 1.0 / options.max_trust_region_radius);
+            nu = 2.0;
+            iteration.gradient_max_norm = gradient_max_norm(g_camera, blocks);
+        } else {
+            iteration.step_is_successful = false;
+            iteration.cost_change = 0;
+            summary->num_unsuccessful_steps++;
+            mu *= nu;
+            nu *= 2.0;
+        }
+        iteration.cost = current_cost;
+        iteration.trust_region_radius = 1.0 / mu;
+    }
+
+    summary->final_cost = current_cost;
+    summary->jacobian_evaluation_time_in_seconds = jacobian_time;
+    summary->residual_evaluation_time_in_seconds = residual_time;
+    summary->linear_solver_time_in_seconds = linear_solver_time;
+    summary->minimizer_time_in_seconds = seconds_since(start);
+    summary->total_time_in_seconds = summary->minimizer_time_in_seconds;
+}
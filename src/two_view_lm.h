@@ -0,0 +1,31 @@
+#ifndef TWO_VIEW_LM_H
+#define TWO_VIEW_LM_H
+
+#include <vector>
+#include <array>
+#include "ceres/ceres.h"
+#include "types.h"
+
+// Levenberg-Marquardt for Model0's problem: one fixed camera, one free 6 dof camera
+// and N ground points of 2 dof, each observed once by both cameras
+// The normal equations are a 6x6 camera block, N 2x2 point blocks and their 6x2
+// couplings. They are accumulated in place from the jacobians of each point and
+// reduced to the camera block by an explicit Schur complement, so that a step
+// costs O(N) with no sparse matrix.
+//
+// Follows the ceres conventions so that models can swap it in for ceres::Solve:
+// cost is half the squared norm of residuals, options provides max_num_iterations,
+// the tolerances, initial_trust_region_radius, minimizer_progress_to_stdout and
+// the callbacks, which are called with the parameters updated at every iteration,
+// and the summary is filled as ceres does. A projection failing at a trial point
+// fails that step, and at the initial point the solve, as in ceres.
+void two_view_lm(const ceres::Solver::Options& options,
+                 const double* internal,
+                 const double* fixed_camera,
+                 double* camera,
+                 const std::vector<sensor_t>& observed_fixed,
+                 const std::vector<sensor_t>& observed,
+                 std::vector<std::array<double, 2>>& points,
+                 ceres::Solver::Summary* summary);
+
+#endif
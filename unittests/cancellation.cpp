@@ -0,0 +1,54 @@
+#include <thread>
+#include <chrono>
+#include "gtest/gtest.h"
+#include "../src/cancellation.h"
+
+TEST(Cancellation, CancelAndReset) {
+    CancellationToken token;
+    EXPECT_FALSE(token.cancelled());
+    token.cancel();
+    EXPECT_TRUE(token.cancelled());
+    token.reset();
+    EXPECT_FALSE(token.cancelled());
+}
+
+TEST(Cancellation, BudgetExpires) {
+    CancellationToken token;
+    token.set_budget(0.02);
+    EXPECT_FALSE(token.cancelled());
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    EXPECT_TRUE(token.cancelled());
+
+    // No budget
+    token.set_budget(0);
+    EXPECT_FALSE(token.cancelled());
+}
+
+TEST(Cancellation, CancelFromOtherThread) {
+    CancellationToken token;
+    std::thread worker([&token]() { token.cancel(); });
+    worker.join();
+    EXPECT_TRUE(token.cancelled());
+}
+
+TEST(Cancellation, CommandTokenPerThread) {
+    CancellationToken request;
+    {
+        CommandTokenScope scope(request);
+        EXPECT_EQ(&CancellationToken::command(), &request);
+        request.cancel();
+        EXPECT_TRUE(CancellationToken::command().cancelled());
+
+        // Other threads keep their own command token
+        bool other_cancelled = true;
+        std::thread other([&other_cancelled]() {
+            CancellationToken own;
+            CommandTokenScope scope(own);
+            other_cancelled = CancellationToken::command().cancelled();
+        });
+        other.join();
+        EXPECT_FALSE(other_cancelled);
+        EXPECT_FALSE(CancellationToken::process().cancelled());
+    }
+    EXPECT_EQ(&CancellationToken::command(), &CancellationToken::process());
+}
@@ -0,0 +1,81 @@
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include "gtest/gtest.h"
+#include "../src/dem.h"
+
+using std::vector;
+using std::array;
+
+vector<array<double, 3>> random_plane(size_t n, double a, double b, double c) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> uniform(-50.0, 50.0);
+    vector<array<double, 3>> points(n);
+    for (auto& p : points) {
+        p[0] = uniform(rng);
+        p[1] = uniform(rng);
+        p[2] = a*p[0] + b*p[1] + c;
+    }
+    return points;
+}
+
+TEST(TerrainIndex, NearestMatchesBruteForce) {
+    vector<array<double, 3>> points = random_plane(2000, 0.0, 0.0, 0.0);
+    TerrainIndex index(points);
+    const size_t k = 7;
+
+    const double queries[][2] = {{0, 0}, {-49, 49}, {12.5, -3.25}, {80, 80}, {-120, 3}};
+    for (auto& q : queries) {
+        vector<size_t> all(points.size());
+        for (size_t n = 0; n < all.size(); n++) all[n] = n;
+        auto d2 = [&](size_t n) {
+            return std::pow(points[n][0] - q[0], 2) + std::pow(points[n][1] - q[1], 2);
+        };
+        std::sort(all.begin(), all.end(), [&](size_t a, size_t b) { return d2(a) < d2(b); });
+
+        vector<size_t> result = index.nearest(q[0], q[1], k);
+        ASSERT_EQ(result.size(), k);
+        for (size_t n = 0; n < k; n++) {
+            EXPECT_DOUBLE_EQ(d2(result[n]), d2(all[n]));
+        }
+    }
+}
+
+TEST(TerrainIndex, FewerPointsThanNeighbours) {
+    vector<array<double, 3>> points {{{0, 0, 1}}, {{1, 1, 2}}};
+    TerrainIndex index(points);
+    EXPECT_EQ(index.nearest(0.1, 0.1, 8).size(), 2u);
+    EXPECT_EQ(index.nearest(0.1, 0.1, 8)[0], 0u);
+}
+
+TEST(DEM, ConstantTerrain) {
+    vector<array<double, 3>> points = random_plane(500, 0.0, 0.0, 12.0);
+    DEM dem = DEM::from_terrain(points, 2.0, IDWParameters(), 3);
+    ASSERT_GT(dem.rows, 0u);
+    ASSERT_GT(dem.cols, 0u);
+    for (double h : dem.heights) {
+        EXPECT_NEAR(h, 12.0, 1e-9);
+    }
+    EXPECT_NEAR(dem.elevation_at(dem.origin_x + 3.3, dem.origin_y - 7.1), 12.0, 1e-9);
+    EXPECT_TRUE(std::isnan(dem.elevation_at(dem.origin_x - 1.0, dem.origin_y)));
+}
+
+TEST(DEM, SlopedTerrain) {
+    vector<array<double, 3>> points = random_plane(5000, 0.1, -0.05, 3.0);
+    DEM dem = DEM::from_terrain(points, 1.0);
+    // IDW flattens the plane a little, compare away from the borders
+    for (double x = -30; x < 30; x += 7.3) {
+        for (double y = -30; y < 30; y += 6.1) {
+            EXPECT_NEAR(dem.elevation_at(x, y), 0.1*x - 0.05*y + 3.0, 0.1);
+        }
+    }
+}
+
+TEST(DEM, MaxDistanceLeavesNoData) {
+    vector<array<double, 3>> points {{{0, 0, 1}}, {{100, 100, 1}}};
+    IDWParameters params;
+    params.max_distance = 5.0;
+    DEM dem = DEM::from_terrain(points, 10.0, params);
+    EXPECT_DOUBLE_EQ(dem.at(dem.rows - 1, 0), 1.0);
+    EXPECT_TRUE(std::isnan(dem.at(dem.rows/2, dem.cols/2)));
+}
@@ -0,0 +1,82 @@
+#include <vector>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "../src/descriptor_compression.h"
+
+using std::vector;
+
+// Descriptors spread along a few directions, as PCA expects
+static cv::Mat correlated_descriptors(int count, int length, int seed) {
+    cv::RNG rng(seed);
+    cv::Mat basis(4, length, CV_32F);
+    rng.fill(basis, cv::RNG::UNIFORM, -1.0, 1.0);
+    cv::Mat weights(count, 4, CV_32F);
+    rng.fill(weights, cv::RNG::NORMAL, 0.0, 10.0);
+    cv::Mat noise(count, length, CV_32F);
+    rng.fill(noise, cv::RNG::NORMAL, 0.0, 0.1);
+    cv::Mat descriptors = weights * basis + noise;
+    return descriptors;
+}
+
+TEST(DescriptorCompression, Dimensions) {
+    const cv::Mat samples = correlated_descriptors(500, 128, 1);
+    DescriptorCompressor compressor(32);
+    EXPECT_FALSE(compressor.trained());
+    compressor.train(samples);
+    ASSERT_TRUE(compressor.trained());
+    EXPECT_EQ(compressor.length, 128);
+
+    const cv::Mat compressed = compressor.compress(samples);
+    EXPECT_EQ(compressed.type(), CV_8S);
+    EXPECT_EQ(compressed.rows, samples.rows);
+    EXPECT_EQ(compressed.cols, 32);
+
+    const cv::Mat projected = compressor.decompress(compressed);
+    EXPECT_EQ(projected.type(), CV_32F);
+    EXPECT_EQ(projected.cols, 32);
+
+    EXPECT_THROW(compressor.compress(cv::Mat::zeros(1, 64, CV_32F)), std::runtime_error);
+    EXPECT_THROW(DescriptorCompressor(32).compress(samples), std::runtime_error);
+}
+
+TEST(DescriptorCompression, QuantizationErrorBound) {
+    const cv::Mat samples = correlated_descriptors(500, 128, 2);
+    DescriptorCompressor compressor(8);
+    compressor.train(samples);
+    const cv::Mat projected = compressor.decompress(compressor.compress(samples));
+
+    // Unquantized projection on the principal components, to within half a
+    // quantization step unless it saturates int8
+    const float step = 1.0f / compressor.scale;
+    size_t saturated = 0;
+    for (int r = 0; r < samples.rows; r++) {
+        for (int k = 0; k < compressor.dims; k++) {
+            float exact = 0.0f;
+            for (int i = 0; i < compressor.length; i++) {
+                exact += (samples.at<float>(r, i) - compressor.mean[i]) * compressor.components[k * compressor.length + i];
+            }
+            if (std::abs(exact) >= 127.0f * step) {
+                saturated++;
+                continue;
+            }
+            EXPECT_LE(std::abs(projected.at<float>(r, k) - exact), 0.5f * step + 1e-4f * std::abs(exact));
+        }
+    }
+    // Quantization covers +/- 3 deviations of the first component
+    EXPECT_LT(saturated, static_cast<size_t>(samples.rows * compressor.dims / 50));
+}
+
+TEST(DescriptorCompression, MatchRecall) {
+    // Reference matches sorted by distance
+    vector<cv::DMatch> reference {cv::DMatch(0, 5, 1.0f), cv::DMatch(1, 6, 2.0f),
+                                  cv::DMatch(2, 7, 3.0f), cv::DMatch(3, 8, 4.0f)};
+    vector<cv::DMatch> matches {cv::DMatch(2, 7, 0.5f), cv::DMatch(0, 5, 1.0f),
+                                cv::DMatch(1, 9, 1.5f)};
+    EXPECT_DOUBLE_EQ(match_recall(reference, matches, 1), 1.0);
+    EXPECT_DOUBLE_EQ(match_recall(reference, matches, 2), 0.5);
+    EXPECT_DOUBLE_EQ(match_recall(reference, matches, 3), 2.0 / 3.0);
+    // n is capped to the reference, query 3 has no match
+    EXPECT_DOUBLE_EQ(match_recall(reference, matches, 10), 0.5);
+    EXPECT_DOUBLE_EQ(match_recall(reference, vector<cv::DMatch>(), 4), 0.0);
+    EXPECT_DOUBLE_EQ(match_recall(vector<cv::DMatch>(), matches, 4), 0.0);
+}
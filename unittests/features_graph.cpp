@@ -0,0 +1,39 @@
+#include <memory>
+#include "gtest/gtest.h"
+#include "../src/image_features.h"
+
+static FeaturesGraph two_matches() {
+    FeaturesGraph graph;
+    graph.data_set = std::make_shared<DataSet>();
+    graph.data_set->rows = 100;
+    graph.data_set->cols = 200;
+    graph.add_edge(0, 1);
+    graph.add_match(0, pixel_t(10, 20), pixel_t(30, 40));
+    graph.add_match(0, pixel_t(11, 21), pixel_t(31, 41));
+    return graph;
+}
+
+TEST(FeaturesGraph, ResampledEdgeSharesKeypoints) {
+    FeaturesGraph graph = two_matches();
+    FeaturesGraph sample = graph.resampled_edge(0, {1, 1, 0});
+    EXPECT_EQ(sample.keypoints.get(), graph.keypoints.get());
+    ASSERT_EQ(sample.edges.size(), 1u);
+    EXPECT_EQ(sample.edges[0].size(), 3u);
+    EXPECT_EQ(sample.number_of_matches, 3u);
+    EXPECT_DOUBLE_EQ(sample.pixel(1, sample.edges[0].index_b[0]).i, 31.0);
+    EXPECT_DOUBLE_EQ(sample.pixel(0, sample.edges[0].index_a[2]).j, 20.0);
+}
+
+TEST(FeaturesGraph, CopiesAreIndependent) {
+    FeaturesGraph graph = two_matches();
+    FeaturesGraph copy(graph);
+    copy.add_match(0, pixel_t(12, 22), pixel_t(32, 42));
+    EXPECT_NE(copy.keypoints.get(), graph.keypoints.get());
+    EXPECT_EQ((*graph.keypoints)[0].size(), 2u);
+    EXPECT_EQ((*copy.keypoints)[0].size(), 3u);
+
+    // Clearing a graph leaves the tables of its copies
+    FeaturesGraph sample = graph.resampled_edge(0, {0});
+    graph.clear_matches();
+    EXPECT_EQ((*sample.keypoints)[0].size(), 2u);
+}
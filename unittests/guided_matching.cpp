@@ -0,0 +1,57 @@
+#include <vector>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "../src/multires.h"
+#include "../src/image_features.h"
+
+using std::vector;
+
+// Nadir cameras 100 m above the ground, the second one 10 m further along x
+static Model0::solution nadir_pair() {
+    Model0::solution solution;
+    solution.cameras.push_back({{0.0, 0.0, 100.0, 0.0, 0.0, 0.0}});
+    solution.cameras.push_back({{10.0, 0.0, 100.0, 0.0, 0.0, 0.0}});
+    return solution;
+}
+
+TEST(GuidedMatching, Model0PredictorMapsThroughGround) {
+    // 50 mm focal length, 10 um pixels
+    const internal_t internal {{0.05, 0.0, 0.0, 1e-5}};
+    match_predictor predict = model0_predictor(internal, nadir_pair(), 1000, 2000);
+
+    // A ground point moves by f * baseline / height = 500 pixels along j
+    for (const pixel_t& a : {pixel_t(500, 1200), pixel_t(120, 900), pixel_t(870, 1500)}) {
+        pixel_t b;
+        ASSERT_TRUE(predict(a, b));
+        EXPECT_NEAR(b.i, a.i, 1e-6);
+        EXPECT_NEAR(b.j, a.j - 500, 1e-6);
+    }
+}
+
+TEST(GuidedMatching, RejectsCandidatesOutsideRadius) {
+    // Keypoint 0 of the first image is predicted at (100, 100) in the second
+    vector<cv::KeyPoint> keypoint1 {cv::KeyPoint(50, 50, 1), cv::KeyPoint(60, 60, 1)};
+    vector<cv::Point2f> predicted {cv::Point2f(100, 100), cv::Point2f(300, 300)};
+    cv::Mat descriptor1 = (cv::Mat_<float>(2, 4) << 1, 0, 0, 0,
+                                                    0, 1, 0, 0);
+
+    // Identical descriptors 20 px away from the predictions, a poorer one 5 px
+    // away from the first
+    vector<cv::KeyPoint> keypoint2 {cv::KeyPoint(120, 100, 1), cv::KeyPoint(103, 104, 1), cv::KeyPoint(300, 320, 1)};
+    cv::Mat descriptor2 = (cv::Mat_<float>(3, 4) << 1, 0, 0, 0,
+                                                    0.5, 0.5, 0, 0,
+                                                    0, 1, 0, 0);
+
+    vector<cv::DMatch> matches = match_guided(keypoint1, descriptor1, keypoint2, descriptor2, predicted, 10.0f);
+    ASSERT_EQ(matches.size(), 1u);
+    EXPECT_EQ(matches[0].queryIdx, 0);
+    EXPECT_EQ(matches[0].trainIdx, 1);
+
+    // With a larger radius the identical descriptors win
+    matches = match_guided(keypoint1, descriptor1, keypoint2, descriptor2, predicted, 25.0f);
+    ASSERT_EQ(matches.size(), 2u);
+    for (const cv::DMatch& m : matches) {
+        EXPECT_EQ(m.trainIdx, m.queryIdx == 0 ? 0 : 2);
+        EXPECT_FLOAT_EQ(m.distance, 0.0f);
+    }
+}
@@ -0,0 +1,71 @@
+#include <vector>
+#include "gtest/gtest.h"
+#include "../src/inverted_index.h"
+
+using std::vector;
+
+TEST(InvertedIndex, RanksBySharedRareWords) {
+    InvertedIndex index(10);
+    index.add({0, 1, 2, 3});    // 0
+    index.add({2, 3, 4, 5});    // 1, overlaps 0 and 2
+    index.add({4, 5, 6, 7});    // 2
+    index.add({8, 9, 8, 9});    // 3, overlaps nothing
+    index.finalize();
+
+    auto neighbors = index.query(1, 5);
+    ASSERT_EQ(neighbors.size(), 2u);
+    EXPECT_TRUE((neighbors[0].first == 0 && neighbors[1].first == 2) ||
+                (neighbors[0].first == 2 && neighbors[1].first == 0));
+    EXPECT_NEAR(neighbors[0].second, neighbors[1].second, 1e-6);
+
+    EXPECT_TRUE(index.query(3, 5).empty());
+
+    // k limits the result
+    EXPECT_EQ(index.query(1, 1).size(), 1u);
+}
+
+TEST(InvertedIndex, IgnoresStopWords) {
+    InvertedIndex index(4);
+    // Word 0 is in every document
+    index.add({0, 1});
+    index.add({0, 2});
+    index.add({0, 3});
+    index.add({0, 1});
+    index.finalize(0.5);
+
+    auto neighbors = index.query(0, 5);
+    ASSERT_EQ(neighbors.size(), 1u);
+    EXPECT_EQ(neighbors[0].first, 3u);
+    EXPECT_NEAR(neighbors[0].second, 1.0, 1e-6);
+}
+
+TEST(InvertedIndex, MisuseThrows) {
+    InvertedIndex index(2);
+    EXPECT_THROW(index.add({2}), std::runtime_error);
+    index.add({0});
+    EXPECT_THROW(index.query(0, 1), std::runtime_error);
+    index.finalize();
+    EXPECT_THROW(index.add({1}), std::runtime_error);
+}
+
+TEST(InvertedIndex, SmallSetsKeepSharedWords) {
+    // With two images, every shared word is in all the documents
+    InvertedIndex pair(6);
+    pair.add({0, 1, 2, 3});
+    pair.add({2, 3, 4, 5});
+    pair.finalize();
+    auto neighbors = pair.query(0, 5);
+    ASSERT_EQ(neighbors.size(), 1u);
+    EXPECT_EQ(neighbors[0].first, 1u);
+    EXPECT_GT(neighbors[0].second, 0.0);
+
+    InvertedIndex three(6);
+    three.add({0, 1, 2});
+    three.add({0, 1, 3});
+    three.add({0, 4, 5});
+    three.finalize();
+    neighbors = three.query(0, 5);
+    ASSERT_EQ(neighbors.size(), 2u);
+    EXPECT_EQ(neighbors[0].first, 1u);
+    EXPECT_GT(neighbors[0].second, neighbors[1].second);
+}
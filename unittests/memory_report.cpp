@@ -0,0 +1,94 @@
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "../src/memory_report.h"
+
+TEST(MemoryReport, DisabledRecordsNothing) {
+    {
+        MemoryScope scope("mem_disabled");
+        std::vector<char> buffer(1 << 20);
+    }
+    EXPECT_EQ(MemoryAccount::instance().stats().count("mem_disabled"), 0u);
+}
+
+TEST(MemoryReport, PeakAndRetainedHeap) {
+    MemoryAccount::instance().enable();
+    std::unique_ptr<std::vector<char>> kept;
+    for (int i = 0; i < 2; i++) {
+        MemoryScope scope("mem_stage");
+        // 4 MB temporary, 1 MB kept after the first call
+        std::vector<char> temporary(4 << 20, 1);
+        if (!kept) {
+            kept.reset(new std::vector<char>(1 << 20, 1));
+        }
+    }
+    MemoryAccount::instance().disable();
+
+    auto stats = MemoryAccount::instance().stats();
+    ASSERT_EQ(stats.count("mem_stage"), 1u);
+    const MemoryAccount::stage_stats& s = stats["mem_stage"];
+    EXPECT_EQ(s.calls, 2u);
+    EXPECT_GE(s.peak_heap, 5 << 20);
+    EXPECT_LT(s.peak_heap, 6 << 20);
+    EXPECT_GE(s.retained_heap, 1 << 20);
+    EXPECT_LT(s.retained_heap, 2 << 20);
+    EXPECT_GT(s.peak_rss, 0);
+}
+
+TEST(MemoryReport, NestedStagesSeeInnerPeak) {
+    MemoryAccount::instance().enable();
+    {
+        MemoryScope outer("mem_outer");
+        {
+            MemoryScope inner("mem_inner");
+            std::vector<char> temporary(2 << 20, 1);
+        }
+    }
+    MemoryAccount::instance().disable();
+
+    auto stats = MemoryAccount::instance().stats();
+    EXPECT_GE(stats["mem_inner"].peak_heap, 2 << 20);
+    EXPECT_GE(stats["mem_outer"].peak_heap, 2 << 20);
+
+    std::ostringstream report;
+    MemoryAccount::instance().write_report(report);
+    EXPECT_NE(report.str().find("mem_outer"), std::string::npos);
+}
+
+TEST(MemoryReport, ConcurrentStagesAreSeparate) {
+    MemoryAccount::instance().enable();
+    {
+        MemoryScope scope("mem_concurrent_small");
+        std::vector<char> temporary(1 << 10, 1);
+        // Runs whole while this stage is open
+        std::thread big([]() {
+            MemoryScope scope("mem_concurrent_big");
+            std::vector<char> temporary(4 << 20, 1);
+        });
+        big.join();
+    }
+    MemoryAccount::instance().disable();
+
+    auto stats = MemoryAccount::instance().stats();
+    EXPECT_GE(stats["mem_concurrent_big"].peak_heap, 4 << 20);
+    EXPECT_LT(stats["mem_concurrent_small"].peak_heap, 1 << 20);
+    EXPECT_LT(stats["mem_concurrent_small"].retained_heap, 1 << 20);
+}
+
+TEST(MemoryReport, UncountedBlocksAreNotSubtracted) {
+    // Allocated before accounting starts, released inside a stage
+    std::unique_ptr<std::vector<char>> before(new std::vector<char>(1 << 20, 1));
+    MemoryAccount::instance().enable();
+    {
+        MemoryScope scope("mem_uncounted");
+        before.reset();
+    }
+    MemoryAccount::instance().disable();
+
+    auto stats = MemoryAccount::instance().stats();
+    // Only the report's own bookkeeping
+    EXPECT_GE(stats["mem_uncounted"].retained_heap, 0);
+    EXPECT_LT(stats["mem_uncounted"].retained_heap, 1 << 10);
+}
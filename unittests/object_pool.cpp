@@ -0,0 +1,41 @@
+#include <set>
+#include "gtest/gtest.h"
+#include "../src/object_pool.h"
+
+struct Counted {
+    explicit Counted(int value, int& alive) : value(value), alive(alive) { alive++; }
+    ~Counted() { alive--; }
+    int value;
+    int& alive;
+};
+
+TEST(ObjectPool, ConstructsInPlaceAndDestroysAll) {
+    int alive = 0;
+    {
+        ObjectPool<Counted> pool(3);
+        std::set<Counted*> objects;
+        for (int i = 0; i < 10; i++) {
+            Counted* c = pool.emplace(i, alive);
+            EXPECT_EQ(c->value, i);
+            objects.insert(c);
+        }
+        EXPECT_EQ(objects.size(), 10u);
+        EXPECT_EQ(pool.size(), 10u);
+        EXPECT_EQ(alive, 10);
+        // Four chunks of three
+        EXPECT_EQ(pool.bytes(), 12 * sizeof(Counted));
+    }
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(ObjectPool, ReserveMakesOneChunk) {
+    ObjectPool<double> pool(2);
+    pool.reserve(100);
+    double* first = pool.emplace(0.0);
+    for (int i = 1; i < 100; i++) {
+        double* d = pool.emplace(static_cast<double>(i));
+        // Contiguous
+        EXPECT_EQ(d, first + i);
+    }
+    EXPECT_EQ(pool.bytes(), 100 * sizeof(double));
+}
@@ -0,0 +1,68 @@
+#include <random>
+#include <cstdlib>
+#include "gtest/gtest.h"
+#include "../src/octree.h"
+
+using std::vector;
+using std::array;
+
+TEST(CloudPoint, RecordRoundTrip) {
+    CloudPoint p {-12.5, 1e-9, 123456.789, 255, 0, 17};
+    unsigned char record[cloud_point_record_size];
+    encode_point(p, record);
+    CloudPoint q = decode_point(record);
+    EXPECT_EQ(p.x, q.x);
+    EXPECT_EQ(p.y, q.y);
+    EXPECT_EQ(p.z, q.z);
+    EXPECT_EQ(p.r, q.r);
+    EXPECT_EQ(p.g, q.g);
+    EXPECT_EQ(p.b, q.b);
+}
+
+TEST(OctreeBuilder, KeepsEveryPointInItsNode) {
+    char dir_template[] = "/tmp/octree-test-XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    std::string dir(dir_template);
+
+    OctreeOptions options;
+    options.memory_points = 1000;
+    options.node_capacity = 500;
+    options.grid_resolution = 8;
+
+    const size_t n = 20000;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0.0, 100.0);
+    OctreeBuilder builder(dir, {{0, 0, 0}}, {{100, 100, 10}}, options);
+    for (size_t i = 0; i < n; i++) {
+        builder.add(CloudPoint {uniform(rng), uniform(rng), uniform(rng) / 10, 1, 2, 3});
+    }
+    builder.build();
+
+    ASSERT_GT(builder.nodes().size(), 1u);
+    EXPECT_EQ(builder.nodes()[0].name, "r");
+
+    size_t total = 0;
+    for (auto& node : builder.nodes()) {
+        PointFileReader reader(dir + "/" + node.name + ".bin");
+        vector<CloudPoint> chunk;
+        size_t count = 0;
+        while (reader.read(chunk, 100)) {
+            for (auto& p : chunk) {
+                EXPECT_GE(p.x, node.min_corner[0]);
+                EXPECT_LE(p.x, node.min_corner[0] + node.size);
+                EXPECT_GE(p.y, node.min_corner[1]);
+                EXPECT_LE(p.y, node.min_corner[1] + node.size);
+            }
+            count += chunk.size();
+        }
+        EXPECT_EQ(count, node.points);
+        // Inner nodes are grid subsampled
+        if (node.name.size() == 1) {
+            EXPECT_LE(node.points, options.grid_resolution * options.grid_resolution * options.grid_resolution);
+        }
+        total += count;
+    }
+    EXPECT_EQ(total, n);
+
+    std::system(("rm -rf " + dir).c_str());
+}
@@ -0,0 +1,54 @@
+#include <sstream>
+#include <random>
+#include <cereal/archives/portable_binary.hpp>
+#include "gtest/gtest.h"
+#include "../src/overlap.h"
+
+using std::vector;
+
+// The vocabulary saved with a project quantizes as the one that was trained
+TEST(Overlap, VocabularyRoundTrip) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> value(0.0f, 255.0f);
+    cv::Mat descriptors(400, 128, CV_32F);
+    for (int r = 0; r < descriptors.rows; r++) {
+        for (int c = 0; c < descriptors.cols; c++) {
+            descriptors.at<float>(r, c) = value(rng);
+        }
+    }
+
+    OverlapIndex index;
+    index.filenames = {"a.jpg", "b.jpg"};
+    index.vocabulary.train(descriptors, 16);
+    index.image_words.push_back(index.vocabulary.quantize(descriptors.rowRange(0, 200)));
+    index.image_words.push_back(index.vocabulary.quantize(descriptors.rowRange(200, 400)));
+
+    std::stringstream ss;
+    {
+        cereal::PortableBinaryOutputArchive ar(ss);
+        index.serialize(ar);
+    }
+    OverlapIndex loaded;
+    {
+        cereal::PortableBinaryInputArchive ar(ss);
+        loaded.serialize(ar);
+    }
+    EXPECT_EQ(loaded.filenames, index.filenames);
+    EXPECT_EQ(loaded.image_words, index.image_words);
+    ASSERT_EQ(loaded.vocabulary.size(), 16);
+    EXPECT_EQ(loaded.vocabulary.quantize(descriptors), index.vocabulary.quantize(descriptors));
+}
+
+TEST(Overlap, EmptyIndexRoundTrip) {
+    std::stringstream ss;
+    {
+        OverlapIndex index;
+        cereal::PortableBinaryOutputArchive ar(ss);
+        index.serialize(ar);
+    }
+    OverlapIndex loaded;
+    cereal::PortableBinaryInputArchive ar(ss);
+    loaded.serialize(ar);
+    EXPECT_EQ(loaded.vocabulary.size(), 0);
+    EXPECT_TRUE(loaded.filenames.empty());
+}
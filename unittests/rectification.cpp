@@ -0,0 +1,73 @@
+#include <array>
+#include <random>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "../src/rectification.h"
+#include "../src/camera_models.h"
+#include "../src/types.h"
+
+using std::array;
+
+// Bilinear sample of a remap map at a rectified pixel
+static double sample(const cv::Mat& map, double r, double u) {
+    const int r0 = static_cast<int>(std::floor(r)), u0 = static_cast<int>(std::floor(u));
+    const double fr = r - r0, fu = u - u0;
+    auto at = [&map](int i, int j) { return static_cast<double>(map.at<float>(i, j)); };
+    return (1 - fr) * ((1 - fu) * at(r0, u0) + fu * at(r0, u0 + 1))
+         + fr * ((1 - fu) * at(r0 + 1, u0) + fu * at(r0 + 1, u0 + 1));
+}
+
+// Two cameras over known ground points: the rectified pixels of a point are on
+// the same row of both images, where the maps sample its projections, and
+// triangulating them recovers it
+TEST(Rectification, TriangulateRecoversGroundPoints) {
+    const internal_t internal {{48.3355e-3, 0.0093e-3, -0.0276e-3, 0.0085e-3}};
+    const array<double, 6> cam_a {{0, 0, 269, 0, 0, 0}};
+    const array<double, 6> cam_b {{40, 2, 270, 0.002, -0.001, 0.01}};
+    const unsigned long rows = 2832, cols = 4256;
+    const double scale = 0.25;
+    const Rectification rect(internal, cam_a, cam_b, rows, cols, scale);
+    EXPECT_NEAR(rect.baseline, std::sqrt(40.0 * 40 + 2 * 2 + 1), 1e-9);
+
+    cv::Mat map_ax, map_ay, map_bx, map_by;
+    rect.maps(internal, cam_a, rows, cols, scale, map_ax, map_ay);
+    rect.maps(internal, cam_b, rows, cols, scale, map_bx, map_by);
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> ground(-60.0, 60.0);
+    std::uniform_real_distribution<double> relief(-5.0, 5.0);
+    for (int n = 0; n < 50; n++) {
+        const array<double, 3> p {{ground(rng) + 20, ground(rng), relief(rng)}};
+        ASSERT_GT(rect.depth(p), 0);
+
+        // Rectified pixel of p seen from each camera
+        const array<double, 6>* cams[2] = {&cam_a, &cam_b};
+        const cv::Mat* map_x[2] = {&map_ax, &map_bx};
+        const cv::Mat* map_y[2] = {&map_ay, &map_by};
+        double row[2], u[2];
+        for (int c = 0; c < 2; c++) {
+            const Rectification::vector3 center((*cams[c])[0], (*cams[c])[1], (*cams[c])[2]);
+            const Rectification::vector3 q = rect.rotation * (Rectification::vector3(p[0], p[1], p[2]) - center);
+            row[c] = rect.cv - rect.focal * q(1) / q(2);
+            u[c] = rect.cu + rect.focal * q(0) / q(2);
+            ASSERT_GT(row[c], 0);
+            ASSERT_LT(row[c], rect.rows - 1);
+            ASSERT_GT(u[c], 0);
+            ASSERT_LT(u[c], rect.cols - 1);
+
+            // The maps sample the camera's projection of p there
+            double s[2];
+            pinhole_projection<double, double, double, double>(internal.data(), cams[c]->data(), p.data(), s);
+            const pixel_t pixel = sensor_t(s[0], s[1]).to_pixel(pixel_size(internal), rows, cols);
+            EXPECT_NEAR(sample(*map_x[c], row[c], u[c]), pixel.j * scale, 0.01);
+            EXPECT_NEAR(sample(*map_y[c], row[c], u[c]), pixel.i * scale, 0.01);
+        }
+
+        // Epipolar lines are rows
+        EXPECT_NEAR(row[0], row[1], 1e-9);
+        const array<double, 3> t = rect.triangulate(row[0], u[0], u[0] - u[1]);
+        for (int k = 0; k < 3; k++) {
+            EXPECT_NEAR(t[k], p[k], 1e-6);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#include <cmath>
+#include <random>
+#include <atomic>
+#include "gtest/gtest.h"
+#include "../src/sgm.h"
+
+using std::vector;
+
+// Random texture, and the same texture seen shifted by disparity pixels
+static void shifted_pair(int rows, int cols, int disparity, vector<uint8_t>& left, vector<uint8_t>& right) {
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> value(0, 255);
+    vector<uint8_t> texture(rows * (cols + disparity));
+    for (auto& v : texture) {
+        v = static_cast<uint8_t>(value(rng));
+    }
+    left.resize(rows * cols);
+    right.resize(rows * cols);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            left[r * cols + c] = texture[r * (cols + disparity) + c];
+            right[r * cols + c] = texture[r * (cols + disparity) + c + disparity];
+        }
+    }
+}
+
+TEST(SGM, CensusOfConstantImage) {
+    vector<uint8_t> image(20 * 30, 100);
+    vector<uint64_t> census = census_transform(image.data(), 20, 30);
+    for (auto bits : census) {
+        EXPECT_EQ(bits, 0u);
+    }
+}
+
+TEST(SGM, ConstantDisparityAcrossStrips) {
+    const int rows = 60, cols = 120, disparity = 8;
+    vector<uint8_t> left, right;
+    shifted_pair(rows, cols, disparity, left, right);
+
+    SGMOptions options;
+    options.min_disparity = 2;
+    options.disparities = 16;
+    options.strip_rows = 16;
+    options.overlap = 8;
+    options.threads = 4;
+    vector<float> result = sgm_disparity(left.data(), right.data(), rows, cols, options);
+    ASSERT_EQ(result.size(), static_cast<size_t>(rows * cols));
+
+    // Away from the census window and the columns without a match
+    size_t valid = 0, interior = 0;
+    for (int r = 3; r < rows - 3; r++) {
+        for (int c = disparity + 4; c < cols - 4; c++) {
+            interior++;
+            float d = result[r * cols + c];
+            if (!std::isnan(d)) {
+                valid++;
+                EXPECT_NEAR(d, disparity, 0.5f);
+            }
+        }
+    }
+    EXPECT_GT(valid, interior * 95 / 100);
+}
+
+TEST(SGM, ThreadsDontChangeTheResult) {
+    const int rows = 40, cols = 80;
+    vector<uint8_t> left, right;
+    shifted_pair(rows, cols, 5, left, right);
+
+    SGMOptions options;
+    options.disparities = 16;
+    options.strip_rows = 8;
+    options.threads = 1;
+    vector<float> serial = sgm_disparity(left.data(), right.data(), rows, cols, options);
+    options.threads = 3;
+    vector<float> parallel = sgm_disparity(left.data(), right.data(), rows, cols, options);
+    for (size_t i = 0; i < serial.size(); i++) {
+        if (std::isnan(serial[i])) {
+            EXPECT_TRUE(std::isnan(parallel[i]));
+        } else {
+            EXPECT_EQ(serial[i], parallel[i]);
+        }
+    }
+}
+
+TEST(SGM, CancelledStripsAreLeftNaN) {
+    const int rows = 40, cols = 80;
+    vector<uint8_t> left, right;
+    shifted_pair(rows, cols, 5, left, right);
+
+    SGMOptions options;
+    options.disparities = 16;
+    options.strip_rows = 8;
+    options.threads = 1;
+    // Two strips are matched before cancellation
+    std::atomic<int> polls(0);
+    options.cancelled = [&polls]() { return ++polls > 2; };
+    vector<float> result = sgm_disparity(left.data(), right.data(), rows, cols, options);
+    EXPECT_EQ(polls, rows / options.strip_rows);
+
+    int matched_rows = 0;
+    for (int r = 0; r < rows; r++) {
+        bool matched = false;
+        for (int c = 0; c < cols; c++) {
+            matched = matched || !std::isnan(result[r * cols + c]);
+        }
+        matched_rows += matched ? 1 : 0;
+    }
+    EXPECT_GT(matched_rows, 0);
+    EXPECT_LE(matched_rows, 2 * options.strip_rows);
+}
+
+TEST(SGM, InvalidOptions) {
+    vector<uint8_t> image(10 * 10, 0);
+    SGMOptions options;
+    options.disparities = 0;
+    EXPECT_THROW(sgm_disparity(image.data(), image.data(), 10, 10, options), std::runtime_error);
+    options.disparities = 16;
+    options.P2 = 100000;
+    EXPECT_THROW(sgm_disparity(image.data(), image.data(), 10, 10, options), std::runtime_error);
+}
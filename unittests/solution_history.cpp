@@ -0,0 +1,127 @@
+#include <sstream>
+#include <cereal/archives/json.hpp>
+#include <cereal/types/array.hpp>
+#include "gtest/gtest.h"
+#include "../src/solution_history.h"
+
+using std::vector;
+using std::array;
+
+struct test_solution {
+    vector<array<double, 2>> points;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(cereal::make_nvp("points", points));
+    }
+
+    vector<double> flatten() const {
+        vector<double> flat;
+        append_flat(flat, points);
+        return flat;
+    }
+
+    void unflatten(const vector<double>& flat) {
+        read_flat(flat.begin(), points);
+    }
+};
+
+vector<test_solution> converging_history(size_t n) {
+    vector<test_solution> solutions(n);
+    for (size_t k = 0; k < n; k++) {
+        solutions[k].points = {{{100.0 + 1.0/(k+1), -3.1415926535}}, {{k * 0.123456789, 1e-7 * k}}};
+    }
+    return solutions;
+}
+
+vector<test_solution> round_trip(vector<test_solution> solutions, HistoryEncoding encoding, HistoryEncoding& loaded_encoding) {
+    std::stringstream ss;
+    {
+        cereal::JSONOutputArchive ar(ss);
+        ar(cereal::make_nvp("solutions", make_history(solutions, encoding)));
+    }
+    vector<test_solution> loaded;
+    {
+        cereal::JSONInputArchive ar(ss);
+        ar(cereal::make_nvp("solutions", make_history(loaded, loaded_encoding)));
+    }
+    return loaded;
+}
+
+TEST(SolutionHistory, FullIsExact) {
+    vector<test_solution> solutions = converging_history(10);
+    HistoryEncoding encoding, loaded_encoding;
+    vector<test_solution> loaded = round_trip(solutions, encoding, loaded_encoding);
+    EXPECT_FALSE(loaded_encoding.delta);
+    ASSERT_EQ(loaded.size(), solutions.size());
+    for (size_t k = 0; k < solutions.size(); k++) {
+        EXPECT_EQ(loaded[k].flatten(), solutions[k].flatten());
+    }
+}
+
+TEST(SolutionHistory, DeltaWithinQuantum) {
+    vector<test_solution> solutions = converging_history(30);
+    HistoryEncoding encoding, loaded_encoding;
+    encoding.delta = true;
+    encoding.quantum = 1e-6;
+    vector<test_solution> loaded = round_trip(solutions, encoding, loaded_encoding);
+    EXPECT_TRUE(loaded_encoding.delta);
+    EXPECT_EQ(loaded_encoding.quantum, encoding.quantum);
+    ASSERT_EQ(loaded.size(), solutions.size());
+
+    // First and last are exact
+    EXPECT_EQ(loaded.front().flatten(), solutions.front().flatten());
+    EXPECT_EQ(loaded.back().flatten(), solutions.back().flatten());
+    for (size_t k = 1; k + 1 < solutions.size(); k++) {
+        vector<double> a = loaded[k].flatten();
+        vector<double> b = solutions[k].flatten();
+        for (size_t i = 0; i < a.size(); i++) {
+            EXPECT_NEAR(a[i], b[i], encoding.quantum / 2 + 1e-12);
+        }
+    }
+}
+
+TEST(SolutionHistory, ShortHistoryStaysFull) {
+    vector<test_solution> solutions = converging_history(2);
+    HistoryEncoding encoding, loaded_encoding;
+    encoding.delta = true;
+    vector<test_solution> loaded = round_trip(solutions, encoding, loaded_encoding);
+    EXPECT_FALSE(loaded_encoding.delta);
+    ASSERT_EQ(loaded.size(), 2u);
+}
+
+TEST(SolutionHistory, LegacyPlainArray) {
+    vector<test_solution> solutions = converging_history(4);
+    std::stringstream ss;
+    {
+        cereal::JSONOutputArchive ar(ss);
+        ar(cereal::make_nvp("solutions", solutions));
+    }
+    const std::string json = ss.str();
+
+    // Version 0 files have solutions as a plain array
+    vector<test_solution> loaded;
+    HistoryEncoding encoding;
+    {
+        std::istringstream is(json);
+        ArchiveVersionScope scope(0);
+        cereal::JSONInputArchive ar(is);
+        ar(cereal::make_nvp("solutions", make_history(loaded, encoding)));
+    }
+    EXPECT_EQ(archive_version(), project_format_version);
+    ASSERT_EQ(loaded.size(), solutions.size());
+    for (size_t k = 0; k < solutions.size(); k++) {
+        EXPECT_EQ(loaded[k].flatten(), solutions[k].flatten());
+    }
+}
+
+TEST(ProjectFormat, JsonVersionMember) {
+    std::istringstream versioned("{\n    \"format_version\": 1,\n    \"data_set\": {}\n}");
+    EXPECT_TRUE(json_has_format_version(versioned));
+    std::istringstream original("{\n    \"data_set\": {\"format_version\": 1}\n}");
+    EXPECT_FALSE(json_has_format_version(original));
+    std::istringstream prefix("{\"format_versions\": 1}");
+    EXPECT_FALSE(json_has_format_version(prefix));
+    std::istringstream empty("");
+    EXPECT_FALSE(json_has_format_version(empty));
+}
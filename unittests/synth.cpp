@@ -0,0 +1,69 @@
+#include <cmath>
+#include "gtest/gtest.h"
+#include "../src/camera_models.h"
+#include "../src/synth.h"
+
+TEST(Synth, Deterministic) {
+    SynthOptions options;
+    options.points = 200;
+    SyntheticScene a = synthesize(options);
+    SyntheticScene b = synthesize(options);
+    ASSERT_EQ(a.terrain.size(), b.terrain.size());
+    ASSERT_EQ(a.edges.size(), b.edges.size());
+    EXPECT_EQ(a.terrain[17], b.terrain[17]);
+    EXPECT_EQ(a.edges[0].points, b.edges[0].points);
+}
+
+TEST(Synth, FlightPlan) {
+    SynthOptions options;
+    options.cameras = 6;
+    options.strips = 2;
+    options.points = 0;
+    SyntheticScene scene = synthesize(options);
+    ASSERT_EQ(scene.cameras.size(), 6u);
+    // Serpentine: second strip flies back
+    EXPECT_NEAR(scene.cameras[2][0], scene.cameras[3][0], 1e-9);
+    EXPECT_NEAR(scene.cameras[0][0], scene.cameras[5][0], 1e-9);
+    EXPECT_GT(scene.cameras[3][1], scene.cameras[2][1]);
+}
+
+TEST(Synth, ObservationsMatchGroundTruth) {
+    SynthOptions options;
+    options.cameras = 3;
+    options.points = 2000;
+    options.noise = 0.0;
+    options.outliers = 0.25;
+    SyntheticScene scene = synthesize(options);
+
+    ASSERT_FALSE(scene.edges.empty());
+    EXPECT_EQ(scene.edges[0].cam_a, 0u);
+    EXPECT_EQ(scene.edges[0].cam_b, 1u);
+
+    const double ps = pixel_size(options.internal);
+    size_t outliers = 0;
+    size_t total = 0;
+    for (auto& e : scene.edges) {
+        ASSERT_EQ(e.points.size(), e.obs_a.size());
+        ASSERT_EQ(e.points.size(), e.obs_b.size());
+        for (size_t k = 0; k < e.points.size(); k++) {
+            const auto& p = scene.terrain[e.points[k]];
+            EXPECT_NEAR(p[2], synth_surface(options, p[0], p[1]), 1e-12);
+
+            double s[2];
+            pinhole_projection<double, double, double, double>(options.internal.data(), scene.cameras[e.cam_a].data(), p.data(), s);
+            pixel_t expected = sensor_t(s[0], s[1]).to_pixel(ps, options.rows, options.cols);
+            EXPECT_NEAR(e.obs_a[k].i, expected.i, 1e-6);
+            EXPECT_NEAR(e.obs_a[k].j, expected.j, 1e-6);
+
+            if (!e.outlier[k]) {
+                pinhole_projection<double, double, double, double>(options.internal.data(), scene.cameras[e.cam_b].data(), p.data(), s);
+                expected = sensor_t(s[0], s[1]).to_pixel(ps, options.rows, options.cols);
+                EXPECT_NEAR(e.obs_b[k].i, expected.i, 1e-6);
+                EXPECT_NEAR(e.obs_b[k].j, expected.j, 1e-6);
+            }
+            outliers += e.outlier[k];
+            total++;
+        }
+    }
+    EXPECT_NEAR(double(outliers) / total, 0.25, 0.05);
+}
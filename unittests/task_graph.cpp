@@ -0,0 +1,67 @@
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "../src/task_graph.h"
+
+using std::vector;
+
+TEST(TaskGraph, RespectsDependencies) {
+    TaskGraph graph;
+    std::mutex mutex;
+    vector<int> order;
+    auto record = [&](int n) {
+        return [&, n]() {
+            std::lock_guard<std::mutex> guard(mutex);
+            order.push_back(n);
+        };
+    };
+
+    auto a = graph.add("a", record(0));
+    auto b = graph.add("b", record(1), {a});
+    auto c = graph.add("c", record(2), {a});
+    graph.add("d", record(3), {b, c});
+    graph.run(4);
+
+    ASSERT_EQ(order.size(), 4u);
+    EXPECT_EQ(order.front(), 0);
+    EXPECT_EQ(order.back(), 3);
+    for (size_t id = 0; id < graph.size(); id++) {
+        EXPECT_EQ(graph.status(id), TaskGraph::done);
+    }
+}
+
+TEST(TaskGraph, IndependentTasksOverlap) {
+    TaskGraph graph;
+    std::atomic<int> running(0);
+    std::atomic<int> max_running(0);
+    for (int i = 0; i < 4; i++) {
+        graph.add("sleep", [&]() {
+            int now = ++running;
+            int seen = max_running;
+            while (now > seen && !max_running.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            running--;
+        });
+    }
+    graph.run(4);
+    EXPECT_GT(max_running.load(), 1);
+}
+
+TEST(TaskGraph, FailureSkipsDependents) {
+    TaskGraph graph;
+    bool independent_ran = false;
+    auto bad = graph.add("bad", []() { throw std::runtime_error("boom"); });
+    auto child = graph.add("child", []() {}, {bad});
+    auto grandchild = graph.add("grandchild", []() {}, {child});
+    auto other = graph.add("other", [&]() { independent_ran = true; });
+
+    EXPECT_THROW(graph.run(2), std::runtime_error);
+    EXPECT_EQ(graph.status(bad), TaskGraph::failed);
+    EXPECT_EQ(graph.status(child), TaskGraph::skipped);
+    EXPECT_EQ(graph.status(grandchild), TaskGraph::skipped);
+    EXPECT_EQ(graph.status(other), TaskGraph::done);
+    EXPECT_TRUE(independent_ran);
+}
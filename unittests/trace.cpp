@@ -0,0 +1,57 @@
+#include <thread>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "../src/trace.h"
+
+TEST(Trace, DisabledRecordsNothing) {
+    Tracer::instance().enable();
+    Tracer::instance().disable();
+    {
+        TRACE_SCOPE("disabled");
+    }
+    EXPECT_TRUE(Tracer::instance().events().empty());
+}
+
+TEST(Trace, NestedScopesPerThread) {
+    Tracer::instance().enable();
+    auto work = []() {
+        TRACE_SCOPE("outer");
+        TRACE_SCOPE("inner");
+    };
+    std::thread t1(work), t2(work);
+    t1.join();
+    t2.join();
+    Tracer::instance().disable();
+
+    auto threads = Tracer::instance().events();
+    ASSERT_EQ(threads.size(), 2u);
+    for (auto& events : threads) {
+        ASSERT_EQ(events.size(), 2u);
+        // Inner scope ends first and lies within the outer one
+        EXPECT_STREQ(events[0].name, "inner");
+        EXPECT_STREQ(events[1].name, "outer");
+        EXPECT_GE(events[0].start, events[1].start);
+        EXPECT_LE(events[0].start + events[0].duration, events[1].start + events[1].duration);
+    }
+
+    std::ostringstream summary;
+    Tracer::instance().write_summary(summary);
+    EXPECT_NE(summary.str().find("outer"), std::string::npos);
+    EXPECT_NE(summary.str().find("inner"), std::string::npos);
+}
+
+TEST(Trace, EnableClearsEvents) {
+    Tracer::instance().enable();
+    {
+        TRACE_SCOPE("first");
+    }
+    Tracer::instance().enable();
+    {
+        TRACE_SCOPE("second");
+    }
+    Tracer::instance().disable();
+    auto threads = Tracer::instance().events();
+    ASSERT_EQ(threads.size(), 1u);
+    ASSERT_EQ(threads[0].size(), 1u);
+    EXPECT_STREQ(threads[0][0].name, "second");
+}
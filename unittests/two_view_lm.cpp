@@ -0,0 +1,86 @@
+#include <array>
+#include <memory>
+#include <random>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "../src/model0.h"
+
+using std::array;
+using std::vector;
+
+// Two nadir cameras over flat terrain, observations projected from random ground
+// points with pixel noise so that the minimum has a nonzero cost
+static Model0 two_view_scene(size_t matches) {
+    const internal_t internal {{48.3355e-3, 0.0093e-3, -0.0276e-3, 0.0085e-3}};
+    const array<double, 6> cam_a {{0, 0, 269, 0, 0, 0}};
+    const array<double, 6> cam_b {{40, 2, 270, 0.002, -0.001, 0.01}};
+
+    std::shared_ptr<DataSet> data_set(new DataSet());
+    data_set->filenames = {"synthetic_a", "synthetic_b"};
+    data_set->rows = 2832;
+    data_set->cols = 4256;
+    std::shared_ptr<FeaturesGraph> features(new FeaturesGraph());
+    features->data_set = data_set;
+    features->number_of_matches = matches;
+    features->computed = true;
+    features->add_edge(0, 1);
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> ground(-60.0, 60.0);
+    std::normal_distribution<double> noise(0.0, 0.5);
+    for (size_t i = 0; i < matches; i++) {
+        const double p[2] = {ground(rng) + 20, ground(rng)};
+        double sa[2], sb[2];
+        model0_projection<double, double>(internal.data(), cam_a.data(), p, sa);
+        model0_projection<double, double>(internal.data(), cam_b.data(), p, sb);
+        pixel_t pa = sensor_t(sa[0], sa[1]).to_pixel(pixel_size(internal), data_set->rows, data_set->cols);
+        pixel_t pb = sensor_t(sb[0], sb[1]).to_pixel(pixel_size(internal), data_set->rows, data_set->cols);
+        features->add_match(0, pixel_t(pa.i + noise(rng), pa.j + noise(rng)),
+                               pixel_t(pb.i + noise(rng), pb.j + noise(rng)));
+    }
+
+    Model0 model;
+    model.features = features;
+    model.internal = internal;
+    model.set_progress_output(false);
+    // Converge fully, so that both backends stop at the same minimum
+    model.options.max_num_iterations = 100;
+    model.options.function_tolerance = 1e-14;
+    model.options.gradient_tolerance = 1e-14;
+    model.options.parameter_tolerance = 1e-14;
+    Model0::solution init;
+    init.cameras = {cam_a, {{0, 0, 269, 0, 0, 0}}};
+    model.solutions.push_back(init);
+    return model;
+}
+
+TEST(TwoViewLM, MatchesCeres) {
+    const Model0 scene = two_view_scene(300);
+    Model0 reference(scene), model(scene);
+    reference.backend = Model0::ceres_solver;
+    model.backend = Model0::two_view_solver;
+    const ceres::Solver::Summary expected = reference.solve();
+    const ceres::Solver::Summary summary = model.solve();
+
+    ASSERT_NE(summary.termination_type, ceres::FAILURE);
+    EXPECT_NEAR(summary.initial_cost, expected.initial_cost, 1e-9 * expected.initial_cost);
+    EXPECT_NEAR(summary.final_cost, expected.final_cost, 1e-6 * expected.final_cost);
+
+    const vector<array<double, 6>> cameras = model.final_external();
+    const vector<array<double, 6>> expected_cameras = reference.final_external();
+    ASSERT_EQ(cameras.size(), 2u);
+    for (int k = 0; k < 6; k++) {
+        EXPECT_EQ(cameras[0][k], expected_cameras[0][k]); // Fixed
+        // Positions in meters, angles in radians
+        EXPECT_NEAR(cameras[1][k], expected_cameras[1][k], k < 3 ? 1e-4 : 1e-7);
+    }
+
+    const vector<array<double, 3>> terrain = model.final_terrain();
+    const vector<array<double, 3>> expected_terrain = reference.final_terrain();
+    ASSERT_EQ(terrain.size(), expected_terrain.size());
+    for (size_t i = 0; i < terrain.size(); i++) {
+        for (int k = 0; k < 3; k++) {
+            EXPECT_NEAR(terrain[i][k], expected_terrain[i][k], 1e-4);
+        }
+    }
+}